@@ -0,0 +1,21 @@
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+win32 {
+	QMAKE_CXXFLAGS += -execution-charset:utf-8
+}
+
+APP_DIR = ../../WebSocketApp
+INCLUDEPATH += $$APP_DIR
+
+SOURCES += \
+    $$APP_DIR/SocketBase64.cpp \
+    $$APP_DIR/SocketSimd.cpp \
+    main.cpp
+
+HEADERS += \
+    $$APP_DIR/SocketBase64.h \
+    $$APP_DIR/SocketSimd.h \
+    $$APP_DIR/WebSocketApp.h
@@ -0,0 +1,117 @@
+﻿#include "SocketBase64.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <cstdio>
+#include <vector>
+
+// Compares the base64 codec of SocketBase64 with QByteArray::toBase64() and fromBase64().
+//   Base64Benchmark [-r rounds] [screenshot file]...
+//   Without files, buffers of the sizes of typical screenshots are used (the codec does not depend on
+//   the contents). Throughput is in megabytes of binary data per second either way.
+
+namespace {
+
+struct Sample {
+    std::string name;
+    QByteArray bytes;
+};
+
+QByteArray MakeBuffer(int size) {
+    QByteArray bytes(size, '\0');
+    uint32_t state = 2463534242u;
+    for (int i = 0; i < size; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bytes[i] = (char)(state >> 24);
+    }
+    return bytes;
+}
+
+// Megabytes per second of the fastest round
+template<class Function>
+double Measure(const QByteArray& bytes, int rounds, Function function) {
+    qint64 best = -1;
+    for (int i = 0; i < rounds; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return (best > 0) ? (double)bytes.length() * 1000.0 / best : 0;
+}
+
+void Run(const Sample& sample, int rounds) {
+    const QByteArray& bytes = sample.bytes;
+    const QByteArray expected = bytes.toBase64();
+
+    QByteArray encoded(WebSocketApp::Base64EncodedSize(bytes.length()), '\0');
+    QByteArray decoded(WebSocketApp::Base64DecodedSize(encoded.length()), '\0');
+    volatile int sink = 0;
+
+    auto qtEncode = [&]() { sink = bytes.toBase64().length(); };
+    auto qtDecode = [&]() { sink = QByteArray::fromBase64(expected).length(); };
+    auto encode = [&]() { sink = WebSocketApp::EncodeBase64(bytes.constData(), bytes.length(), encoded.data()); };
+    auto decode = [&]() { sink = WebSocketApp::DecodeBase64(expected.constData(), expected.length(), decoded.data()); };
+
+    double results[3][2];
+    results[0][0] = Measure(bytes, rounds, qtEncode);
+    results[0][1] = Measure(bytes, rounds, qtDecode);
+    for (int simd = 0; simd < 2; ++simd) {
+        WebSocketApp::SetBase64SimdEnabled(simd != 0);
+        results[simd + 1][0] = Measure(bytes, rounds, encode);
+        results[simd + 1][1] = Measure(bytes, rounds, decode);
+        // decoded has room for the padding as well
+        if (encoded != expected || WebSocketApp::DecodeBase64(expected.constData(), expected.length(), decoded.data()) != bytes.length()
+            || QByteArray::fromRawData(decoded.constData(), bytes.length()) != bytes) {
+            fprintf(stderr, "%s: 変換結果が一致しない\n", sample.name.c_str());
+        }
+    }
+
+    const char* names[] = { "encode", "decode" };
+    printf("%s (%d bytes, %s)\n", sample.name.c_str(), bytes.length(), WebSocketApp::Base64SimdName());
+    for (int i = 0; i < 2; ++i) {
+        printf("  %-8s QByteArray %8.1f MB/s  scalar %8.1f MB/s  simd %8.1f MB/s  x%.2f\n", names[i],
+            results[0][i], results[1][i], results[2][i], (results[0][i] > 0) ? results[2][i] / results[0][i] : 0.0);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int rounds = 20;
+    std::vector<Sample> samples;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "-r" && i + 1 < args.size()) {
+            rounds = qMax(1, args[++i].toInt());
+            continue;
+        }
+        QFile file(args[i]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "読み込みに失敗：%s\n", args[i].toStdString().c_str());
+            return 1;
+        }
+        samples.push_back({ args[i].toStdString(), file.readAll() });
+    }
+
+    if (samples.empty()) {
+        samples.push_back({ "thumbnail", MakeBuffer(64 * 1024) });
+        samples.push_back({ "720p png", MakeBuffer(900 * 1024) });
+        samples.push_back({ "1080p png", MakeBuffer(2500 * 1024) });
+        samples.push_back({ "1080p rgba", MakeBuffer(1920 * 1080 * 4) });
+    }
+
+    for (const auto& sample : samples) {
+        Run(sample, rounds);
+    }
+    return 0;
+}
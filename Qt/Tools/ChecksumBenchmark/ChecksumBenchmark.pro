@@ -0,0 +1,39 @@
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+win32 {
+	QMAKE_CXXFLAGS += -execution-charset:utf-8
+}
+
+APP_DIR = ../../WebSocketApp
+INCLUDEPATH += $$APP_DIR
+
+SOURCES += \
+	$$APP_DIR/External/zlib/adler32.c \
+	$$APP_DIR/External/zlib/adler32_simd.c \
+	$$APP_DIR/External/zlib/compress.c \
+	$$APP_DIR/External/zlib/cpu_features.c \
+	$$APP_DIR/External/zlib/crc32.c \
+	$$APP_DIR/External/zlib/crc32_simd.c \
+	$$APP_DIR/External/zlib/deflate.c \
+	$$APP_DIR/External/zlib/infback.c \
+	$$APP_DIR/External/zlib/inffast.c \
+	$$APP_DIR/External/zlib/inflate.c \
+	$$APP_DIR/External/zlib/inftrees.c \
+	$$APP_DIR/External/zlib/trees.c \
+	$$APP_DIR/External/zlib/uncompr.c \
+	$$APP_DIR/External/zlib/zutil.c \
+	$$APP_DIR/External/zlib/gzlib.c \
+    $$APP_DIR/SocketBase64.cpp \
+    $$APP_DIR/SocketDictionary.cpp \
+    $$APP_DIR/SocketSimd.cpp \
+    $$APP_DIR/WebSocketApp.cpp \
+    main.cpp
+
+HEADERS += \
+    $$APP_DIR/SocketBase64.h \
+    $$APP_DIR/SocketDictionary.h \
+    $$APP_DIR/SocketSimd.h \
+    $$APP_DIR/WebSocketApp.h
@@ -0,0 +1,118 @@
+﻿#include "WebSocketApp.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <cstdio>
+#include <vector>
+#include "External/zlib/zlib.h"
+
+// Compares the vectorized CRC-32 and Adler-32 of the vendored zlib with its portable code.
+//   ChecksumBenchmark [-r rounds] [screenshot file]...
+//   Without files, buffers of the sizes of typical screenshots are used (the checksums do not depend on
+//   the contents). Besides the checksums alone it times inflating the gzip payload of the buffer.
+
+// External/zlib/cpu_features.h
+extern "C" void zlib_enable_simd(int enable);
+
+namespace {
+
+struct Sample {
+    std::string name;
+    QByteArray bytes;
+};
+
+// Random bytes look like the compressed data of a PNG or JPEG
+QByteArray MakeBuffer(int size) {
+    QByteArray bytes(size, '\0');
+    uint32_t state = 2463534242u;
+    for (int i = 0; i < size; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bytes[i] = (char)(state >> 24);
+    }
+    return bytes;
+}
+
+// Megabytes per second of the fastest round
+template<class Function>
+double Measure(const QByteArray& bytes, int rounds, Function function) {
+    qint64 best = -1;
+    for (int i = 0; i < rounds; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return (best > 0) ? (double)bytes.length() * 1000.0 / best : 0;
+}
+
+void Run(const Sample& sample, int rounds) {
+    const QByteArray& bytes = sample.bytes;
+    const Bytef* data = (const Bytef*)bytes.constData();
+    volatile uLong sink = 0;
+
+    auto crc = [&]() { sink = crc32(0, data, (uInt)bytes.length()); };
+    auto adler = [&]() { sink = adler32(1, data, (uInt)bytes.length()); };
+
+    // Deflate barely shrinks random data, so inflating it is mostly copying and checking the CRC
+    QByteArray compressed;
+    QByteArray decompressed;
+    WebSocketApp::GZipDeflater().Compress(bytes.constData(), bytes.length(), compressed);
+    WebSocketApp::GZipInflater inflater;
+    auto gunzip = [&]() { inflater.Decompress(compressed.constData(), compressed.length(), decompressed); };
+
+    double results[2][3];
+    for (int simd = 0; simd < 2; ++simd) {
+        zlib_enable_simd(simd);
+        results[simd][0] = Measure(bytes, rounds, crc);
+        results[simd][1] = Measure(bytes, rounds, adler);
+        results[simd][2] = Measure(bytes, rounds, gunzip);
+    }
+
+    const char* names[] = { "crc32", "adler32", "gunzip" };
+    printf("%s (%d bytes)\n", sample.name.c_str(), bytes.length());
+    for (int i = 0; i < 3; ++i) {
+        printf("  %-16s portable %9.1f MB/s  simd %9.1f MB/s  x%.2f\n", names[i], results[0][i], results[1][i],
+            (results[0][i] > 0) ? results[1][i] / results[0][i] : 0.0);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int rounds = 20;
+    std::vector<Sample> samples;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "-r" && i + 1 < args.size()) {
+            rounds = qMax(1, args[++i].toInt());
+            continue;
+        }
+        QFile file(args[i]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "読み込みに失敗：%s\n", args[i].toStdString().c_str());
+            return 1;
+        }
+        samples.push_back({ args[i].toStdString(), file.readAll() });
+    }
+
+    if (samples.empty()) {
+        samples.push_back({ "thumbnail", MakeBuffer(64 * 1024) });
+        samples.push_back({ "720p png", MakeBuffer(900 * 1024) });
+        samples.push_back({ "1080p png", MakeBuffer(2500 * 1024) });
+        samples.push_back({ "1080p rgba", MakeBuffer(1920 * 1080 * 4) });
+    }
+
+    for (const auto& sample : samples) {
+        Run(sample, rounds);
+    }
+    return 0;
+}
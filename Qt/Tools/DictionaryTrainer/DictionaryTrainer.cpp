@@ -0,0 +1,128 @@
+﻿#include "DictionaryTrainer.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+DictionaryTrainer::DictionaryTrainer()
+    : _offsets({ 0 })
+    , _dictionarySize(DICTIONARY_SIZE_DEFAULT)
+    , _segmentSize(SEGMENT_SIZE_DEFAULT)
+    , _dmerSize(DMER_SIZE_DEFAULT)
+{
+}
+
+void DictionaryTrainer::AddSample(const QByteArray& sample) {
+    if (sample.isEmpty()) {
+        return;
+    }
+    _corpus.append(sample);
+    _offsets.push_back(_corpus.length());
+}
+
+uint64_t DictionaryTrainer::DmerKey(int offset) const {
+    // The bytes themselves, so different d-mers never share a key
+    uint64_t key = 0;
+    const uchar* src = (const uchar*)_corpus.constData() + offset;
+    for (int i = 0; i < _dmerSize; ++i) {
+        key = (key << 8) | src[i];
+    }
+    return key;
+}
+
+DictionaryTrainer::FrequencyMap DictionaryTrainer::CountSamples() const {
+    // The number of samples a d-mer occurs in, repeats within one sample do not count
+    FrequencyMap frequencies;
+    std::unordered_set<uint64_t> seen;
+    for (int i = 0, count = SampleCount(); i < count; ++i) {
+        seen.clear();
+        for (int pos = _offsets[i], end = _offsets[i + 1] - _dmerSize; pos <= end; ++pos) {
+            uint64_t key = DmerKey(pos);
+            if (seen.insert(key).second) {
+                ++frequencies[key];
+            }
+        }
+    }
+    return frequencies;
+}
+
+DictionaryTrainer::Segment DictionaryTrainer::BestSegment(int begin, int end, const FrequencyMap& frequencies) const {
+    Segment best = { 0, 0, 0 };
+    int windowDmers = qMax(1, _segmentSize - _dmerSize + 1);
+
+    // Segments do not cross samples
+    auto sample = std::upper_bound(_offsets.begin(), _offsets.end(), begin) - 1;
+    std::unordered_map<uint64_t, int> active;
+    for (; sample + 1 != _offsets.end() && *sample < end; ++sample) {
+        int low = qMax(*sample, begin);
+        int high = qMin(*(sample + 1), end);
+
+        active.clear();
+        uint64_t score = 0;
+        int first = low;
+        for (int pos = low; pos + _dmerSize <= high; ++pos) {
+            uint64_t key = DmerKey(pos);
+            if (active[key]++ == 0) {
+                auto it = frequencies.find(key);
+                score += (it != frequencies.end() ? it->second : 0);
+            }
+
+            if (pos - first + 1 > windowDmers) {
+                uint64_t firstKey = DmerKey(first);
+                if (--active[firstKey] == 0) {
+                    auto it = frequencies.find(firstKey);
+                    score -= (it != frequencies.end() ? it->second : 0);
+                    active.erase(firstKey);
+                }
+                ++first;
+            }
+
+            if (score > best.score) {
+                best.begin = first;
+                best.length = pos + _dmerSize - first;
+                best.score = score;
+            }
+        }
+    }
+    return best;
+}
+
+QByteArray DictionaryTrainer::Train() const {
+    if (SampleCount() == 0 || _dictionarySize <= 0 || _dmerSize < 4 || _dmerSize > 8 || _segmentSize < _dmerSize) {
+        return QByteArray();
+    }
+
+    FrequencyMap frequencies = CountSamples();
+    int corpusSize = _corpus.length();
+    int epochCount = qMax(1, qMin(_dictionarySize / _segmentSize, corpusSize / _segmentSize));
+    int epochSize = corpusSize / epochCount;
+
+    std::vector<Segment> segments;
+    int remaining = _dictionarySize;
+    bool progress = true;
+    while (remaining > 0 && progress) {
+        progress = false;
+        for (int epoch = 0; epoch < epochCount && remaining > 0; ++epoch) {
+            int begin = epoch * epochSize;
+            int end = (epoch + 1 == epochCount) ? corpusSize : begin + epochSize;
+            Segment segment = BestSegment(begin, end, frequencies);
+            if (segment.score == 0) {
+                continue;
+            }
+
+            for (int pos = segment.begin; pos + _dmerSize <= segment.begin + segment.length; ++pos) {
+                frequencies[DmerKey(pos)] = 0;
+            }
+            segment.length = qMin(segment.length, remaining);
+            remaining -= segment.length;
+            segments.push_back(segment);
+            progress = true;
+        }
+    }
+
+    QByteArray dictionary;
+    dictionary.reserve(_dictionarySize - remaining);
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        dictionary.append(_corpus.constData() + it->begin, it->length);
+    }
+    return dictionary;
+}
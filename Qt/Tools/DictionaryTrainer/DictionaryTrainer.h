@@ -0,0 +1,65 @@
+﻿#ifndef DICTIONARYTRAINER_H
+#define DICTIONARYTRAINER_H
+
+#include <QByteArray>
+#include <unordered_map>
+#include <vector>
+
+// Builds a deflate preset dictionary from sample messages, a simplified form of the COVER algorithm of zstd:
+//   the corpus is cut into epochs, and from each epoch the segment whose d-mers occur in the most samples is taken
+//   until the dictionary is full. The d-mers of a taken segment no longer count, and the segments taken first
+//   end up at the end of the dictionary, where deflate reaches them with the shortest distances.
+class DictionaryTrainer {
+public:
+    static const int DICTIONARY_SIZE_DEFAULT = 16 * 1024;
+    static const int SEGMENT_SIZE_DEFAULT = 48;
+    static const int DMER_SIZE_DEFAULT = 6;
+
+    DictionaryTrainer();
+
+    int SampleCount() const {
+        return (int)_offsets.size() - 1;
+    }
+    int64_t SampleBytes() const {
+        return _corpus.length();
+    }
+    const char* Sample(int index, int& length) const {
+        length = _offsets[index + 1] - _offsets[index];
+        return _corpus.constData() + _offsets[index];
+    }
+
+    void SetDictionarySize(int val) {
+        _dictionarySize = val;
+    }
+    void SetSegmentSize(int val) {
+        _segmentSize = val;
+    }
+    // 4 to 8 bytes
+    void SetDmerSize(int val) {
+        _dmerSize = val;
+    }
+
+    void AddSample(const QByteArray& sample);
+    QByteArray Train() const;
+
+private:
+    struct Segment {
+        int begin;
+        int length;
+        uint64_t score;
+    };
+    typedef std::unordered_map<uint64_t, uint32_t> FrequencyMap;
+
+    QByteArray _corpus;
+    // Start of each sample in _corpus, followed by the end of the last one
+    std::vector<int> _offsets;
+    int _dictionarySize;
+    int _segmentSize;
+    int _dmerSize;
+
+    uint64_t DmerKey(int offset) const;
+    FrequencyMap CountSamples() const;
+    Segment BestSegment(int begin, int end, const FrequencyMap& frequencies) const;
+}; // class DictionaryTrainer
+
+#endif // DICTIONARYTRAINER_H
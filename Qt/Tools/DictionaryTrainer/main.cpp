@@ -0,0 +1,166 @@
+﻿#include "DictionaryTrainer.h"
+#include "WebSocketApp.h"
+#include "SocketDictionary.h"
+#include "SocketFrame.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <cstdio>
+
+// Trains a preset dictionary for WebSocketApp from captured messages.
+//   DictionaryTrainer [-o output] [-s size] [-k segment] [-d dmer] [-l] <file or directory>...
+//   Each file is one sample (a payload as ExportPayload encodes it before compression), or with -l
+//   each line is a text envelope ("Type,c|-,base64") as sent over the socket.
+//   The output goes into the Dictionaries directory next to WebSocketApp; a new file is a new version,
+//   since the id is computed from the contents.
+
+namespace {
+
+struct Arguments {
+    std::string output = "messages.dict";
+    int dictionarySize = DictionaryTrainer::DICTIONARY_SIZE_DEFAULT;
+    int segmentSize = DictionaryTrainer::SEGMENT_SIZE_DEFAULT;
+    int dmerSize = DictionaryTrainer::DMER_SIZE_DEFAULT;
+    bool envelopeLines = false;
+    std::vector<std::string> inputs;
+};
+
+void PrintUsage() {
+    fprintf(stderr, "usage: DictionaryTrainer [-o output] [-s size] [-k segment] [-d dmer] [-l] <file or directory>...\n");
+}
+
+bool ParseArguments(const QStringList& args, Arguments& result) {
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args[i];
+        bool hasValue = (i + 1 < args.size());
+        if (arg == "-o" && hasValue) {
+            result.output = args[++i].toStdString();
+        } else if (arg == "-s" && hasValue) {
+            result.dictionarySize = args[++i].toInt();
+        } else if (arg == "-k" && hasValue) {
+            result.segmentSize = args[++i].toInt();
+        } else if (arg == "-d" && hasValue) {
+            result.dmerSize = args[++i].toInt();
+        } else if (arg == "-l") {
+            result.envelopeLines = true;
+        } else if (arg.startsWith("-")) {
+            return false;
+        } else {
+            result.inputs.push_back(arg.toStdString());
+        }
+    }
+    return !result.inputs.empty()
+        && result.dictionarySize > 0 && result.dictionarySize <= WebSocketApp::SocketDictionary::MAX_SIZE
+        && result.dmerSize >= 4 && result.dmerSize <= 8 && result.segmentSize >= result.dmerSize;
+}
+
+// The payload of a text envelope, decompressed
+bool DecodeEnvelope(const QByteArray& line, QByteArray& payload) {
+    int index = line.indexOf(',');
+    if (index < 0 || index + 2 >= line.length() || line[index + 2] != ',') {
+        return false;
+    }
+
+    payload = QByteArray::fromBase64(line.mid(index + 3));
+    if (line[index + 1] == 'c') {
+        QByteArray decompressed;
+        if (WebSocketApp::DecompressGZip(payload.constData(), payload.length(), decompressed) <= 0) {
+            return false;
+        }
+        payload = decompressed;
+    }
+    return !payload.isEmpty();
+}
+
+bool AddFile(DictionaryTrainer& trainer, const QString& path, bool envelopeLines) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "読み込みに失敗：%s\n", path.toStdString().c_str());
+        return false;
+    }
+    if (!envelopeLines) {
+        trainer.AddSample(file.readAll());
+        return true;
+    }
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        QByteArray payload;
+        if (DecodeEnvelope(line, payload)) {
+            trainer.AddSample(payload);
+        }
+    }
+    return true;
+}
+
+// Total compressed size of the samples, and how many of them compress to less than they are
+int64_t Evaluate(const DictionaryTrainer& trainer, const WebSocketApp::SocketDictionary* dictionary, int& smallerCount) {
+    WebSocketApp::GZipDeflater deflater;
+    int64_t total = 0;
+    smallerCount = 0;
+    QByteArray compressed;
+    for (int i = 0, count = trainer.SampleCount(); i < count; ++i) {
+        int length = 0;
+        const char* sample = trainer.Sample(i, length);
+        int compressedLength = deflater.Compress(sample, length, compressed, WebSocketApp::SocketConnectionOptions::COMPRESSION_LEVEL_DEFAULT, dictionary);
+        if (compressedLength > 0 && compressedLength < length) {
+            total += compressedLength;
+            ++smallerCount;
+        } else {
+            total += length;
+        }
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Arguments args;
+    if (!ParseArguments(app.arguments(), args)) {
+        PrintUsage();
+        return 1;
+    }
+
+    DictionaryTrainer trainer;
+    trainer.SetDictionarySize(args.dictionarySize);
+    trainer.SetSegmentSize(args.segmentSize);
+    trainer.SetDmerSize(args.dmerSize);
+    for (const auto& input : args.inputs) {
+        QString path = QString::fromStdString(input);
+        if (!QFileInfo(path).isDir()) {
+            AddFile(trainer, path, args.envelopeLines);
+            continue;
+        }
+        QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            AddFile(trainer, it.next(), args.envelopeLines);
+        }
+    }
+    if (trainer.SampleCount() == 0) {
+        fprintf(stderr, "サンプルがありません\n");
+        return 1;
+    }
+
+    QByteArray bytes = trainer.Train();
+    if (bytes.isEmpty() || !WebSocketApp::writeFile(args.output, bytes)) {
+        fprintf(stderr, "辞書の作成に失敗：%s\n", args.output.c_str());
+        return 1;
+    }
+    WebSocketApp::SocketDictionary dictionary(bytes);
+
+    int plainSmaller = 0;
+    int dictionarySmaller = 0;
+    int64_t plainTotal = Evaluate(trainer, nullptr, plainSmaller);
+    int64_t dictionaryTotal = Evaluate(trainer, &dictionary, dictionarySmaller);
+    printf("%s: %d bytes, id=%s\n", args.output.c_str(), bytes.length(), WebSocketApp::SocketDictionary::FormatId(dictionary.Id()).c_str());
+    printf("samples: %d (%lld bytes)\n", trainer.SampleCount(), (long long)trainer.SampleBytes());
+    printf("without dictionary: %lld bytes, %d compressed\n", (long long)plainTotal, plainSmaller);
+    printf("with dictionary:    %lld bytes, %d compressed\n", (long long)dictionaryTotal, dictionarySmaller);
+    return 0;
+}
@@ -0,0 +1,164 @@
+﻿#include "WebSocketApp.h"
+
+#include <QCoreApplication>
+#include <cstdio>
+#include <limits>
+
+// Feeds DecompressLz4() broken payloads, which it has to refuse without reading or writing out of bounds.
+//   Lz4Check
+//   Prints each case and exits with 1 when one of them fails. Worth running in a build with
+//   -fsanitize=address, which catches the accesses that happen to return the right result.
+
+namespace {
+
+int failures = 0;
+
+void Check(bool result, const char* name) {
+    printf("  %-48s %s\n", name, result ? "ok" : "失敗");
+    if (!result) {
+        ++failures;
+    }
+}
+
+// Log text with long repeats and some noise, so that there are literals and matches of every length
+QByteArray MakeText(int size) {
+    QByteArray bytes;
+    bytes.reserve(size);
+    uint32_t state = 2463534242u;
+    while (bytes.length() < size) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if ((state & 7) == 0) {
+            bytes.append(QByteArray((int)(state >> 20) % 600 + 1, (char)('a' + state % 26)));
+        } else {
+            bytes.append(QByteArray::number((int)(state % 100000)));
+            bytes.append(" [Info] Player position updated\n");
+        }
+    }
+    bytes.resize(size);
+    return bytes;
+}
+
+// Size prefix, then the sequences as given
+QByteArray MakePayload(uint32_t rawLength, const QByteArray& sequences) {
+    QByteArray payload(4, '\0');
+    for (int i = 0; i < 4; ++i) {
+        payload[i] = (char)(rawLength >> (i * 8));
+    }
+    payload.append(sequences);
+    return payload;
+}
+
+bool Refused(const QByteArray& payload) {
+    QByteArray dest;
+    return WebSocketApp::DecompressLz4(payload.constData(), payload.length(), dest) == -1;
+}
+
+void CheckRoundTrip() {
+    printf("round trip\n");
+    bool result = true;
+    for (int size : { 0, 1, 12, 13, 100, 4096, 65536 + 17, 1024 * 1024 }) {
+        QByteArray text = MakeText(size);
+        QByteArray compressed;
+        QByteArray decompressed;
+        result = result && WebSocketApp::CompressLz4(text.constData(), text.length(), compressed) > 0
+            && WebSocketApp::DecompressLz4(compressed.constData(), compressed.length(), decompressed) == size
+            && decompressed == text;
+    }
+    Check(result, "sizes 0 to 1MB");
+}
+
+void CheckTruncated() {
+    printf("truncated\n");
+    QByteArray text = MakeText(20000);
+    QByteArray compressed;
+    WebSocketApp::CompressLz4(text.constData(), text.length(), compressed);
+
+    bool result = true;
+    for (int length = 0; length < compressed.length(); ++length) {
+        result = result && Refused(compressed.left(length));
+    }
+    Check(result, "every prefix of a payload");
+    Check(Refused(MakePayload(100, QByteArray("\xf0", 1))), "literal length cut after the token");
+    Check(Refused(MakePayload(100, QByteArray("\xf0\xff\xff", 3))), "literal length cut inside a run of 255");
+    Check(Refused(MakePayload(5, QByteArray("\x1f" "a" "\x01", 3))), "offset cut in half");
+    Check(Refused(MakePayload(300, QByteArray("\x1f" "a" "\x01\x00\xff", 5))), "match length cut inside a run of 255");
+}
+
+void CheckCorrupt() {
+    printf("corrupt\n");
+    QByteArray text = MakeText(20000);
+    QByteArray compressed;
+    WebSocketApp::CompressLz4(text.constData(), text.length(), compressed);
+
+    // A changed byte may still decode to something of the right size, it must just stay in bounds
+    QByteArray dest;
+    uint32_t state = 88675123u;
+    for (int i = 0; i < 20000; ++i) {
+        QByteArray bad = compressed;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bad[4 + (int)(state % (uint32_t)(bad.length() - 4))] = (char)(state >> 24);
+        int length = WebSocketApp::DecompressLz4(bad.constData(), bad.length(), dest);
+        if (length != -1 && length != text.length()) {
+            Check(false, "random byte changes");
+            return;
+        }
+    }
+    Check(true, "random byte changes");
+
+    Check(Refused(MakePayload(5, QByteArray("\x00\x00\x00", 3))), "offset 0");
+    Check(Refused(MakePayload(10, QByteArray("\x1f" "a" "\x02\x00", 4))), "offset before the output");
+    Check(Refused(MakePayload(3, QByteArray("\x10" "a" "\x01\x00", 4))), "match past the end of the output");
+    Check(Refused(MakePayload(3, QByteArray("\x40" "abcd", 5))), "literals past the end of the output");
+    Check(Refused(MakePayload(10, QByteArray("\x30" "abc", 4))), "output shorter than its size");
+    Check(Refused(MakePayload(0x80000000u, QByteArray(0x900000, 'a'))), "size beyond int");
+    Check(Refused(MakePayload(1000000, QByteArray("\x10" "a", 2))), "size beyond the ratio");
+}
+
+void CheckOverflow() {
+    printf("overflow\n");
+    // 255 * 8.5M passes INT_MAX, the sum has to be refused long before
+    const int runLength = std::numeric_limits<int>::max() / 255 + 1024;
+    QByteArray run(runLength, '\xff');
+
+    QByteArray literal("\xf0", 1);
+    literal.append(run);
+    literal.append('\0');
+    Check(Refused(MakePayload(100000, literal)), "literal length");
+
+    QByteArray match("\x1f" "a" "\x01\x00", 4);
+    match.append(run);
+    match.append('\0');
+    Check(Refused(MakePayload(100000, match)), "match length");
+
+    // Long lengths that fit still decode
+    QByteArray sequences("\xff\x00", 2);
+    sequences.append(QByteArray(15, 'a'));
+    sequences.append("\x01\x00\xff\x00", 4);
+    sequences.append("\x10" "b", 2);
+    // 15 literals, a match of 15 + 255 + 4 and the last literal
+    QByteArray payload = MakePayload(290, sequences);
+    QByteArray expected(289, 'a');
+    expected.append('b');
+    QByteArray dest;
+    Check(WebSocketApp::DecompressLz4(payload.constData(), payload.length(), dest) == 290 && dest == expected,
+        "lengths past 15 that fit");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    CheckRoundTrip();
+    CheckTruncated();
+    CheckCorrupt();
+    CheckOverflow();
+
+    printf("%s\n", failures == 0 ? "OK" : "NG");
+    return (failures == 0) ? 0 : 1;
+}
@@ -1,12 +1,17 @@
 ﻿#include "ConnectionDialog.h"
 #include "MainWindow.h"
 #include "SocketMessage.h"
+#include "SocketUtf8.h"
 #include "ui_ConnectionDialog.h"
 
+#include <QDateTime>
 #include <QDir>
 #include <QStandardPaths>
 #include <QCloseEvent>
 
+// Milliseconds between clock synchronization exchanges
+static const int CLOCK_SYNC_INTERVAL = 2000;
+
 ConnectionDialog::ConnectionDialog(const std::string& address, ushort port, MainWindow *parent)
     : QDialog(parent)
     , ui(new Ui::ConnectionDialog)
@@ -15,6 +20,8 @@ ConnectionDialog::ConnectionDialog(const std::string& address, ushort port, Main
     , _address(address)
     , _port(port)
     , _connectFlag(false)
+    , _batchTimer(nullptr)
+    , _clockSyncTimer(nullptr)
 {
     ui->setupUi(this);
     ui->log->setTextColor(WebSocketApp::LOG_NORMAL_COLOR);
@@ -25,6 +32,25 @@ ConnectionDialog::ConnectionDialog(const std::string& address, ushort port, Main
         ui->pathButtonGroup->setId(button, i);
     }
 
+    _batchTimer = new QTimer(this);
+    _batchTimer->setSingleShot(true);
+    _batchTimer->setTimerType(Qt::PreciseTimer);
+    connect(_batchTimer, &QTimer::timeout, this, &ConnectionDialog::onBatchTimeout);
+
+    _clockSyncTimer = new QTimer(this);
+    _clockSyncTimer->setInterval(CLOCK_SYNC_INTERVAL);
+    connect(_clockSyncTimer, &QTimer::timeout, this, &ConnectionDialog::onClockSyncTimeout);
+
+    // Commands are a few dozen bytes of JSON where gzip only adds its header and latency;
+    //   batches of them are worth it once a handful has piled up
+    const int COMMAND_MINIMUM_SIZE = 1024;
+    _compressionPolicy.SetMinimumSize(SocketMoveGameObjectMessage::TYPE_ID, COMMAND_MINIMUM_SIZE);
+    _compressionPolicy.SetMinimumSize(SocketScreenShotRequestMessage::TYPE_ID, COMMAND_MINIMUM_SIZE);
+    _compressionPolicy.SetMinimumSize(SocketFileListRequestMessage::TYPE_ID, COMMAND_MINIMUM_SIZE);
+    _compressionPolicy.SetMinimumSize(SocketFileUploadRequestMessage::TYPE_ID, COMMAND_MINIMUM_SIZE);
+    _compressionPolicy.SetMinimumSize(SocketConnectGameObjectRequestMessage::TYPE_ID, COMMAND_MINIMUM_SIZE);
+    _compressionPolicy.SetMinimumSize(WebSocketApp::SocketFrameBatch::TYPE_ID, 512);
+
     UpdatePath();
     UpdateConnectFlag();
 }
@@ -45,10 +71,13 @@ bool ConnectionDialog::Open() {
     Close();
 
     _socket = new QWebSocket();
+    // The limits of QWebSocket hold until the device negotiates its own
+    _binaryDecoder.SetMaxFrameSize(0);
     connect(_socket, &QWebSocket::connected, this, &ConnectionDialog::onConnected);
     connect(_socket, &QWebSocket::disconnected, this, &ConnectionDialog::onClosed);
     connect(_socket, &QWebSocket::aboutToClose, this, &ConnectionDialog::onAboutToClose);
     connect(_socket, &QWebSocket::stateChanged, this, &ConnectionDialog::onStateChanged);
+    connect(_socket, &QWebSocket::bytesWritten, this, &ConnectionDialog::onBytesWritten);
     connect(_socket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), [=](QAbstractSocket::SocketError error) {
         onError(error);
     });
@@ -60,10 +89,12 @@ bool ConnectionDialog::Open() {
 
 void ConnectionDialog::Close() {
     if (_socket != nullptr) {
+        FlushBatch();
+        _clockSyncTimer->stop();
         _socket->close();
 
-        disconnect(_socket, &QWebSocket::textMessageReceived, this, &ConnectionDialog::onTextMessageReceived);
-        disconnect(_socket, &QWebSocket::binaryMessageReceived, this, &ConnectionDialog::onBinaryMessageReceived);
+        disconnect(_socket, &QWebSocket::textFrameReceived, this, &ConnectionDialog::onTextFrameReceived);
+        disconnect(_socket, &QWebSocket::binaryFrameReceived, this, &ConnectionDialog::onBinaryFrameReceived);
 
         delete _socket;
         _socket = nullptr;
@@ -86,9 +117,18 @@ void ConnectionDialog::UpdateConnectFlag() {
 
 void ConnectionDialog::onConnected() {
     SetConnectFlag(true);
-
-    connect(_socket, &QWebSocket::textMessageReceived, this, &ConnectionDialog::onTextMessageReceived);
-    connect(_socket, &QWebSocket::binaryMessageReceived, this, &ConnectionDialog::onBinaryMessageReceived);
+    _options = WebSocketApp::SocketConnectionOptions();
+    SetCompressionContexts(_options);
+    _takeoverDeflater.Reset();
+    _compressionPolicy.Clear();
+    _batch.Clear();
+    _clock.Clear();
+    _textDecoder.Clear();
+    _binaryDecoder.Reset();
+
+    // Frame by frame, so that decoding overlaps with the transfer of large messages
+    connect(_socket, &QWebSocket::textFrameReceived, this, &ConnectionDialog::onTextFrameReceived);
+    connect(_socket, &QWebSocket::binaryFrameReceived, this, &ConnectionDialog::onBinaryFrameReceived);
 
     SocketRequestMessage message(SocketConnectionInformationMessage::MESSAGE_TYPE);
     SendMessage(message);
@@ -98,12 +138,20 @@ void ConnectionDialog::onConnected() {
 
 void ConnectionDialog::onClosed() {
     SetConnectFlag(false);
+    _clockSyncTimer->stop();
 
     WriteInfoLog(QFORMAT_STR("WebSocket切断: アドレス=%s, ポート=%d", _address.c_str(), _port));
 }
 
-void ConnectionDialog::onTextMessageReceived(const QString &src) {
-    SocketMessageBase* message = SocketMessageBase::ImportMessage(src);
+void ConnectionDialog::onTextFrameReceived(const QString &frame, bool isLastFrame) {
+    // The envelope is ASCII
+    QByteArray bytes = frame.toLatin1();
+    _textDecoder.Append(bytes.constData(), bytes.length());
+    if (!isLastFrame) {
+        return;
+    }
+
+    SocketMessageBase* message = _textDecoder.Finish();
     AcceptMessage(message);
     if (message != nullptr) {
         delete message;
@@ -111,8 +159,56 @@ void ConnectionDialog::onTextMessageReceived(const QString &src) {
     }
 }
 
-void ConnectionDialog::onBinaryMessageReceived(const QByteArray &message) {
-    WriteErrorLog(QFORMAT_STR("バイナリメッセージを受信しましたが、対応していません(length=%d)", message.length()));
+void ConnectionDialog::onBinaryFrameReceived(const QByteArray &frame, bool isLastFrame) {
+    _binaryDecoder.Append(frame.constData(), frame.length());
+    if (!isLastFrame) {
+        return;
+    }
+
+    QByteArray message;
+    if (!_binaryDecoder.Finish(message)) {
+        WriteErrorLog("バイナリメッセージの読み込みに失敗しました");
+        return;
+    }
+    AcceptBinaryMessage(message);
+}
+
+void ConnectionDialog::AcceptBinaryMessage(const QByteArray &src) {
+    WebSocketApp::SocketFrameHeader header;
+    if (!header.Read(src.constData(), src.length()) || !header.HasFlag(WebSocketApp::SocketFrameHeader::Batch)) {
+        AcceptBinaryFrame(src);
+        return;
+    }
+
+    QByteArray buffer;
+    std::vector<QByteArray> frames;
+    if (!WebSocketApp::SocketFrameBatch::Unpack(src, buffer, frames)) {
+        WriteErrorLog(QFORMAT_STR("バッチの読み込みに失敗しました(length=%d)", src.length()));
+        return;
+    }
+    for (const auto& frame : frames) {
+        AcceptBinaryFrame(frame);
+    }
+}
+
+void ConnectionDialog::AcceptBinaryFrame(const QByteArray& frame) {
+    WebSocketApp::SocketFrameHeader header;
+    SocketMessageBase* message = SocketMessageBase::ImportBinaryMessage(frame, &header);
+    if (message == nullptr) {
+        WriteErrorLog(QFORMAT_STR("バイナリメッセージの読み込みに失敗しました(length=%d)", frame.length()));
+        return;
+    }
+
+    // Without a negotiation the device still understands what it sent, so answer in kind from now on
+    if (!_options.IsNegotiated()) {
+        _options.SetBinaryFrame(true);
+        _options.SetFrameVersion(header.Version());
+        _options.SetEncoding(header.Encoding());
+    }
+
+    AcceptMessage(message);
+    delete message;
+    message = nullptr;
 }
 
 bool ConnectionDialog::AcceptMessage(SocketMessageBase* message) {
@@ -120,22 +216,22 @@ bool ConnectionDialog::AcceptMessage(SocketMessageBase* message) {
         return false;
     }
 
-    if (message->MessageType() == SocketLogMessage::MESSAGE_TYPE) {
-        return AcceptMessage(dynamic_cast<SocketLogMessage*>(message));
-    } else if (message->MessageType() == SocketConnectionInformationMessage::MESSAGE_TYPE) {
-        return AcceptMessage(dynamic_cast<SocketConnectionInformationMessage*>(message));
-    } else if (message->MessageType() == SocketFileListMessage::MESSAGE_TYPE) {
-        return AcceptMessage(dynamic_cast<SocketFileListMessage*>(message));
-    } else if (message->MessageType() == SocketFileMessage::MESSAGE_TYPE) {
-        return AcceptMessage(dynamic_cast<SocketFileMessage*>(message));
-    } else if (message->MessageType() == SocketScreenShotMessage::MESSAGE_TYPE) {
-        return AcceptMessage(dynamic_cast<SocketScreenShotMessage*>(message));
-    } else {
+    static const auto dispatcher = SocketMessageDispatcher<ConnectionDialog>()
+        .Register<SocketLogMessage>()
+        .Register<SocketConnectionInformationMessage>()
+        .Register<SocketCapabilityMessage>()
+        .Register<SocketClockSyncMessage>()
+        .Register<SocketFileListMessage>()
+        .Register<SocketFileMessage>()
+        .Register<SocketScreenShotMessage>();
+
+    auto handler = dispatcher.Find(message->TypeId());
+    if (handler == nullptr) {
         WriteErrorLog(QFORMAT_STR("不明なテキストメッセージを受信しました：%s", message->MessageType().c_str()));
         return false;
     }
 
-    return false;
+    return handler(*this, message);
 }
 
 bool ConnectionDialog::AcceptMessage(SocketLogMessage* message) {
@@ -143,7 +239,10 @@ bool ConnectionDialog::AcceptMessage(SocketLogMessage* message) {
         return false;
     }
 
-    QString log = QFORMAT_STR("[%s] ", message->Time().c_str()) + message->Log().c_str();
+    // The text stays UTF-8 from the payload up to here and is converted once, straight into the line
+    const std::string& text = message->Log();
+    QString log = "[" + FormatRemoteTime(message->Timestamp(), message->Time()) + "] ";
+    WebSocketApp::AppendUtf16(log, text.data(), static_cast<int>(text.size()));
     WriteLog(message->Type(), log);
     return true;
 }
@@ -155,6 +254,61 @@ bool ConnectionDialog::AcceptMessage(SocketConnectionInformationMessage* message
 
     auto title = QFORMAT_STR("デバイス[%s(%s)] で動作中のアプリケーション[%s]に接続中", message->DeviceName().c_str(), message->DeviceModel().c_str(), message->ApplicationName().c_str());
     setWindowTitle(title);
+
+    // Only devices that advertise binary frames know SocketCapabilityMessage, older builds would log it as unknown
+    if (message->FrameVersion() >= WebSocketApp::SocketFrameHeader::VERSION_MIN && !_options.IsNegotiated()) {
+        SendMessage(SocketCapabilityMessage());
+    }
+    return true;
+}
+
+bool ConnectionDialog::AcceptMessage(SocketCapabilityMessage* message) {
+    if (message == nullptr) {
+        return false;
+    }
+
+    SocketCapabilityMessage local;
+    _options = local.Negotiate(*message);
+    SetCompressionContexts(_options);
+    _binaryDecoder.SetMaxFrameSize(local.MaxFrameSize());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    _socket->setMaxAllowedIncomingMessageSize(local.MaxFrameSize());
+    if (_options.ChunkSize() > 0) {
+        _socket->setOutgoingFrameSize(_options.ChunkSize());
+    }
+#endif
+
+    WriteInfoLog(QFORMAT_STR("通信設定: フレーム=%s, エンコード=%s, 圧縮=%s(%d), 最大サイズ=%d, 分割サイズ=%d",
+        _options.IsBinaryFrame() ? "binary" : "text",
+        _options.Encoding() == WebSocketApp::PayloadEncoding::Cbor ? SocketCapabilityMessage::ENCODING_CBOR : SocketCapabilityMessage::ENCODING_JSON,
+        SocketCapabilityMessage::CodecName(_options.Codec()),
+        _options.CompressionLevel(), _options.MaxFrameSize(), _options.ChunkSize()));
+
+    if (IsClockSyncEnabled()) {
+        onClockSyncTimeout();
+        _clockSyncTimer->start();
+    }
+    return true;
+}
+
+bool ConnectionDialog::AcceptMessage(SocketClockSyncMessage* message) {
+    if (message == nullptr) {
+        return false;
+    }
+
+    int64_t now = WebSocketApp::MonotonicTime();
+    if (!message->IsReply()) {
+        // Exchange started by the device
+        SocketClockSyncMessage reply;
+        reply.SetOriginateTime(message->OriginateTime());
+        reply.SetReceiveTime(now);
+        reply.SetTransmitTime(WebSocketApp::MonotonicTime());
+        return SendMessage(reply);
+    }
+
+    _clock.AddSample(message->OriginateTime(), message->ReceiveTime(), message->TransmitTime(), now);
+    DEBUG_OUTPUT_INFO_LOG("時刻同期: オフセット=%lldus, ドリフト=%.2fppm, 往復遅延=%lldus",
+        (long long)_clock.Offset(), _clock.Drift() * 1e6, (long long)_clock.RoundTripDelay());
     return true;
 }
 
@@ -163,19 +317,40 @@ bool ConnectionDialog::AcceptMessage(SocketFileListMessage* message) {
         return false;
     }
 
+    const WebSocketApp::SocketPathList* files = &message->Files();
+    const WebSocketApp::SocketPathList* directories = &message->Directories();
+
+    auto it = _fileListRequestMap.find(message->RequestId());
+    if (it != _fileListRequestMap.end()) {
+        auto& request = it->second;
+        request.files.Append(*files);
+        request.directories.Append(*directories);
+
+        if (message->HasNextPage()) {
+            DEBUG_OUTPUT_INFO_LOG("ファイルリスト受信中: ディレクトリ数=%d ファイル数=%d", request.directories.Count(), request.files.Count());
+            SocketFileListRequestMessage nextRequest(request.directoryType, request.targetPath, message->ContinuationToken());
+            SendMessage(nextRequest);
+            _fileListRequestMap[nextRequest.RequestId()] = std::move(request);
+            _fileListRequestMap.erase(message->RequestId());
+            return true;
+        }
+        files = &request.files;
+        directories = &request.directories;
+    }
 
     WriteInfoLog(QFORMAT_STR("ファイルリスト: ディレクトリ=%s", message->Directory().c_str()));
-    WriteInfoLog(QFORMAT_STR("【ディレクトリ数: %d】", message->Directories().size()));
-    for (int i = 0, count = message->Directories().size(); i < count; ++i) {
-        const auto& directory = message->Directories()[i];
-        WriteInfoLog(QFORMAT_STR("  [%d] %s", i, directory.c_str()));
+    WriteInfoLog(QFORMAT_STR("【ディレクトリ数: %d】", directories->Count()));
+    for (int i = 0, count = directories->Count(); i < count; ++i) {
+        auto directory = directories->At(i);
+        WriteInfoLog(QFORMAT_STR("  [%d] %.*s", i, static_cast<int>(directory.size()), directory.data()));
     }
-    WriteInfoLog(QFORMAT_STR("【ファイル数: %d】", message->Files().size()));
-    for (int i = 0, count = message->Files().size(); i < count; ++i) {
-        const auto& file = message->Files()[i];
-        WriteInfoLog(QFORMAT_STR("  [%d] %s", i, file.c_str()));
+    WriteInfoLog(QFORMAT_STR("【ファイル数: %d】", files->Count()));
+    for (int i = 0, count = files->Count(); i < count; ++i) {
+        auto file = files->At(i);
+        WriteInfoLog(QFORMAT_STR("  [%d] %.*s", i, static_cast<int>(file.size()), file.data()));
     }
 
+    _fileListRequestMap.erase(message->RequestId());
     return true;
 }
 
@@ -200,12 +375,8 @@ bool ConnectionDialog::AcceptMessage(SocketFileMessage* message) {
     QDir downloadDirectory(downloadDirectoryPath);
     QString filePath = downloadDirectory.absoluteFilePath(fileName.c_str());
 
-    std::vector<char> buffer;
-    {
-        buffer.resize(message->Bytes().count());
-        memcpy(&(buffer[0]), message->Bytes().data(), buffer.size());
-    }
-    if (!WebSocketApp::writeFile(filePath.toLocal8Bit().data(), buffer)) {
+    // Decoded straight into the file
+    if (!message->Data().DecodeTo(filePath.toLocal8Bit().data())) {
         return false;
     }
     WriteInfoLog(QFORMAT_STR("ファイルを受信しました：%s", filePath.toUtf8().data()));
@@ -219,7 +390,7 @@ bool ConnectionDialog::AcceptMessage(SocketScreenShotMessage* message) {
     }
 
     ui->image->SetImage(message->Bytes());
-    ui->imageDate->setText(QFORMAT_STR("%s", message->DateTime().c_str()));
+    ui->imageDate->setText(FormatRemoteTime(message->Timestamp(), message->DateTime()));
 
     return true;
 }
@@ -229,15 +400,139 @@ bool ConnectionDialog::SendMessage(const SocketMessageBase& message) {
         return false;
     }
 
-    QString payload;
-    if (!message.ExportMessage(payload)) {
+    QByteArray payload;
+    if (IsBatchEnabled()) {
+        // Decided before exporting, so that a large attachment is not serialized twice
+        const WebSocketApp::SocketAttachment* attachment = message.Attachment();
+        if (attachment == nullptr || attachment->Size() < _options.BatchMaxBytes()) {
+            // A batch is compressed as a whole, not frame by frame
+            WebSocketApp::SocketConnectionOptions frameOptions = _options;
+            frameOptions.SetCodec(WebSocketApp::CompressionCodec::None);
+            return ExportMessage(message, frameOptions, payload) && QueueBatch(payload);
+        }
+
+        // Too large to batch: send what is queued first to keep the order
+        FlushBatch();
+    }
+    if (!ExportMessage(message, _options, payload)) {
+        return false;
+    }
+
+    if (_options.MaxFrameSize() > 0 && payload.length() > _options.MaxFrameSize()) {
+        WriteErrorLog(QFORMAT_STR("メッセージがデバイスの最大サイズを超えています：%s(%d > %d)", message.MessageType().c_str(), payload.length(), _options.MaxFrameSize()));
+        // The stream may hold what is not sent, so the device is told to start over with the next frame
+        if (_options.IsContextTakeover()) {
+            _takeoverDeflater.Reset();
+        }
         return false;
     }
-    _socket->sendTextMessage(payload);
+
+    if (_options.IsBinaryFrame()) {
+        _compressionPolicy.RecordQueued(_socket->sendBinaryMessage(payload));
+    } else {
+        _compressionPolicy.RecordQueued(_socket->sendTextMessage(QString::fromLatin1(payload)));
+    }
 
     return true;
 }
 
+bool ConnectionDialog::ExportMessage(const SocketMessageBase& message, const WebSocketApp::SocketConnectionOptions& options, QByteArray& payload) {
+    // Cacheable messages stay standalone gzip members under context takeover, so that the cache still works
+    WebSocketApp::SocketConnectionOptions messageOptions = options;
+    if (message.IsCacheable()) {
+        messageOptions.SetTakeoverDeflater(nullptr);
+    }
+
+    auto& cache = WebSocketApp::SocketMessageCache::Instance();
+    std::string key;
+    bool cacheable = message.CacheKey(messageOptions, key);
+    if (cacheable && cache.Find(key, payload)) {
+        if (messageOptions.IsBinaryFrame()) {
+            WebSocketApp::SocketFrameHeader::RewriteTimestamp(payload, message.Timestamp());
+        }
+        return true;
+    }
+
+    bool result = (messageOptions.IsBinaryFrame() ? message.ExportBinaryMessage(payload, messageOptions) : message.ExportMessage(payload, messageOptions));
+    if (!result) {
+        WriteErrorLog(QFORMAT_STR("メッセージを送信できません：%s", message.MessageType().c_str()));
+    } else if (cacheable) {
+        cache.Insert(key, payload);
+    }
+    return result;
+}
+
+bool ConnectionDialog::QueueBatch(const QByteArray& frame) {
+    _batch.Append(frame);
+    if (_batch.Count() >= _options.BatchMaxMessages() || _batch.Size() >= _options.BatchMaxBytes()) {
+        return FlushBatch();
+    }
+
+    // A delay under 1ms becomes a 0ms timer, which fires once the current burst of sends is over
+    if (!_batchTimer->isActive()) {
+        _batchTimer->start(_options.BatchDelay() / 1000);
+    }
+    return true;
+}
+
+bool ConnectionDialog::FlushBatch() {
+    _batchTimer->stop();
+    if (_batch.IsEmpty()) {
+        return true;
+    }
+
+    QByteArray frame;
+    bool result = (IsConnect() && _batch.Export(frame, _options));
+    _batch.Clear();
+    if (!result) {
+        return false;
+    }
+
+    _compressionPolicy.RecordQueued(_socket->sendBinaryMessage(frame));
+    return true;
+}
+
+void ConnectionDialog::SetCompressionContexts(WebSocketApp::SocketConnectionOptions& options) {
+    options.SetDeflater(&_deflater);
+    options.SetTakeoverDeflater(&_takeoverDeflater);
+    options.SetCompressionPolicy(&_compressionPolicy);
+}
+
+void ConnectionDialog::onBytesWritten(qint64 bytes) {
+    _compressionPolicy.RecordWritten(bytes);
+}
+
+void ConnectionDialog::onBatchTimeout() {
+    FlushBatch();
+}
+
+void ConnectionDialog::onClockSyncTimeout() {
+    if (!IsConnect()) {
+        return;
+    }
+
+    // Sent on its own right away, so that neither batching nor compression delays it
+    FlushBatch();
+    WebSocketApp::SocketConnectionOptions options = _options;
+    options.SetCodec(WebSocketApp::CompressionCodec::None);
+
+    SocketClockSyncMessage message;
+    QByteArray frame;
+    if (message.ExportBinaryMessage(frame, options)) {
+        _compressionPolicy.RecordQueued(_socket->sendBinaryMessage(frame));
+    }
+}
+
+QString ConnectionDialog::FormatRemoteTime(int64_t remoteTime, const std::string& fallback) const {
+    if (remoteTime == 0 || !_clock.IsValid()) {
+        return QString::fromStdString(fallback);
+    }
+
+    int64_t localTime = _clock.ToLocal(remoteTime);
+    auto dateTime = QDateTime::fromMSecsSinceEpoch(WebSocketApp::MonotonicToWallTime(localTime));
+    return dateTime.toString("HH:mm:ss.zzz") + QFORMAT_STR(" (%.3fms)", (WebSocketApp::MonotonicTime() - localTime) / 1000.0);
+}
+
 void ConnectionDialog::onError(QAbstractSocket::SocketError error) {
     WriteErrorLog(QFORMAT_STR("SocketError: code(%d)", (int)error));
 }
@@ -327,7 +622,9 @@ void ConnectionDialog::on_stopUpdate_clicked()
 void ConnectionDialog::on_FileListButton_clicked()
 {
     UnityDirectoryType type = static_cast<UnityDirectoryType>(ui->pathButtonGroup->checkedId());
-    SendMessage(SocketFileListRequestMessage(type, ui->fileName->text().toUtf8().data()));
+    SocketFileListRequestMessage message(type, ui->fileName->text().toUtf8().data());
+    SendMessage(message);
+    _fileListRequestMap[message.RequestId()] = FileListRequest(type, message.TargetPath());
 }
 
 void ConnectionDialog::on_downloadButton_clicked()
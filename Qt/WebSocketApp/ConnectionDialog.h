@@ -3,8 +3,13 @@
 
 #include "WebSocketApp.h"
 #include "SocketMessage.h"
+#include "SocketFrameBatch.h"
+#include "SocketStreamDecoder.h"
+#include "SocketMessageCache.h"
+#include "SocketCompressionPolicy.h"
 
 #include <QDialog>
+#include <QTimer>
 #include <QWebSocket>
 #include <QGraphicsScene>
 
@@ -18,6 +23,8 @@ class ConnectionDialog : public QDialog
 {
     Q_OBJECT
 
+    friend class SocketMessageDispatcher<ConnectionDialog>;
+
 public:
     explicit ConnectionDialog(const std::string& address, ushort port, MainWindow *parent);
     ~ConnectionDialog();
@@ -57,8 +64,11 @@ private slots:
     void onClosed();
     void onError(QAbstractSocket::SocketError error);
     void onStateChanged(QAbstractSocket::SocketState state);
-    void onTextMessageReceived(const QString &message);
-    void onBinaryMessageReceived(const QByteArray &message);
+    void onTextFrameReceived(const QString &frame, bool isLastFrame);
+    void onBinaryFrameReceived(const QByteArray &frame, bool isLastFrame);
+    void onBytesWritten(qint64 bytes);
+    void onBatchTimeout();
+    void onClockSyncTimeout();
 
     void on_ClearButton_clicked();
     void on_ConnectButton_clicked();
@@ -93,11 +103,34 @@ private:
     std::string _address;
     ushort _port;
     bool _connectFlag;
+    // Kept for the life of the dialog, so reconnecting does not set up zlib again
+    WebSocketApp::GZipDeflater _deflater;
+    WebSocketApp::StreamDeflater _takeoverDeflater;
+    WebSocketApp::SocketCompressionPolicy _compressionPolicy;
+    WebSocketApp::SocketConnectionOptions _options;
+    WebSocketApp::SocketFrameBatch _batch;
+    QTimer* _batchTimer;
+    WebSocketApp::SocketClockEstimator _clock;
+    QTimer* _clockSyncTimer;
+    WebSocketApp::SocketTextStreamDecoder _textDecoder;
+    WebSocketApp::SocketBinaryStreamDecoder _binaryDecoder;
     std::string _path;
     int _manipulateTarget;
 
     std::map<int, std::string> _fileRequestMap;
 
+    // A file listing being received page by page, keyed by the RequestId of the next page
+    struct FileListRequest {
+        FileListRequest() : directoryType() {}
+        FileListRequest(UnityDirectoryType type, const std::string& path) : directoryType(type), targetPath(path) {}
+
+        UnityDirectoryType directoryType;
+        std::string targetPath;
+        WebSocketApp::SocketPathList files;
+        WebSocketApp::SocketPathList directories;
+    };
+    std::map<int, FileListRequest> _fileListRequestMap;
+
     const std::string& UpdatePath() {
         _path = WebSocketApp::StringBuilder::Format("ws://%s:%d%s", _address.c_str(), _port, WebSocketApp::SOCKET_PATH);
         return _path;
@@ -109,9 +142,13 @@ private:
     }
     void UpdateConnectFlag();
 
+    void SetCompressionContexts(WebSocketApp::SocketConnectionOptions& options);
+
     bool AcceptMessage(SocketMessageBase* message);
     bool AcceptMessage(SocketLogMessage* message);
     bool AcceptMessage(SocketConnectionInformationMessage* message);
+    bool AcceptMessage(SocketCapabilityMessage* message);
+    bool AcceptMessage(SocketClockSyncMessage* message);
     bool AcceptMessage(SocketFileListMessage* message);
     bool AcceptMessage(SocketFileMessage* message);
     bool AcceptMessage(SocketScreenShotMessage* message);
@@ -127,7 +164,22 @@ private:
     bool WriteLog(SocketLogMessage::LogType logType, const QString& log);
     void WriteLog(const QString& log);
 
+    void AcceptBinaryMessage(const QByteArray& message);
+    void AcceptBinaryFrame(const QByteArray& frame);
+
     bool SendMessage(const SocketMessageBase& message);
+    bool ExportMessage(const SocketMessageBase& message, const WebSocketApp::SocketConnectionOptions& options, QByteArray& payload);
+    bool IsBatchEnabled() const {
+        return _options.IsBinaryFrame() && _options.BatchMaxMessages() > 0;
+    }
+    bool QueueBatch(const QByteArray& frame);
+    bool FlushBatch();
+
+    bool IsClockSyncEnabled() const {
+        return _options.IsBinaryFrame() && _options.FrameVersion() >= WebSocketApp::SocketFrameHeader::VERSION_TIMESTAMP;
+    }
+    // Device time of a message as local wall clock time and its age, or fallback before the clocks are synchronized
+    QString FormatRemoteTime(int64_t remoteTime, const std::string& fallback) const;
 
     void closeEvent(QCloseEvent *event) override;
 };
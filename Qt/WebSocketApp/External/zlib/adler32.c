@@ -6,6 +6,7 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "cpu_features.h"
 
 local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 
@@ -87,6 +88,22 @@ uLong ZEXPORT adler32_z(adler, buf, len)
     if (buf == Z_NULL)
         return 1L;
 
+#if defined(ZLIB_SIMD_X86)
+    if (len >= Z_ADLER32_SIMD_MINIMUM_LENGTH) {
+        cpu_check_features();
+        if (x86_cpu_enable_avx2)
+            return adler32_avx2(adler | (sum2 << 16), buf, len);
+        if (x86_cpu_enable_ssse3)
+            return adler32_ssse3(adler | (sum2 << 16), buf, len);
+    }
+#elif defined(ZLIB_SIMD_ARM)
+    if (len >= Z_ADLER32_SIMD_MINIMUM_LENGTH) {
+        cpu_check_features();
+        if (arm_cpu_enable_neon)
+            return adler32_neon(adler | (sum2 << 16), buf, len);
+    }
+#endif
+
     /* in case short lengths are provided, keep it somewhat fast */
     if (len < 16) {
         while (len--) {
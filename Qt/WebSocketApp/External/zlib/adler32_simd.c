@@ -0,0 +1,227 @@
+/* adler32_simd.c -- Adler-32 with SSSE3, AVX2 or NEON
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Per block of n bytes b[0..n-1], s1 grows by the byte sum and s2 by n*s1 plus the sum of
+ * (n-i)*b[i]. The kernels compute both sums for 32 byte blocks with widening multiply-adds
+ * and reduce modulo BASE once per NMAX bytes, as the portable code does.
+ */
+
+#include "cpu_features.h"
+
+#define BASE 65521U     /* largest prime smaller than 65536 */
+#define NMAX 5552
+#define BLOCK_SIZE 32
+
+/* the bytes left over after the blocks */
+local uLong adler32_tail OF((unsigned s1, unsigned s2, const unsigned char FAR *buf, z_size_t len));
+
+local uLong adler32_tail(s1, s2, buf, len)
+    unsigned s1;
+    unsigned s2;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    while (len--) {
+        s1 += *buf++;
+        s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+    return s1 | ((uLong)s2 << 16);
+}
+
+#if defined(ZLIB_SIMD_X86)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+ZLIB_TARGET("ssse3")
+uLong ZLIB_INTERNAL adler32_ssse3(adler, buf, len)
+    uLong adler;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    unsigned s1 = (unsigned)(adler & 0xffff);
+    unsigned s2 = (unsigned)(adler >> 16);
+    z_size_t blocks = len / BLOCK_SIZE;
+
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        __m128i v_ps, v_s1, v_s2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        /* v_ps collects s1 at the start of every block, which counts BLOCK_SIZE times for s2 */
+        v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        v_s1 = zero;
+
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        /* horizontal sums */
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (unsigned)_mm_cvtsi128_si32(v_s1);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (unsigned)_mm_cvtsi128_si32(v_s2);
+
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+ZLIB_TARGET("avx2")
+uLong ZLIB_INTERNAL adler32_avx2(adler, buf, len)
+    uLong adler;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    unsigned s1 = (unsigned)(adler & 0xffff);
+    unsigned s2 = (unsigned)(adler >> 16);
+    z_size_t blocks = len / BLOCK_SIZE;
+
+    const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                         16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        __m256i v_ps, v_s1, v_s2;
+        __m128i sum1, sum2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)s2);
+        v_s1 = zero;
+
+        do {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i *)buf);
+
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+        sum1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (unsigned)_mm_cvtsi128_si32(sum1);
+
+        sum2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (unsigned)_mm_cvtsi128_si32(sum2);
+
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#elif defined(ZLIB_SIMD_ARM)
+
+#include <arm_neon.h>
+
+uLong ZLIB_INTERNAL adler32_neon(adler, buf, len)
+    uLong adler;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    static const uint16_t taps[16] = { 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17 };
+    static const uint16_t taps_low[16] = { 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    unsigned s1 = (unsigned)(adler & 0xffff);
+    unsigned s2 = (unsigned)(adler >> 16);
+    z_size_t blocks = len / BLOCK_SIZE;
+
+    len -= blocks * BLOCK_SIZE;
+    while (blocks) {
+        unsigned n = NMAX / BLOCK_SIZE;
+        uint32x4_t v_s1 = vdupq_n_u32(0);
+        uint32x4_t v_s2 = vdupq_n_u32(0);
+        uint16x8_t column1 = vdupq_n_u16(0);
+        uint16x8_t column2 = vdupq_n_u16(0);
+        uint16x8_t column3 = vdupq_n_u16(0);
+        uint16x8_t column4 = vdupq_n_u16(0);
+        uint32x2_t sum1, sum2, s1s2;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_s2 = vsetq_lane_u32(s1 * n, v_s2, 0);
+
+        do {
+            const uint8x16_t bytes1 = vld1q_u8(buf);
+            const uint8x16_t bytes2 = vld1q_u8(buf + 16);
+
+            v_s2 = vaddq_u32(v_s2, v_s1);
+            v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(bytes1), bytes2));
+
+            /* per column byte sums, weighted once after the loop (at most 173 * 255) */
+            column1 = vaddw_u8(column1, vget_low_u8(bytes1));
+            column2 = vaddw_u8(column2, vget_high_u8(bytes1));
+            column3 = vaddw_u8(column3, vget_low_u8(bytes2));
+            column4 = vaddw_u8(column4, vget_high_u8(bytes2));
+
+            buf += BLOCK_SIZE;
+        } while (--n);
+
+        v_s2 = vshlq_n_u32(v_s2, 5);
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column1), vld1_u16(taps));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column1), vld1_u16(taps + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column2), vld1_u16(taps + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column2), vld1_u16(taps + 12));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column3), vld1_u16(taps_low));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column3), vld1_u16(taps_low + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(column4), vld1_u16(taps_low + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(column4), vld1_u16(taps_low + 12));
+
+        sum1 = vpadd_u32(vget_low_u32(v_s1), vget_high_u32(v_s1));
+        sum2 = vpadd_u32(vget_low_u32(v_s2), vget_high_u32(v_s2));
+        s1s2 = vpadd_u32(sum1, sum2);
+
+        s1 += vget_lane_u32(s1s2, 0);
+        s2 += vget_lane_u32(s1s2, 1);
+
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/* cpu_features.c -- runtime detection of the SIMD extensions used by zlib
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "cpu_features.h"
+
+#if defined(ZLIB_SIMD_X86) && defined(_MSC_VER)
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
+int ZLIB_INTERNAL x86_cpu_enable_pclmul = 0;
+int ZLIB_INTERNAL x86_cpu_enable_ssse3 = 0;
+int ZLIB_INTERNAL x86_cpu_enable_avx2 = 0;
+int ZLIB_INTERNAL arm_cpu_enable_neon = 0;
+int ZLIB_INTERNAL arm_cpu_enable_crc32 = 0;
+
+local volatile int cpu_checked = 0;
+local volatile int simd_enabled = 1;
+
+local void detect_features OF((void));
+
+#if defined(ZLIB_SIMD_X86) && defined(_MSC_VER)
+local void detect_features()
+{
+    int regs[4];
+    int max_leaf;
+    int has_osxsave;
+
+    __cpuid(regs, 0);
+    max_leaf = regs[0];
+
+    __cpuid(regs, 1);
+    x86_cpu_enable_ssse3 = (regs[2] & (1 << 9)) != 0;
+    x86_cpu_enable_pclmul = (regs[2] & (1 << 1)) != 0 && (regs[2] & (1 << 19)) != 0;
+    has_osxsave = (regs[2] & (1 << 27)) != 0;
+
+    /* AVX2 also needs the OS to save the YMM registers */
+    if (max_leaf >= 7 && has_osxsave && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(regs, 7, 0);
+        x86_cpu_enable_avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+}
+#elif defined(ZLIB_SIMD_X86)
+local void detect_features()
+{
+    __builtin_cpu_init();
+    x86_cpu_enable_ssse3 = __builtin_cpu_supports("ssse3");
+    x86_cpu_enable_pclmul = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("pclmul");
+    x86_cpu_enable_avx2 = __builtin_cpu_supports("avx2");
+}
+#elif defined(ZLIB_SIMD_ARM)
+local void detect_features()
+{
+#  if defined(__aarch64__) || defined(_M_ARM64)
+    /* Advanced SIMD is part of ARMv8-A */
+    arm_cpu_enable_neon = 1;
+#  elif defined(__ARM_NEON)
+    arm_cpu_enable_neon = 1;
+#  endif
+    /* The CRC32 instructions are optional in ARMv8.0, so only a build that
+       targets them (-march=armv8-a+crc) uses them */
+#  if defined(__ARM_FEATURE_CRC32)
+    arm_cpu_enable_crc32 = 1;
+#  endif
+}
+#else
+local void detect_features()
+{
+}
+#endif
+
+void ZLIB_INTERNAL cpu_check_features()
+{
+    if (cpu_checked)
+        return;
+    if (simd_enabled)
+        detect_features();
+    cpu_checked = 1;
+}
+
+void ZEXPORT zlib_enable_simd(enable)
+    int enable;
+{
+    simd_enabled = enable;
+    x86_cpu_enable_pclmul = 0;
+    x86_cpu_enable_ssse3 = 0;
+    x86_cpu_enable_avx2 = 0;
+    arm_cpu_enable_neon = 0;
+    arm_cpu_enable_crc32 = 0;
+    if (enable)
+        detect_features();
+    cpu_checked = 1;
+}
@@ -0,0 +1,55 @@
+/* cpu_features.h -- runtime detection of the SIMD extensions used by zlib
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include "zutil.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define ZLIB_SIMD_X86
+#elif defined(ZLIB_ARM_SIMD_EXPERIMENTAL) && \
+      (defined(__aarch64__) || defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+/* The NEON and CRC32 kernels have not been run on ARM hardware yet, so ARM
+   builds take the portable code unless they ask for the kernels explicitly */
+#  define ZLIB_SIMD_ARM
+#endif
+
+/* GCC and clang compile intrinsics only inside functions built for them,
+   MSVC takes them anywhere */
+#if defined(ZLIB_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define ZLIB_TARGET(features) __attribute__((target(features)))
+#else
+#  define ZLIB_TARGET(features)
+#endif
+
+/* Set by cpu_check_features() */
+extern int ZLIB_INTERNAL x86_cpu_enable_pclmul;  /* SSE4.1 + PCLMULQDQ */
+extern int ZLIB_INTERNAL x86_cpu_enable_ssse3;
+extern int ZLIB_INTERNAL x86_cpu_enable_avx2;
+extern int ZLIB_INTERNAL arm_cpu_enable_neon;
+extern int ZLIB_INTERNAL arm_cpu_enable_crc32;
+
+/* Cheap after the first call.  Concurrent first calls all store the same
+   values, so no lock is taken. */
+void ZLIB_INTERNAL cpu_check_features OF((void));
+
+/* Switches the vectorized kernels off (0) or back on (1), for benchmarks and
+   tests that compare them with the portable code */
+void ZEXPORT zlib_enable_simd OF((int enable));
+
+/* Vectorized kernels, called through crc32_z() and adler32_z() */
+#define Z_CRC32_SIMD_MINIMUM_LENGTH 64
+#define Z_CRC32_SIMD_CHUNK_MASK 15
+#define Z_ADLER32_SIMD_MINIMUM_LENGTH 64
+
+/* Takes and returns the CRC register (not inverted), len >= 64 and a multiple of 16 */
+uLong ZLIB_INTERNAL crc32_pclmul OF((uLong crc, const unsigned char FAR *buf, z_size_t len));
+uLong ZLIB_INTERNAL crc32_armv8 OF((uLong crc, const unsigned char FAR *buf, z_size_t len));
+
+uLong ZLIB_INTERNAL adler32_ssse3 OF((uLong adler, const unsigned char FAR *buf, z_size_t len));
+uLong ZLIB_INTERNAL adler32_avx2 OF((uLong adler, const unsigned char FAR *buf, z_size_t len));
+uLong ZLIB_INTERNAL adler32_neon OF((uLong adler, const unsigned char FAR *buf, z_size_t len));
+
+#endif /* CPU_FEATURES_H */
@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "cpu_features.h"
 
 /* Definitions for doing the crc four data bytes at a time. */
 #if !defined(NOBYFOUR) && defined(Z_U4)
@@ -211,6 +212,27 @@ unsigned long ZEXPORT crc32_z(crc, buf, len)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+#if defined(ZLIB_SIMD_X86)
+    /* whole 16 byte blocks by folding, the rest by the tables below */
+    if (len >= Z_CRC32_SIMD_MINIMUM_LENGTH) {
+        cpu_check_features();
+        if (x86_cpu_enable_pclmul) {
+            z_size_t chunk = len & ~(z_size_t)Z_CRC32_SIMD_CHUNK_MASK;
+            crc = crc32_pclmul((crc ^ 0xffffffffUL) & 0xffffffffUL, buf, chunk) ^ 0xffffffffUL;
+            buf += chunk;
+            len -= chunk;
+            if (len == 0)
+                return crc;
+        }
+    }
+#elif defined(ZLIB_SIMD_ARM) && defined(__ARM_FEATURE_CRC32)
+    if (len >= Z_CRC32_SIMD_MINIMUM_LENGTH) {
+        cpu_check_features();
+        if (arm_cpu_enable_crc32)
+            return crc32_armv8((crc ^ 0xffffffffUL) & 0xffffffffUL, buf, len) ^ 0xffffffffUL;
+    }
+#endif
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         z_crc_t endian;
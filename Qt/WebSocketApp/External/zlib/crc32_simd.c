@@ -0,0 +1,153 @@
+/* crc32_simd.c -- CRC-32 with carry-less multiplication (x86) or the ARMv8 CRC32 instructions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The x86 kernel folds 64 bytes per round into four 128-bit lanes with PCLMULQDQ, then reduces
+ * them to 32 bits with a Barrett reduction, following "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Intel, 2009) with the bit-reflected constants
+ * for the gzip polynomial 0x04c11db7.
+ */
+
+#include "cpu_features.h"
+
+#if defined(ZLIB_SIMD_X86)
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+#ifdef _MSC_VER
+#  define ZALIGN(x) __declspec(align(x))
+#else
+#  define ZALIGN(x) __attribute__((aligned(x)))
+#endif
+
+ZLIB_TARGET("sse4.1,pclmul")
+uLong ZLIB_INTERNAL crc32_pclmul(crc, buf, len)
+    uLong crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    /* x^(4*128+32), x^(4*128-32), x^(128+32), x^(128-32), x^64 mod P (reflected),
+       then P and mu for the Barrett reduction */
+    static const ZALIGN(16) unsigned long long k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const ZALIGN(16) unsigned long long k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const ZALIGN(16) unsigned long long k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const ZALIGN(16) unsigned long long poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* fold 64 bytes per round */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold the four lanes into one */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* fold the remaining 16 byte blocks */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uLong)(unsigned)_mm_extract_epi32(x1, 1);
+}
+
+#elif defined(ZLIB_SIMD_ARM) && defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+#include <string.h>
+
+uLong ZLIB_INTERNAL crc32_armv8(crc, buf, len)
+    uLong crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    unsigned int c = (unsigned int)crc;
+    unsigned long long word;
+
+    while (len >= 8) {
+        memcpy(&word, buf, 8);
+        c = __crc32d(c, word);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--)
+        c = __crc32b(c, *buf++);
+    return c;
+}
+
+#endif
@@ -51,6 +51,18 @@
 
 #include "deflate.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define DEFLATE_COMPARE_SSE2
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && !defined(__AARCH64EB__)
+#  define DEFLATE_COMPARE_64
+#endif
+#if defined(_MSC_VER) && \
+    (defined(DEFLATE_COMPARE_SSE2) || defined(DEFLATE_COMPARE_64))
+#  include <intrin.h>
+#endif
+
 const char deflate_copyright[] =
    " deflate 1.2.11 Copyright 1995-2017 Jean-loup Gailly and Mark Adler ";
 /*
@@ -163,24 +175,39 @@ local const config configuration_table[10] = {
 #define UPDATE_HASH(s,h,c) (h = (((h)<<s->hash_shift) ^ (c)) & s->hash_mask)
 
 
+/* ===========================================================================
+ * Hash of the four bytes at str.  A multiplicative hash of the whole word
+ * spreads text over the table far better than the running hash and does not
+ * depend on the previous position.  Unlike with the running hash, strings of
+ * the same hash may differ in their third byte, so longest_match() checks it.
+ * The byte after the last MIN_MATCH bytes of the input is read as well; it is
+ * either earlier data, zeroed by fill_window() or in the zeroed window padding.
+ */
+#define WINDOW_PADDING 8
+
+#define HASH_STRING(s, str) \
+    ((uInt)(((((ulg)s->window[(str)]) | ((ulg)s->window[(str) + 1] << 8) | \
+              ((ulg)s->window[(str) + 2] << 16) | \
+              ((ulg)s->window[(str) + 3] << 24)) * 2654435761UL \
+             & 0xffffffffUL) >> (32 - s->hash_bits)))
+
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
  * of the hash chain (the most recent string with same hash key). Return
  * the previous length of the hash chain.
  * If this file is compiled with -DFASTEST, the compression level is forced
  * to 1, and no hash chains are maintained.
- * IN  assertion: all calls to INSERT_STRING are made with consecutive input
- *    characters and the first MIN_MATCH bytes of str are valid (except for
+ * IN  assertion: the first MIN_MATCH bytes of str are valid (except for
  *    the last MIN_MATCH-1 bytes of the input file).
  */
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (s->ins_h = HASH_STRING(s, str), \
     match_head = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #else
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (s->ins_h = HASH_STRING(s, str), \
     match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #endif
@@ -318,7 +345,8 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     s->hash_mask = s->hash_size - 1;
     s->hash_shift =  ((s->hash_bits+MIN_MATCH-1)/MIN_MATCH);
 
-    s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
+    s->window = (Bytef *) ZALLOC(strm, s->w_size + WINDOW_PADDING,
+                                 2*sizeof(Byte));
     s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
     s->head   = (Posf *)  ZALLOC(strm, s->hash_size, sizeof(Pos));
 
@@ -337,6 +365,7 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
         deflateEnd (strm);
         return Z_MEM_ERROR;
     }
+    zmemzero(s->window + 2*s->w_size, 2*WINDOW_PADDING);
     s->d_buf = overlay + s->lit_bufsize/sizeof(ush);
     s->l_buf = s->pending_buf + (1+sizeof(ush))*s->lit_bufsize;
 
@@ -418,7 +447,7 @@ int ZEXPORT deflateSetDictionary (strm, dictionary, dictLength)
         str = s->strstart;
         n = s->lookahead - (MIN_MATCH-1);
         do {
-            UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+            s->ins_h = HASH_STRING(s, str);
 #ifndef FASTEST
             s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
@@ -1125,7 +1154,8 @@ int ZEXPORT deflateCopy (dest, source)
     zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
     ds->strm = dest;
 
-    ds->window = (Bytef *) ZALLOC(dest, ds->w_size, 2*sizeof(Byte));
+    ds->window = (Bytef *) ZALLOC(dest, ds->w_size + WINDOW_PADDING,
+                                  2*sizeof(Byte));
     ds->prev   = (Posf *)  ZALLOC(dest, ds->w_size, sizeof(Pos));
     ds->head   = (Posf *)  ZALLOC(dest, ds->hash_size, sizeof(Pos));
     overlay = (ushf *) ZALLOC(dest, ds->lit_bufsize, sizeof(ush)+2);
@@ -1137,7 +1167,8 @@ int ZEXPORT deflateCopy (dest, source)
         return Z_MEM_ERROR;
     }
     /* following zmemcpy do not work for 16-bit MSDOS */
-    zmemcpy(ds->window, ss->window, ds->w_size * 2 * sizeof(Byte));
+    zmemcpy(ds->window, ss->window,
+            (ds->w_size + WINDOW_PADDING) * 2 * sizeof(Byte));
     zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Pos));
     zmemcpy((voidpf)ds->head, (voidpf)ss->head, ds->hash_size * sizeof(Pos));
     zmemcpy(ds->pending_buf, ss->pending_buf, (uInt)ds->pending_buf_size);
@@ -1230,6 +1261,55 @@ local void lm_init (s)
  * OUT assertion: the match length is not greater than s->lookahead.
  */
 #ifndef ASMV
+#if defined(DEFLATE_COMPARE_SSE2) || defined(DEFLATE_COMPARE_64)
+/* ---------------------------------------------------------------------------
+ * Returns the number of equal leading bytes of scan and match, at most
+ * MAX_MATCH-2 (which is a multiple of 16).  Reads at most MAX_MATCH-2 bytes
+ * of each.
+ */
+local unsigned compare_match OF((const Bytef *scan, const Bytef *match));
+
+local unsigned compare_match(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    unsigned len = 0;
+    do {
+#ifdef DEFLATE_COMPARE_SSE2
+        __m128i a = _mm_loadu_si128((const __m128i *)(scan + len));
+        __m128i b = _mm_loadu_si128((const __m128i *)(match + len));
+        unsigned diff = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff;
+        if (diff != 0) {
+#  if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, diff);
+            return len + (unsigned)index;
+#  else
+            return len + (unsigned)__builtin_ctz(diff);
+#  endif
+        }
+        len += 16;
+#else
+        unsigned long long a, b, diff;
+        zmemcpy(&a, scan + len, sizeof(a));
+        zmemcpy(&b, match + len, sizeof(b));
+        diff = a ^ b;
+        if (diff != 0) {
+#  if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward64(&index, diff);
+            return len + (unsigned)(index >> 3);
+#  else
+            return len + (unsigned)(__builtin_ctzll(diff) >> 3);
+#  endif
+        }
+        len += 8;
+#endif
+    } while (len < MAX_MATCH-2);
+    return MAX_MATCH-2;
+}
+#endif
+
 /* For 80x86 and 680x0, an optimized version will be provided in match.asm or
  * match.S. The code will be functionally equivalent.
  */
@@ -1259,7 +1339,9 @@ local uInt longest_match(s, cur_match)
     register ush scan_start = *(ushf*)scan;
     register ush scan_end   = *(ushf*)(scan+best_len-1);
 #else
+#if !defined(DEFLATE_COMPARE_SSE2) && !defined(DEFLATE_COMPARE_64)
     register Bytef *strend = s->window + s->strstart + MAX_MATCH;
+#endif
     register Byte scan_end1  = scan[best_len-1];
     register Byte scan_end   = scan[best_len];
 #endif
@@ -1297,11 +1379,9 @@ local uInt longest_match(s, cur_match)
          * UNALIGNED_OK if your compiler uses a different size.
          */
         if (*(ushf*)(match+best_len-1) != scan_end ||
-            *(ushf*)match != scan_start) continue;
+            *(ushf*)match != scan_start || match[2] != scan[2]) continue;
 
-        /* It is not necessary to compare scan[2] and match[2] since they are
-         * always equal when the other bytes match, given that the hash keys
-         * are equal and that HASH_BITS >= 8. Compare 2 bytes at a time at
+        /* Compare 2 bytes at a time at
          * strstart+3, +5, ... up to strstart+257. We check for insufficient
          * lookahead only every 4th comparison; the 128th check will be made
          * at strstart+257. If MAX_MATCH-2 is not a multiple of 8, it is
@@ -1334,12 +1414,16 @@ local uInt longest_match(s, cur_match)
 
         /* The check at best_len-1 can be removed because it will be made
          * again later. (This heuristic is not always a win.)
-         * It is not necessary to compare scan[2] and match[2] since they
-         * are always equal when the other bytes match, given that
-         * the hash keys are equal and that HASH_BITS >= 8.
+         * scan[2] and match[2] may differ, see HASH_STRING().
          */
+#if defined(DEFLATE_COMPARE_SSE2) || defined(DEFLATE_COMPARE_64)
+        len = (int)compare_match(scan + 2, match + 1) + 2;
+#else
         scan += 2, match++;
-        Assert(*scan == *match, "match[2]?");
+        if (*scan != *match) {
+            scan = strend - MAX_MATCH;
+            continue;
+        }
 
         /* We check for insufficient lookahead only every 8th comparison;
          * the 256th check will be made at strstart+258.
@@ -1355,6 +1439,7 @@ local uInt longest_match(s, cur_match)
 
         len = MAX_MATCH - (int)(strend - scan);
         scan = strend - MAX_MATCH;
+#endif
 
 #endif /* UNALIGNED_OK */
 
@@ -1406,14 +1491,10 @@ local uInt longest_match(s, cur_match)
      */
     if (match[0] != scan[0] || match[1] != scan[1]) return MIN_MATCH-1;
 
-    /* The check at best_len-1 can be removed because it will be made
-     * again later. (This heuristic is not always a win.)
-     * It is not necessary to compare scan[2] and match[2] since they
-     * are always equal when the other bytes match, given that
-     * the hash keys are equal and that HASH_BITS >= 8.
+    /* scan[2] and match[2] may differ, see HASH_STRING().
      */
     scan += 2, match += 2;
-    Assert(*scan == *match, "match[2]?");
+    if (*scan != *match) return MIN_MATCH-1;
 
     /* We check for insufficient lookahead only every 8th comparison;
      * the 256th check will be made at strstart+258.
@@ -1543,7 +1624,7 @@ local void fill_window(s)
             Call UPDATE_HASH() MIN_MATCH-3 more times
 #endif
             while (s->insert) {
-                UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+                s->ins_h = HASH_STRING(s, str);
 #ifndef FASTEST
                 s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
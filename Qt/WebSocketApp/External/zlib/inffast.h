@@ -8,4 +8,19 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* Input and output inflate() must have available before it calls
+   inflate_fast().  On 64-bit little-endian targets the bit buffer is refilled
+   eight bytes at a time and matches are copied in eight byte chunks, which
+   reads up to seven bytes past the last code and writes up to seven bytes
+   past the last match. */
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || \
+     defined(_M_ARM64)) && !defined(__AARCH64EB__)
+#  define INFLATE_FAST_WIDE
+#  define INFLATE_FAST_MIN_INPUT 8
+#  define INFLATE_FAST_MIN_OUTPUT (258 + 8)
+#else
+#  define INFLATE_FAST_MIN_INPUT 6
+#  define INFLATE_FAST_MIN_OUTPUT 258
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
@@ -1,5 +1,6 @@
 ﻿#include "MainWindow.h"
 #include "ConnectionDialog.h"
+#include "SocketUtf8.h"
 #include "ui_MainWindow.h"
 
 #include <QHostInfo>
@@ -67,7 +68,8 @@ void MainWindow::ReceiveLog(const std::string& log) {
         return;
     }
 
-    const QString& qstr = log.c_str();
+    QString qstr;
+    WebSocketApp::FromUtf8(log.data(), static_cast<int>(log.size()), qstr);
 
     bool end = ui->log->textCursor().atEnd();
     if (qstr.at(qstr.length() - 1) != '\n') {
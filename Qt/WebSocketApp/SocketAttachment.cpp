@@ -0,0 +1,144 @@
+﻿#include "SocketAttachment.h"
+#include "SocketBase64.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <fstream>
+
+namespace WebSocketApp {
+
+// Base64 is decoded in blocks of whole 4 character groups
+static const int BASE64_DECODE_BLOCK_SIZE = 64 * 1024;
+
+void SocketAttachment::SetEncoded(const QByteArray& buffer, int offset, int length, Encoding encoding) {
+    _buffer = buffer;
+    _offset = offset;
+    _length = length;
+    _encoding = encoding;
+    _bytes.clear();
+    _decoded = false;
+    _path.clear();
+    _identity.clear();
+    _fileSize = 0;
+}
+
+void SocketAttachment::SetBytes(const QByteArray& bytes) {
+    _buffer.clear();
+    _offset = 0;
+    _length = 0;
+    _bytes = bytes;
+    _decoded = true;
+    _path.clear();
+    _identity.clear();
+    _fileSize = 0;
+}
+
+bool SocketAttachment::SetFile(const std::string& path) {
+    QFileInfo info(QString::fromStdString(path));
+    if (!info.isFile()) {
+        OUTPUT_ERROR_LOG("ファイルの読み込み失敗：%s", path.c_str());
+        return false;
+    }
+
+    Clear();
+    _path = path;
+    _fileSize = info.size();
+    _identity = FORMAT_STR("%s\n%lld\n%lld", path.c_str(), (long long)info.size(), (long long)info.lastModified().toMSecsSinceEpoch());
+    _encoding = Encoding::Raw;
+    _decoded = false;
+    return true;
+}
+
+void SocketAttachment::Clear() {
+    SetBytes(QByteArray());
+}
+
+bool SocketAttachment::Decode() const {
+    if (_decoded) {
+        return true;
+    }
+
+    if (!_path.empty()) {
+        if (!WebSocketApp::ReadFile(_path, _bytes)) {
+            _bytes.clear();
+            return false;
+        }
+    } else if (_encoding == Encoding::Raw) {
+        // Nothing to decode: keep the buffer and expose the slice of it
+        if (_offset == 0 && _length == _buffer.length()) {
+            _bytes = _buffer;
+        } else {
+            _bytes = QByteArray::fromRawData(EncodedData(), _length);
+        }
+    } else {
+        DecodeTo(_bytes);
+        _buffer.clear();
+    }
+    _decoded = true;
+    return true;
+}
+
+const QByteArray& SocketAttachment::Bytes() const {
+    Decode();
+    return _bytes;
+}
+
+int64_t SocketAttachment::Size() const {
+    if (_decoded) {
+        return _bytes.length();
+    } else if (!_path.empty()) {
+        return _fileSize;
+    } else if (_encoding == Encoding::Raw) {
+        return _length;
+    }
+    return WebSocketApp::Base64DecodedSize(_length);
+}
+
+bool SocketAttachment::DecodeTo(QByteArray& dest) const {
+    if (_decoded) {
+        dest = _bytes;
+        return true;
+    }
+
+    if (!_path.empty()) {
+        return WebSocketApp::ReadFile(_path, dest);
+    } else if (_encoding == Encoding::Raw) {
+        dest = QByteArray(EncodedData(), _length);
+    } else {
+        WebSocketApp::FromBase64(EncodedData(), _length, dest);
+    }
+    return true;
+}
+
+bool SocketAttachment::DecodeTo(const std::string& path) const {
+    std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    {
+        if (!file) {
+            OUTPUT_ERROR_LOG("ファイルの書き込み失敗：%s", path.c_str());
+            return false;
+        }
+
+        if (_decoded || _encoding == Encoding::Raw || !_path.empty()) {
+            const QByteArray& bytes = Bytes();
+            if (!bytes.isEmpty() && !file.write(bytes.constData(), bytes.length())) {
+                return false;
+            }
+        } else {
+            // Only one block is ever decoded at a time
+            const char* encoded = EncodedData();
+            QByteArray block;
+            for (int offset = 0; offset < _length; offset += BASE64_DECODE_BLOCK_SIZE) {
+                int blockLength = qMin(BASE64_DECODE_BLOCK_SIZE, _length - offset);
+                WebSocketApp::FromBase64(encoded + offset, blockLength, block);
+                if (!file.write(block.constData(), block.length())) {
+                    return false;
+                }
+            }
+        }
+    }
+    file.close();
+
+    return true;
+}
+
+} // namespace WebSocketApp
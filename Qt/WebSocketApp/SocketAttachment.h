@@ -0,0 +1,75 @@
+﻿#ifndef SOCKETATTACHMENT_H
+#define SOCKETATTACHMENT_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+
+namespace WebSocketApp {
+
+// Raw bytes carried next to a message payload, decoded lazily.
+//   A received attachment only refers to its part of the receive buffer (shared, not copied)
+//   and is decoded on first access, after which the encoded form is released.
+//   An attachment to send can refer to a file instead, which is read on first access.
+class SocketAttachment {
+public:
+    enum class Encoding : int {
+        Raw,
+        Base64,
+    }; // enum Encoding
+
+    SocketAttachment()
+        : _offset(0)
+        , _length(0)
+        , _encoding(Encoding::Raw)
+        , _decoded(true)
+        , _fileSize(0)
+    {
+    }
+
+    bool IsDecoded() const {
+        return _decoded;
+    }
+
+    // Refers to length bytes at offset of buffer
+    void SetEncoded(const QByteArray& buffer, int offset, int length, Encoding encoding);
+    void SetBytes(const QByteArray& bytes);
+    // Fails if the file does not exist
+    bool SetFile(const std::string& path);
+    void Clear();
+
+    // Path, size and modification time of the file set by SetFile(), otherwise empty
+    const std::string& Identity() const {
+        return _identity;
+    }
+
+    // Decodes (or reads the file) on first access, fails if the file cannot be read
+    //   A failure is not kept, the next access tries again.
+    bool Decode() const;
+    // Decodes on first access, empty if Decode() fails
+    const QByteArray& Bytes() const;
+    // Size of Bytes() without decoding or reading the file (an upper bound for base64)
+    int64_t Size() const;
+
+    // Decodes into the caller's buffer or a file, without keeping a decoded copy here
+    bool DecodeTo(QByteArray& dest) const;
+    bool DecodeTo(const std::string& path) const;
+
+private:
+    mutable QByteArray _buffer;
+    mutable QByteArray _bytes;
+    int _offset;
+    int _length;
+    Encoding _encoding;
+    mutable bool _decoded;
+    std::string _path;
+    std::string _identity;
+    int64_t _fileSize;
+
+    const char* EncodedData() const {
+        return _buffer.constData() + _offset;
+    }
+}; // class SocketAttachment
+
+} // namespace WebSocketApp
+
+#endif // SOCKETATTACHMENT_H
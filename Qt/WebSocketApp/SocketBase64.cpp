@@ -0,0 +1,332 @@
+﻿#include "SocketBase64.h"
+#include "SocketSimd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+namespace {
+
+const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+class Base64DecodeTable {
+public:
+    static const int8_t* Values() {
+        static const Base64DecodeTable table;
+        return table._values;
+    }
+
+private:
+    int8_t _values[256];
+
+    Base64DecodeTable() {
+        std::fill(std::begin(_values), std::end(_values), (int8_t)-1);
+        for (int i = 0; i < 64; ++i) {
+            _values[(uchar)BASE64_ALPHABET[i]] = (int8_t)i;
+        }
+    }
+}; // class Base64DecodeTable
+
+void EncodeScalar(const uchar* in, int length, char* out) {
+    const uchar* groupEnd = in + length / 3 * 3;
+    for (; in < groupEnd; in += 3, out += 4) {
+        uint32_t bits = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | (uint32_t)in[2];
+        out[0] = BASE64_ALPHABET[bits >> 18];
+        out[1] = BASE64_ALPHABET[(bits >> 12) & 63];
+        out[2] = BASE64_ALPHABET[(bits >> 6) & 63];
+        out[3] = BASE64_ALPHABET[bits & 63];
+    }
+
+    int rest = length % 3;
+    if (rest > 0) {
+        uint32_t bits = ((uint32_t)in[0] << 16) | ((rest == 2) ? ((uint32_t)in[1] << 8) : 0);
+        out[0] = BASE64_ALPHABET[bits >> 18];
+        out[1] = BASE64_ALPHABET[(bits >> 12) & 63];
+        out[2] = (rest == 2) ? BASE64_ALPHABET[(bits >> 6) & 63] : '=';
+        out[3] = '=';
+    }
+}
+
+// length has no padding
+int DecodeScalar(const uchar* in, int length, uchar* out) {
+    const int8_t* values = Base64DecodeTable::Values();
+    const uchar* start = out;
+    const uchar* groupEnd = in + (length & ~3);
+    for (; in < groupEnd; in += 4, out += 3) {
+        int a = values[in[0]], b = values[in[1]], c = values[in[2]], d = values[in[3]];
+        if ((a | b | c | d) < 0) {
+            return -1;
+        }
+        uint32_t bits = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        out[0] = (uchar)(bits >> 16);
+        out[1] = (uchar)(bits >> 8);
+        out[2] = (uchar)bits;
+    }
+
+    // 2 or 3 characters left for 1 or 2 bytes
+    int rest = length & 3;
+    if (rest > 0) {
+        int a = values[in[0]], b = values[in[1]], c = (rest == 3) ? values[in[2]] : 0;
+        if ((a | b | c) < 0) {
+            return -1;
+        }
+        uint32_t bits = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+        *out++ = (uchar)(bits >> 16);
+        if (rest == 3) {
+            *out++ = (uchar)(bits >> 8);
+        }
+    }
+    return (int)(out - start);
+}
+
+//---------------------------------
+
+std::atomic<bool> simdEnabled(true);
+
+WebSocketApp::SimdLevel Simd() {
+    return simdEnabled.load(std::memory_order_relaxed) ? WebSocketApp::CpuSimdLevel() : WebSocketApp::SimdLevel::Scalar;
+}
+
+#ifdef SOCKET_SIMD_X86
+
+// Encoding (W. Mula, "Base64 encoding with SIMD instructions")
+//   The 3 bytes of each 32 bit lane are spread over 4 bytes of 6 bits, which are then mapped to the
+//   alphabet by adding the offset of their range, looked up with pshufb.
+
+SOCKET_SIMD_TARGET("ssse3")
+inline __m128i EncodeSplit(__m128i bytes) {
+    __m128i in = _mm_shuffle_epi8(bytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(ac, bd);
+}
+
+SOCKET_SIMD_TARGET("ssse3")
+inline __m128i EncodeLookup(__m128i sextets) {
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i range = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), sextets), _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), sextets);
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline __m256i EncodeSplit(__m256i bytes) {
+    __m256i in = _mm256_shuffle_epi8(bytes, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(ac, bd);
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline __m256i EncodeLookup(__m256i sextets) {
+    __m256i range = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+    range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets), _mm256_set1_epi8(13)));
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), sextets);
+}
+
+// Return the number of bytes encoded, a multiple of 3; each load reads 4 bytes more than it encodes
+SOCKET_SIMD_TARGET("ssse3")
+int EncodeSsse3(const uchar* in, int length, char* out) {
+    int done = 0;
+    for (; length - done >= 16; done += 12, out += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(in + done));
+        _mm_storeu_si128((__m128i*)out, EncodeLookup(EncodeSplit(bytes)));
+    }
+    return done;
+}
+
+SOCKET_SIMD_TARGET("avx2")
+int EncodeAvx2(const uchar* in, int length, char* out) {
+    int done = 0;
+    for (; length - done >= 28; done += 24, out += 32) {
+        __m128i low = _mm_loadu_si128((const __m128i*)(in + done));
+        __m128i high = _mm_loadu_si128((const __m128i*)(in + done + 12));
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256((__m256i*)out, EncodeLookup(EncodeSplit(bytes)));
+    }
+    return done + EncodeSsse3(in + done, length - done, out);
+}
+
+// Decoding (W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions")
+//   The high and low nibble of each character index two tables whose bits only meet for characters
+//   outside the alphabet. The high nibble (and '/') then picks the offset back to the 6 bit value,
+//   and multiply-adds pack 4 values of 6 bits into 3 bytes.
+
+SOCKET_SIMD_TARGET("ssse3")
+inline bool DecodeSextets(__m128i& chars) {
+    const __m128i lowTable = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i highTable = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i slash = _mm_set1_epi8(0x2F);
+
+    __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), slash);
+    __m128i lowNibbles = _mm_and_si128(chars, slash);
+    __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lowTable, lowNibbles), _mm_shuffle_epi8(highTable, highNibbles));
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())) != 0) {
+        return false;
+    }
+    __m128i offset = _mm_shuffle_epi8(offsets, _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), highNibbles));
+    chars = _mm_add_epi8(chars, offset);
+    return true;
+}
+
+SOCKET_SIMD_TARGET("ssse3")
+inline __m128i DecodePack(__m128i sextets) {
+    __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+    __m128i triples = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(triples, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline bool DecodeSextets(__m256i& chars) {
+    const __m256i lowTable = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i highTable = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i offsets = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i slash = _mm256_set1_epi8(0x2F);
+
+    __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), slash);
+    __m256i lowNibbles = _mm256_and_si256(chars, slash);
+    __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lowTable, lowNibbles), _mm256_shuffle_epi8(highTable, highNibbles));
+    if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(invalid, _mm256_setzero_si256())) != 0) {
+        return false;
+    }
+    __m256i offset = _mm256_shuffle_epi8(offsets, _mm256_add_epi8(_mm256_cmpeq_epi8(chars, slash), highNibbles));
+    chars = _mm256_add_epi8(chars, offset);
+    return true;
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline __m256i DecodePack(__m256i sextets) {
+    __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+    __m256i triples = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    __m256i packed = _mm256_shuffle_epi8(triples, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    // 12 bytes at the bottom of each lane
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+}
+
+// Return the number of characters decoded, a multiple of 4, stopping before the first block with anything
+// outside the alphabet. Each store writes 4 (SSSE3) or 8 (AVX2) bytes more than it decodes, which the
+// remaining characters always leave room for.
+SOCKET_SIMD_TARGET("ssse3")
+int DecodeSsse3(const uchar* in, int length, uchar* out) {
+    int done = 0;
+    for (; length - done >= 24; done += 16, out += 12) {
+        __m128i chars = _mm_loadu_si128((const __m128i*)(in + done));
+        if (!DecodeSextets(chars)) {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)out, DecodePack(chars));
+    }
+    return done;
+}
+
+SOCKET_SIMD_TARGET("avx2")
+int DecodeAvx2(const uchar* in, int length, uchar* out) {
+    int done = 0;
+    for (; length - done >= 44; done += 32, out += 24) {
+        __m256i chars = _mm256_loadu_si256((const __m256i*)(in + done));
+        if (!DecodeSextets(chars)) {
+            return done;
+        }
+        _mm256_storeu_si256((__m256i*)out, DecodePack(chars));
+    }
+    return done + DecodeSsse3(in + done, length - done, out);
+}
+
+#endif // SOCKET_SIMD_X86
+
+} // namespace
+
+//---------------------------------
+
+namespace WebSocketApp {
+
+int EncodeBase64(const char* src, int length, char* dest) {
+    const uchar* in = (const uchar*)src;
+    int done = 0;
+#ifdef SOCKET_SIMD_X86
+    switch (Simd()) {
+    case SimdLevel::Avx2:
+        done = EncodeAvx2(in, length, dest);
+        break;
+    case SimdLevel::Ssse3:
+        done = EncodeSsse3(in, length, dest);
+        break;
+    default:
+        break;
+    }
+#endif
+    EncodeScalar(in + done, length - done, dest + done / 3 * 4);
+    return Base64EncodedSize(length);
+}
+
+int DecodeBase64(const char* src, int length, char* dest) {
+    // Padding can only end the text
+    if (length >= 4 && (length & 3) == 0) {
+        length -= (src[length - 1] == '=') + (src[length - 1] == '=' && src[length - 2] == '=');
+    }
+    if ((length & 3) == 1) {
+        return -1;
+    }
+
+    const uchar* in = (const uchar*)src;
+    uchar* out = (uchar*)dest;
+    int done = 0;
+#ifdef SOCKET_SIMD_X86
+    switch (Simd()) {
+    case SimdLevel::Avx2:
+        done = DecodeAvx2(in, length, out);
+        break;
+    case SimdLevel::Ssse3:
+        done = DecodeSsse3(in, length, out);
+        break;
+    default:
+        break;
+    }
+#endif
+    int rest = DecodeScalar(in + done, length - done, out + done / 4 * 3);
+    return (rest < 0) ? -1 : done / 4 * 3 + rest;
+}
+
+void AppendBase64(QByteArray& dest, const char* src, int length) {
+    int offset = dest.length();
+    dest.resize(offset + Base64EncodedSize(length));
+    EncodeBase64(src, length, dest.data() + offset);
+}
+
+void FromBase64(const char* src, int length, QByteArray& dest) {
+    dest.resize(Base64DecodedSize(length));
+    int decodedLength = DecodeBase64(src, length, dest.data());
+    if (decodedLength < 0) {
+        dest = QByteArray::fromBase64(QByteArray::fromRawData(src, length));
+        return;
+    }
+    dest.resize(decodedLength);
+}
+
+void SetBase64SimdEnabled(bool enable) {
+    simdEnabled.store(enable, std::memory_order_relaxed);
+}
+
+const char* Base64SimdName() {
+    return SimdLevelName(Simd());
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,36 @@
+﻿#ifndef SOCKETBASE64_H
+#define SOCKETBASE64_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+
+namespace WebSocketApp {
+
+// Base64 in the standard alphabet with padding, as QByteArray::toBase64() writes it, into caller-supplied buffers
+//   24 bytes are done at a time with AVX2 and 12 with SSSE3 when the CPU has them, the rest with tables.
+
+inline int Base64EncodedSize(int length) {
+    return (length + 2) / 3 * 4;
+}
+// Enough for src of length characters; padding makes the result smaller
+inline int Base64DecodedSize(int length) {
+    return length / 4 * 3 + (length % 4) * 3 / 4;
+}
+
+// Writes Base64EncodedSize(length) characters to dest and returns their count
+extern int EncodeBase64(const char* src, int length, char* dest);
+// Padding is optional. Returns the decoded size, or -1 when src holds anything else (line breaks included).
+extern int DecodeBase64(const char* src, int length, char* dest);
+
+extern void AppendBase64(QByteArray& dest, const char* src, int length);
+// Replaces dest with the bytes of src, which may be anything QByteArray::fromBase64() takes
+extern void FromBase64(const char* src, int length, QByteArray& dest);
+
+// Vector code on (the default) or off, for benchmarks
+extern void SetBase64SimdEnabled(bool enable);
+// "avx2", "ssse3" or "scalar"
+extern const char* Base64SimdName();
+
+} // namespace WebSocketApp
+
+#endif // SOCKETBASE64_H
@@ -0,0 +1,233 @@
+﻿#include "SocketCbor.h"
+
+namespace WebSocketApp {
+
+void CborWriter::Write(int key, bool value) {
+    _stream.append(key);
+    _stream.append(value);
+}
+
+void CborWriter::Write(int key, int value) {
+    _stream.append(key);
+    _stream.append(value);
+}
+
+void CborWriter::Write(int key, int64_t value) {
+    _stream.append(key);
+    _stream.append(static_cast<qint64>(value));
+}
+
+void CborWriter::Write(int key, float value) {
+    _stream.append(key);
+    _stream.append(value);
+}
+
+void CborWriter::Write(int key, double value) {
+    _stream.append(key);
+    _stream.append(value);
+}
+
+void CborWriter::Write(int key, const std::string& value) {
+    _stream.append(key);
+    // std::string already holds UTF-8, so no QString round trip
+    _stream.appendTextString(value.c_str(), static_cast<qsizetype>(value.size()));
+}
+
+void CborWriter::Write(int key, const std::vector<std::string>& value) {
+    _stream.append(key);
+    _stream.startArray(static_cast<quint64>(value.size()));
+    for (const auto& item : value) {
+        _stream.appendTextString(item.c_str(), static_cast<qsizetype>(item.size()));
+    }
+    _stream.endArray();
+}
+
+void CborWriter::WriteBytes(int key, const QByteArray& value) {
+    _stream.append(key);
+    _stream.appendByteString(value.constData(), value.length());
+}
+
+//---------------------------------
+
+bool CborReader::Fail() {
+    _error = true;
+    return false;
+}
+
+bool CborReader::Advance() {
+    if (!_stream.next()) {
+        return Fail();
+    }
+    return true;
+}
+
+bool CborReader::BeginMap() {
+    if (!_stream.isMap() || !_stream.enterContainer()) {
+        return Fail();
+    }
+    return true;
+}
+
+bool CborReader::NextKey(int& key) {
+    if (_error) {
+        return false;
+    }
+    if (!_stream.hasNext()) {
+        if (!_stream.leaveContainer()) {
+            return Fail();
+        }
+        return false;
+    }
+
+    if (!_stream.isInteger()) {
+        return Fail();
+    }
+    key = static_cast<int>(_stream.toInteger());
+    return Advance();
+}
+
+bool CborReader::Read(bool& value) {
+    if (!_stream.isBool()) {
+        return Fail();
+    }
+    value = _stream.toBool();
+    return Advance();
+}
+
+bool CborReader::Read(int& value) {
+    int64_t longValue = 0;
+    if (!Read(longValue)) {
+        return false;
+    }
+    value = static_cast<int>(longValue);
+    return true;
+}
+
+bool CborReader::Read(int64_t& value) {
+    if (_stream.isInteger()) {
+        value = _stream.toInteger();
+    } else if (_stream.isDouble()) {
+        value = static_cast<int64_t>(_stream.toDouble());
+    } else if (_stream.isFloat()) {
+        value = static_cast<int64_t>(_stream.toFloat());
+    } else {
+        return Fail();
+    }
+    return Advance();
+}
+
+bool CborReader::Read(float& value) {
+    double doubleValue = 0;
+    if (!Read(doubleValue)) {
+        return false;
+    }
+    value = static_cast<float>(doubleValue);
+    return true;
+}
+
+bool CborReader::Read(double& value) {
+    if (_stream.isDouble()) {
+        value = _stream.toDouble();
+    } else if (_stream.isFloat()) {
+        value = _stream.toFloat();
+    } else if (_stream.isFloat16()) {
+        value = _stream.toFloat16();
+    } else if (_stream.isInteger()) {
+        value = static_cast<double>(_stream.toInteger());
+    } else {
+        return Fail();
+    }
+    return Advance();
+}
+
+bool CborReader::Read(std::string& value) {
+    value.clear();
+    if (_stream.isNull()) {
+        return Advance();
+    }
+    if (!_stream.isString()) {
+        return Fail();
+    }
+
+    // Copy the UTF-8 chunks straight into the string
+    while (true) {
+        qsizetype chunkSize = qMax<qsizetype>(0, _stream.currentStringChunkSize());
+        size_t offset = value.size();
+        value.resize(offset + chunkSize);
+
+        auto result = _stream.readStringChunk(&value[0] + offset, chunkSize);
+        if (result.status == QCborStreamReader::Error) {
+            return Fail();
+        }
+        value.resize(offset + (result.status == QCborStreamReader::Ok ? result.data : 0));
+        if (result.status == QCborStreamReader::EndOfString) {
+            return true;
+        }
+    }
+}
+
+bool CborReader::Read(std::vector<std::string>& value) {
+    value.clear();
+    if (_stream.isArray() && _stream.isLengthKnown()) {
+        value.reserve(static_cast<size_t>(qMin<quint64>(_stream.length(), 0x10000)));
+    }
+
+    bool isNull = false;
+    if (!BeginArray(isNull)) {
+        return false;
+    }
+    if (isNull) {
+        return true;
+    }
+    while (NextElement()) {
+        value.emplace_back();
+        if (!Read(value.back())) {
+            return false;
+        }
+    }
+    return !_error;
+}
+
+bool CborReader::BeginArray(bool& isNull) {
+    isNull = _stream.isNull();
+    if (isNull) {
+        return Advance();
+    }
+    if (!_stream.isArray() || !_stream.enterContainer()) {
+        return Fail();
+    }
+    return true;
+}
+
+bool CborReader::NextElement() {
+    if (_error) {
+        return false;
+    }
+    if (!_stream.hasNext()) {
+        if (!_stream.leaveContainer()) {
+            Fail();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool CborReader::ReadBytes(QByteArray& value) {
+    if (!_stream.isByteArray()) {
+        return Fail();
+    }
+
+    auto result = _stream.readByteArray();
+    if (result.status == QCborStreamReader::Error) {
+        return Fail();
+    }
+    value = result.data;
+    return true;
+}
+
+bool CborReader::SkipValue() {
+    // next() skips a whole container including its contents
+    return Advance();
+}
+
+} // namespace WebSocketApp
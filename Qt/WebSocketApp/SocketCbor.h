@@ -0,0 +1,114 @@
+﻿#ifndef SOCKETCBOR_H
+#define SOCKETCBOR_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <type_traits>
+#include <vector>
+
+namespace WebSocketApp {
+
+// Appends a CBOR map keyed by small integers directly to an output buffer
+class CborWriter {
+public:
+    explicit CborWriter(QByteArray& buffer)
+        : _stream(&buffer)
+    {
+    }
+
+    // The map has an indefinite length, so the field count is not needed up front
+    void BeginMap() {
+        _stream.startMap();
+    }
+    void EndMap() {
+        _stream.endMap();
+    }
+
+    void Write(int key, bool value);
+    void Write(int key, int value);
+    void Write(int key, int64_t value);
+    void Write(int key, float value);
+    void Write(int key, double value);
+    void Write(int key, const std::string& value);
+    void Write(int key, const std::vector<std::string>& value);
+    void WriteBytes(int key, const QByteArray& value);
+
+    // Writes an array of strings one element at a time: BeginArray(), WriteElement()..., EndArray()
+    void BeginArray(int key) {
+        _stream.append(key);
+        _stream.startArray();
+    }
+    void WriteElement(const char* str, int length) {
+        _stream.appendTextString(str, length);
+    }
+    void EndArray() {
+        _stream.endArray();
+    }
+
+    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    void Write(int key, T value) {
+        Write(key, static_cast<int>(value));
+    }
+
+private:
+    QCborStreamWriter _stream;
+}; // class CborWriter
+
+//---------------------------------
+
+// Reads a CBOR map keyed by small integers in a single pass
+class CborReader {
+public:
+    CborReader(const char* data, int length)
+        : _stream(data, length)
+        , _error(false)
+    {
+    }
+
+    bool HasError() const {
+        return _error;
+    }
+
+    bool BeginMap();
+    // Returns false at the end of the map (or on error)
+    bool NextKey(int& key);
+
+    bool Read(bool& value);
+    bool Read(int& value);
+    bool Read(int64_t& value);
+    bool Read(float& value);
+    bool Read(double& value);
+    bool Read(std::string& value);
+    bool Read(std::vector<std::string>& value);
+    bool ReadBytes(QByteArray& value);
+
+    // Reads an array one element at a time: BeginArray(), then NextElement() before each element
+    //   until it returns false. A null array reads as an empty one.
+    bool BeginArray(bool& isNull);
+    bool NextElement();
+
+    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    bool Read(T& value) {
+        int intValue = 0;
+        if (!Read(intValue)) {
+            return false;
+        }
+        value = static_cast<T>(intValue);
+        return true;
+    }
+
+    bool SkipValue();
+
+private:
+    QCborStreamReader _stream;
+    bool _error;
+
+    bool Fail();
+    bool Advance();
+}; // class CborReader
+
+} // namespace WebSocketApp
+
+#endif // SOCKETCBOR_H
@@ -0,0 +1,101 @@
+﻿#include "SocketClock.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace WebSocketApp {
+
+// Drift is only fitted over this span, shorter spans are dominated by jitter
+static const int64_t CLOCK_DRIFT_MIN_SPAN = 10 * 1000 * 1000;
+
+int64_t MonotonicTime() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t MonotonicToWallTime(int64_t monotonicTime) {
+    int64_t wallNow = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return wallNow - (MonotonicTime() - monotonicTime) / 1000;
+}
+
+//---------------------------------
+
+void SocketClockEstimator::Clear() {
+    _samples.clear();
+    _next = 0;
+    _reference = 0;
+    _offset = 0;
+    _drift = 0;
+    _roundTripDelay = 0;
+}
+
+void SocketClockEstimator::AddSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3) {
+    Sample sample;
+    sample.localTime = t0 + (t3 - t0) / 2;
+    sample.offset = ((t1 - t0) + (t2 - t3)) / 2;
+    sample.delay = qMax<int64_t>((t3 - t0) - (t2 - t1), 0);
+
+    if ((int)_samples.size() < SAMPLE_COUNT) {
+        _samples.push_back(sample);
+    } else {
+        _samples[_next] = sample;
+        _next = (_next + 1) % SAMPLE_COUNT;
+    }
+    Update();
+}
+
+void SocketClockEstimator::Update() {
+    // The fastest quarter of the samples
+    std::vector<Sample> samples = _samples;
+    std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) {
+        return a.delay < b.delay;
+    });
+    samples.resize((samples.size() + 3) / 4);
+    _roundTripDelay = samples.front().delay;
+
+    // The origin has to be fixed before anything is summed relative to it
+    int64_t minTime = samples.front().localTime;
+    int64_t maxTime = minTime;
+    for (const auto& sample : samples) {
+        minTime = qMin(minTime, sample.localTime);
+        maxTime = qMax(maxTime, sample.localTime);
+    }
+
+    double meanTime = 0;
+    double meanOffset = 0;
+    for (const auto& sample : samples) {
+        meanTime += sample.localTime - minTime;
+        meanOffset += sample.offset - samples.front().offset;
+    }
+    meanTime /= samples.size();
+    meanOffset /= samples.size();
+
+    // Least squares fit of offset over local time
+    _drift = 0;
+    if (samples.size() >= 4 && maxTime - minTime >= CLOCK_DRIFT_MIN_SPAN) {
+        double covariance = 0;
+        double variance = 0;
+        for (const auto& sample : samples) {
+            double time = (sample.localTime - minTime) - meanTime;
+            covariance += time * ((sample.offset - samples.front().offset) - meanOffset);
+            variance += time * time;
+        }
+        if (variance > 0) {
+            _drift = covariance / variance;
+        }
+    }
+
+    _reference = minTime + static_cast<int64_t>(meanTime);
+    _offset = samples.front().offset + static_cast<int64_t>(meanOffset);
+}
+
+int64_t SocketClockEstimator::ToRemote(int64_t localTime) const {
+    return localTime + _offset + static_cast<int64_t>(_drift * (localTime - _reference));
+}
+
+int64_t SocketClockEstimator::ToLocal(int64_t remoteTime) const {
+    // Inverse of ToRemote(), the drift term is small enough to evaluate at the remote time
+    int64_t localTime = remoteTime - _offset;
+    return localTime - static_cast<int64_t>(_drift * (localTime - _reference));
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,73 @@
+﻿#ifndef SOCKETCLOCK_H
+#define SOCKETCLOCK_H
+
+#include "WebSocketApp.h"
+#include <vector>
+
+namespace WebSocketApp {
+
+// Microseconds of a monotonic clock, only comparable within this process
+//   (or with a remote clock through SocketClockEstimator)
+extern int64_t MonotonicTime();
+
+// Wall clock time in milliseconds since the epoch that corresponds to a MonotonicTime() value
+extern int64_t MonotonicToWallTime(int64_t monotonicTime);
+
+//---------------------------------
+
+// Estimates the offset and drift of the remote monotonic clock from NTP style exchanges.
+//   Each exchange gives t0 (local send), t1 (remote receive), t2 (remote send), t3 (local receive).
+//   Only the samples with the shortest round trip are trusted, since queueing delays are one sided.
+class SocketClockEstimator {
+public:
+    static const int SAMPLE_COUNT = 32;
+
+    SocketClockEstimator() {
+        Clear();
+    }
+
+    void Clear();
+    void AddSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3);
+
+    bool IsValid() const {
+        return !_samples.empty();
+    }
+    int SampleCount() const {
+        return static_cast<int>(_samples.size());
+    }
+    // Remote minus local at the reference time, in microseconds
+    int64_t Offset() const {
+        return _offset;
+    }
+    // Remote clock rate relative to the local one minus 1 (e.g. 1e-5 for 10ppm fast)
+    double Drift() const {
+        return _drift;
+    }
+    // Shortest round trip seen, in microseconds
+    int64_t RoundTripDelay() const {
+        return _roundTripDelay;
+    }
+
+    int64_t ToRemote(int64_t localTime) const;
+    int64_t ToLocal(int64_t remoteTime) const;
+
+private:
+    struct Sample {
+        int64_t localTime;
+        int64_t offset;
+        int64_t delay;
+    };
+
+    std::vector<Sample> _samples;
+    int _next;
+    int64_t _reference;
+    int64_t _offset;
+    double _drift;
+    int64_t _roundTripDelay;
+
+    void Update();
+}; // class SocketClockEstimator
+
+} // namespace WebSocketApp
+
+#endif // SOCKETCLOCK_H
@@ -0,0 +1,128 @@
+﻿#include "SocketCodec.h"
+#include "SocketBase64.h"
+#include "SocketClock.h"
+#include "SocketCompressionPolicy.h"
+
+namespace WebSocketApp {
+
+namespace {
+
+const GZipCodec GZIP_CODEC;
+const Lz4Codec LZ4_CODEC;
+
+const SocketCodec* const CODECS[] = { &GZIP_CODEC, &LZ4_CODEC };
+
+} // namespace
+
+const SocketCodec* SocketCodec::Find(CompressionCodec codec) {
+    for (const SocketCodec* item : CODECS) {
+        if (item->Codec() == codec) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+const SocketCodec* SocketCodec::FindById(uint8_t id) {
+    for (const SocketCodec* item : CODECS) {
+        if (item->Id() == id) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+const SocketCodec* SocketCodec::FindByFlag(char flag) {
+    for (const SocketCodec* item : CODECS) {
+        if (item->Flag() == flag) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+CompressionCodec SocketCodec::CompressPayload(uint32_t typeId, const char* src, int length, QByteArray& dest, const SocketConnectionOptions& options) {
+    SocketCompressionPolicy* policy = options.CompressionPolicy();
+    CompressionCodec codec = (policy != nullptr) ? policy->Codec(typeId, options) : options.Codec();
+    if (codec == CompressionCodec::None) {
+        return CompressionCodec::None;
+    }
+    // Without the stream of the connection (text envelopes) the payload is compressed on its own
+    if (codec == CompressionCodec::DeflateStream && !options.IsContextTakeover()) {
+        codec = CompressionCodec::GZip;
+    }
+
+    // The level of a context takeover stream stays as negotiated, there the policy only decides whether to compress
+    bool takeover = (codec == CompressionCodec::DeflateStream);
+    int level = options.CompressionLevel();
+    if (policy != nullptr) {
+        int chosenLevel = policy->ChooseLevel(typeId, src, length, level);
+        if (chosenLevel <= 0) {
+            return CompressionCodec::None;
+        }
+        if (!takeover) {
+            level = chosenLevel;
+        }
+    }
+
+    const SocketCodec* payloadCodec = Find(codec);
+    int64_t startTime = MonotonicTime();
+    int compressedLength = takeover
+        ? options.TakeoverDeflater()->Compress(src, length, dest, level)
+        : payloadCodec->Compress(src, length, dest, level, options);
+    // The levels measured are zlib ones
+    if (policy != nullptr && codec != CompressionCodec::Lz4) {
+        policy->RecordCompression(typeId, level, length, compressedLength, MonotonicTime() - startTime);
+    }
+
+    // The stream has taken in the payload, so its output is used even when it is not smaller
+    if (compressedLength < 0 || (!takeover && compressedLength >= length)) {
+        return CompressionCodec::None;
+    }
+    return codec;
+}
+
+int SocketCodec::DecompressPayload(const SocketFrameHeader& header, const char* src, int length, QByteArray& dest, int maxLength) {
+    const SocketCodec* codec = FindById(header.CodecId());
+    if (codec == nullptr) {
+        OUTPUT_ERROR_LOG("未対応の圧縮形式：codecId=%d", header.CodecId());
+        return -1;
+    }
+    return codec->Decompress(src, length, dest, maxLength);
+}
+
+int SocketCodec::DecompressBase64(const char* src, int length, QByteArray& dest) const {
+    QByteArray compressed;
+    FromBase64(src, length, compressed);
+    return Decompress(compressed.constData(), compressed.length(), dest);
+}
+
+//---------------------------------
+
+int GZipCodec::Compress(const char* src, int length, QByteArray& dest, int level, const SocketConnectionOptions& options) const {
+    // A dictionary only helps small payloads
+    if (length >= ParallelGZip::MINIMUM_SIZE) {
+        return ParallelGZip::Compress(src, length, dest, level);
+    }
+    return options.Deflater().Compress(src, length, dest, level, options.Dictionary());
+}
+
+int GZipCodec::Decompress(const char* src, int length, QByteArray& dest, int maxLength) const {
+    return GZipInflater::ThreadInstance().Decompress(src, length, dest, maxLength);
+}
+
+int GZipCodec::DecompressBase64(const char* src, int length, QByteArray& dest) const {
+    return GZipInflater::ThreadInstance().DecompressBase64(src, length, dest);
+}
+
+//---------------------------------
+
+int Lz4Codec::Compress(const char* src, int length, QByteArray& dest, int, const SocketConnectionOptions&) const {
+    return CompressLz4(src, length, dest);
+}
+
+int Lz4Codec::Decompress(const char* src, int length, QByteArray& dest, int maxLength) const {
+    return DecompressLz4(src, length, dest, maxLength);
+}
+
+} // namespace WebSocketApp
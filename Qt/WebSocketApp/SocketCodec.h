@@ -0,0 +1,85 @@
+﻿#ifndef SOCKETCODEC_H
+#define SOCKETCODEC_H
+
+#include "SocketFrame.h"
+#include <QByteArray>
+
+namespace WebSocketApp {
+
+// Compression of a whole payload, named by SocketFrameHeader::CodecId() in binary frames
+// and by the flag character in text envelopes ("Type,c,..." for gzip).
+//   CompressionCodec::DeflateStream is not one of them: its stream belongs to the connection (StreamDeflater).
+class SocketCodec {
+public:
+    // nullptr for CompressionCodec::None and DeflateStream
+    static const SocketCodec* Find(CompressionCodec codec);
+    static const SocketCodec* FindById(uint8_t id);
+    // nullptr for '-' (not compressed) and unknown flags
+    static const SocketCodec* FindByFlag(char flag);
+
+    // Compresses the payload of a message of the type with the codec and level chosen for it.
+    //   Returns the codec used; with None the payload is to be sent as it is and dest is undefined.
+    static CompressionCodec CompressPayload(uint32_t typeId, const char* src, int length, QByteArray& dest, const SocketConnectionOptions& options);
+    // A Compressed payload that is not a ContextTakeover one; returns the size or -1
+    static int DecompressPayload(const SocketFrameHeader& header, const char* src, int length, QByteArray& dest, int maxLength = 0);
+
+    virtual ~SocketCodec() {}
+
+    virtual CompressionCodec Codec() const = 0;
+    virtual uint8_t Id() const = 0;
+    virtual char Flag() const = 0;
+    // Returns the compressed size or -1
+    virtual int Compress(const char* src, int length, QByteArray& dest, int level, const SocketConnectionOptions& options) const = 0;
+    // Fails rather than produce more than maxLength bytes (0 for no limit)
+    virtual int Decompress(const char* src, int length, QByteArray& dest, int maxLength = 0) const = 0;
+    // Decompress() for a payload that is still base64 encoded (text envelope)
+    virtual int DecompressBase64(const char* src, int length, QByteArray& dest) const;
+}; // class SocketCodec
+
+//---------------------------------
+
+// gzip, or zlib with the preset dictionary of the connection
+class GZipCodec : public SocketCodec {
+public:
+    static const uint8_t ID = 0;
+    static const char FLAG = 'c';
+
+    CompressionCodec Codec() const override {
+        return CompressionCodec::GZip;
+    }
+    uint8_t Id() const override {
+        return ID;
+    }
+    char Flag() const override {
+        return FLAG;
+    }
+    int Compress(const char* src, int length, QByteArray& dest, int level, const SocketConnectionOptions& options) const override;
+    int Decompress(const char* src, int length, QByteArray& dest, int maxLength = 0) const override;
+    int DecompressBase64(const char* src, int length, QByteArray& dest) const override;
+}; // class GZipCodec
+
+//---------------------------------
+
+// LZ4 block with the uncompressed size in front, see CompressLz4()
+class Lz4Codec : public SocketCodec {
+public:
+    static const uint8_t ID = 1;
+    static const char FLAG = 'l';
+
+    CompressionCodec Codec() const override {
+        return CompressionCodec::Lz4;
+    }
+    uint8_t Id() const override {
+        return ID;
+    }
+    char Flag() const override {
+        return FLAG;
+    }
+    // LZ4 has no levels
+    int Compress(const char* src, int length, QByteArray& dest, int level, const SocketConnectionOptions& options) const override;
+    int Decompress(const char* src, int length, QByteArray& dest, int maxLength = 0) const override;
+}; // class Lz4Codec
+
+} // namespace WebSocketApp
+
+#endif // SOCKETCODEC_H
@@ -0,0 +1,180 @@
+﻿#include "SocketCompressionPolicy.h"
+#include "SocketClock.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Weight of a new measurement in the running averages
+const double SMOOTHING = 0.2;
+
+// Below this a write interval says more about the timer than the link
+const int64_t WRITE_INTERVAL_MIN = 1000;
+
+double Smooth(double average, double value, int count) {
+    return (count == 0) ? value : average + (value - average) * SMOOTHING;
+}
+
+} // namespace
+
+namespace WebSocketApp {
+
+const int SocketCompressionPolicy::LEVELS[LEVEL_COUNT] = { 1, 3, 6, 9 };
+
+SocketCompressionPolicy::SocketCompressionPolicy() {
+    Clear();
+}
+
+void SocketCompressionPolicy::Clear() {
+    _types.clear();
+    _bandwidth = 0;
+    _backlog = 0;
+    _lastWriteTime = 0;
+}
+
+int SocketCompressionPolicy::MinimumSize(uint32_t typeId) const {
+    auto it = _minimumSizes.find(typeId);
+    return (it != _minimumSizes.end()) ? it->second : MINIMUM_SIZE_DEFAULT;
+}
+
+void SocketCompressionPolicy::SetMinimumSize(uint32_t typeId, int size) {
+    _minimumSizes[typeId] = size;
+}
+
+CompressionCodec SocketCompressionPolicy::Codec(uint32_t typeId, const SocketConnectionOptions& options) const {
+    auto it = _codecs.find(typeId);
+    return (it != _codecs.end() && options.SupportsCodec(it->second)) ? it->second : options.Codec();
+}
+
+void SocketCompressionPolicy::SetCodec(uint32_t typeId, CompressionCodec codec) {
+    _codecs[typeId] = codec;
+}
+
+int SocketCompressionPolicy::LevelIndex(int level) {
+    for (int i = 0; i < LEVEL_COUNT; ++i) {
+        if (LEVELS[i] >= level) {
+            return i;
+        }
+    }
+    return LEVEL_COUNT - 1;
+}
+
+int SocketCompressionPolicy::ChooseLevel(uint32_t typeId, const char* data, int length, int defaultLevel) {
+    if (length < MinimumSize(typeId)) {
+        return 0;
+    }
+    if (EstimateEntropy(data, length) > ENTROPY_LIMIT) {
+        return 0;
+    }
+
+    TypeStats& stats = _types[typeId];
+    bool probe = (++stats.decisions % PROBE_INTERVAL) == 0;
+    if (_bandwidth <= 0) {
+        return defaultLevel;
+    }
+
+    // Seconds per raw byte: sending it as is, or compressing it and sending the result
+    double bestCost = 1.0 / _bandwidth;
+    int bestIndex = -1;
+    int unmeasuredIndex = -1;
+    int measuredCount = 0;
+    for (int i = 0; i < LEVEL_COUNT; ++i) {
+        const LevelStats& level = stats.levels[i];
+        if (level.count == 0) {
+            if (unmeasuredIndex < 0) {
+                unmeasuredIndex = i;
+            }
+            continue;
+        }
+        ++measuredCount;
+        double cost = 1.0 / level.throughput + level.ratio / _bandwidth;
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestIndex = i;
+        }
+    }
+
+    if (measuredCount == 0) {
+        return defaultLevel;
+    }
+    if (probe) {
+        // An unmeasured level first, then the neighbours of the best one in turn
+        if (unmeasuredIndex >= 0) {
+            return LEVELS[unmeasuredIndex];
+        }
+        int step = ((stats.decisions / PROBE_INTERVAL) % 2 == 0) ? 1 : -1;
+        int index = qBound(0, (bestIndex < 0 ? 0 : bestIndex + step), LEVEL_COUNT - 1);
+        return LEVELS[index];
+    }
+    return (bestIndex < 0) ? 0 : LEVELS[bestIndex];
+}
+
+void SocketCompressionPolicy::RecordCompression(uint32_t typeId, int level, int rawLength, int compressedLength, int64_t elapsed) {
+    if (rawLength <= 0 || level <= 0) {
+        return;
+    }
+
+    LevelStats& stats = _types[typeId].levels[LevelIndex(level)];
+    double ratio = (compressedLength > 0) ? (double)compressedLength / rawLength : 1.0;
+    double throughput = rawLength * 1000000.0 / qMax<int64_t>(elapsed, 1);
+    stats.ratio = Smooth(stats.ratio, ratio, stats.count);
+    stats.throughput = Smooth(stats.throughput, throughput, stats.count);
+    ++stats.count;
+}
+
+void SocketCompressionPolicy::RecordQueued(int64_t bytes) {
+    if (_backlog <= 0) {
+        _lastWriteTime = MonotonicTime();
+    }
+    _backlog += bytes;
+}
+
+void SocketCompressionPolicy::RecordWritten(int64_t bytes) {
+    // Only while data is waiting does the write rate tell the bandwidth
+    int64_t now = MonotonicTime();
+    int64_t elapsed = now - _lastWriteTime;
+    if (_backlog > 0 && elapsed >= WRITE_INTERVAL_MIN) {
+        double bandwidth = bytes * 1000000.0 / elapsed;
+        _bandwidth = (_bandwidth <= 0) ? bandwidth : _bandwidth + (bandwidth - _bandwidth) * SMOOTHING;
+    }
+    _backlog = qMax<int64_t>(0, _backlog - bytes);
+    _lastWriteTime = now;
+}
+
+double SocketCompressionPolicy::EstimateEntropy(const char* data, int length) {
+    if (length <= 0) {
+        return 0;
+    }
+
+    int counts[256];
+    memset(counts, 0, sizeof(counts));
+    int total = 0;
+    auto count = [&](const char* begin, int size) {
+        const uchar* src = (const uchar*)begin;
+        for (int i = 0; i < size; ++i) {
+            ++counts[src[i]];
+        }
+        total += size;
+    };
+
+    if (length <= SAMPLE_COUNT * SAMPLE_SIZE) {
+        count(data, length);
+    } else {
+        int64_t stride = (length - SAMPLE_SIZE) / (SAMPLE_COUNT - 1);
+        for (int i = 0; i < SAMPLE_COUNT; ++i) {
+            count(data + stride * i, SAMPLE_SIZE);
+        }
+    }
+
+    double entropy = 0;
+    for (int c : counts) {
+        if (c > 0) {
+            double p = (double)c / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+} // namespace WebSocketApp
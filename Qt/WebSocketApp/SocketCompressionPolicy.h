@@ -0,0 +1,81 @@
+﻿#ifndef SOCKETCOMPRESSIONPOLICY_H
+#define SOCKETCOMPRESSIONPOLICY_H
+
+#include "SocketFrame.h"
+#include <unordered_map>
+
+namespace WebSocketApp {
+
+// Decides per payload whether and how hard to compress it, for one connection:
+//   - payloads under the minimum size of their message type go out as they are
+//   - a byte histogram of a few samples skips data that is already compressed (PNG, zip, ...)
+//   - the level is the one for which compressing plus sending the result takes the least time,
+//     from the ratio and throughput measured per message type and level, and the rate the socket drains at
+//   - a message type can be given its own codec (LZ4 for bulky types on fast links), used when the peer supports it
+class SocketCompressionPolicy {
+public:
+    static const int MINIMUM_SIZE_DEFAULT = 64;
+    // Every nth payload of a type tries another level, so the estimates follow the data
+    static const int PROBE_INTERVAL = 32;
+    // Bits per byte above which a payload is taken as already compressed
+    static constexpr double ENTROPY_LIMIT = 7.5;
+
+    SocketCompressionPolicy();
+
+    // Drops the measurements, for a new connection
+    void Clear();
+
+    int MinimumSize(uint32_t typeId) const;
+    void SetMinimumSize(uint32_t typeId, int size);
+
+    // The codec set for the type if the peer supports it, otherwise the negotiated one
+    CompressionCodec Codec(uint32_t typeId, const SocketConnectionOptions& options) const;
+    void SetCodec(uint32_t typeId, CompressionCodec codec);
+
+    // The zlib level to use, 0 to send the payload uncompressed
+    int ChooseLevel(uint32_t typeId, const char* data, int length, int defaultLevel);
+    // elapsed in microseconds
+    void RecordCompression(uint32_t typeId, int level, int rawLength, int compressedLength, int64_t elapsed);
+
+    // Bytes handed to the socket, and bytes it reported written
+    void RecordQueued(int64_t bytes);
+    void RecordWritten(int64_t bytes);
+    // Bytes per second, 0 until measured
+    double Bandwidth() const {
+        return _bandwidth;
+    }
+
+    // Shannon entropy in bits per byte of up to SAMPLE_COUNT slices spread over data
+    static double EstimateEntropy(const char* data, int length);
+
+private:
+    static const int SAMPLE_COUNT = 8;
+    static const int SAMPLE_SIZE = 256;
+    static const int LEVEL_COUNT = 4;
+    static const int LEVELS[LEVEL_COUNT];
+
+    struct LevelStats {
+        // Compressed / raw
+        double ratio;
+        // Raw bytes per second
+        double throughput;
+        int count;
+    };
+    struct TypeStats {
+        LevelStats levels[LEVEL_COUNT];
+        int decisions;
+    };
+
+    std::unordered_map<uint32_t, int> _minimumSizes;
+    std::unordered_map<uint32_t, CompressionCodec> _codecs;
+    std::unordered_map<uint32_t, TypeStats> _types;
+    double _bandwidth;
+    int64_t _backlog;
+    int64_t _lastWriteTime;
+
+    static int LevelIndex(int level);
+}; // class SocketCompressionPolicy
+
+} // namespace WebSocketApp
+
+#endif // SOCKETCOMPRESSIONPOLICY_H
@@ -0,0 +1,102 @@
+﻿#include "SocketDictionary.h"
+
+#include <QDir>
+#include "External/zlib/zlib.h"
+
+namespace WebSocketApp {
+
+uint32_t SocketDictionary::ComputeId(const char* data, int length) {
+    return (uint32_t)adler32(adler32(0L, Z_NULL, 0), (const Bytef*)data, (uInt)length);
+}
+
+std::string SocketDictionary::FormatId(uint32_t id) {
+    return FORMAT_STR("%08x", id);
+}
+
+bool SocketDictionary::ParseId(const std::string& str, uint32_t& id) {
+    if (str.size() != 8) {
+        return false;
+    }
+
+    char* end = nullptr;
+    unsigned long value = strtoul(str.c_str(), &end, 16);
+    if (end != str.c_str() + str.size()) {
+        return false;
+    }
+    id = (uint32_t)value;
+    return true;
+}
+
+//---------------------------------
+
+const char* SocketDictionaryRegistry::DIRECTORY_NAME = "Dictionaries";
+const char* SocketDictionaryRegistry::FILE_SUFFIX = ".dict";
+
+SocketDictionaryRegistry& SocketDictionaryRegistry::Instance() {
+    static SocketDictionaryRegistry instance;
+    return instance;
+}
+
+const SocketDictionary* SocketDictionaryRegistry::Add(const QByteArray& bytes) {
+    if (bytes.isEmpty() || bytes.length() > SocketDictionary::MAX_SIZE) {
+        OUTPUT_ERROR_LOG("辞書のサイズが不正：%d", bytes.length());
+        return nullptr;
+    }
+
+    std::unique_ptr<SocketDictionary> dictionary(new SocketDictionary(bytes));
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& item : _dictionaries) {
+        if (item->Id() == dictionary->Id()) {
+            return item.get();
+        }
+    }
+    _dictionaries.push_back(std::move(dictionary));
+    return _dictionaries.back().get();
+}
+
+const SocketDictionary* SocketDictionaryRegistry::Load(const std::string& path) {
+    QByteArray bytes;
+    if (!ReadFile(path, bytes)) {
+        OUTPUT_ERROR_LOG("辞書の読み込みに失敗：%s", path.c_str());
+        return nullptr;
+    }
+    return Add(bytes);
+}
+
+int SocketDictionaryRegistry::LoadDirectory(const std::string& directory) {
+    QDir dir(QString::fromStdString(directory));
+    if (!dir.exists()) {
+        return 0;
+    }
+
+    int count = 0;
+    const auto names = dir.entryList({ QString("*") + FILE_SUFFIX }, QDir::Files, QDir::Name);
+    for (const auto& name : names) {
+        if (Load(dir.absoluteFilePath(name).toStdString()) != nullptr) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+const SocketDictionary* SocketDictionaryRegistry::Find(uint32_t id) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& item : _dictionaries) {
+        if (item->Id() == id) {
+            return item.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint32_t> SocketDictionaryRegistry::Ids() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<uint32_t> ids;
+    ids.reserve(_dictionaries.size());
+    for (auto it = _dictionaries.rbegin(); it != _dictionaries.rend(); ++it) {
+        ids.push_back((*it)->Id());
+    }
+    return ids;
+}
+
+} // namespace WebSocketApp
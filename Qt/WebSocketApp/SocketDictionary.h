@@ -0,0 +1,70 @@
+﻿#ifndef SOCKETDICTIONARY_H
+#define SOCKETDICTIONARY_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace WebSocketApp {
+
+// Preset dictionary for deflate, trained on typical messages by Tools/DictionaryTrainer
+//   It is identified by the Adler-32 of its bytes, which zlib also writes into the stream header (FDICT),
+//   so a compressed payload names the dictionary it needs.
+class SocketDictionary {
+public:
+    // Only the last 32KB (the deflate window) can be referred to
+    static const int MAX_SIZE = 32 * 1024;
+
+    static uint32_t ComputeId(const char* data, int length);
+    // The id as advertised in SocketCapabilityMessage
+    static std::string FormatId(uint32_t id);
+    static bool ParseId(const std::string& str, uint32_t& id);
+
+    explicit SocketDictionary(const QByteArray& bytes)
+        : _bytes(bytes)
+        , _id(ComputeId(bytes.constData(), bytes.length()))
+    {
+    }
+
+    uint32_t Id() const {
+        return _id;
+    }
+    const QByteArray& Bytes() const {
+        return _bytes;
+    }
+
+private:
+    QByteArray _bytes;
+    uint32_t _id;
+}; // class SocketDictionary
+
+//---------------------------------
+
+// Dictionaries known to this process; they are never removed, so pointers to them stay valid
+class SocketDictionaryRegistry {
+public:
+    static const char* DIRECTORY_NAME;
+    static const char* FILE_SUFFIX;
+
+    static SocketDictionaryRegistry& Instance();
+
+    // Returns the registered dictionary (the existing one for the same bytes), or nullptr
+    const SocketDictionary* Add(const QByteArray& bytes);
+    const SocketDictionary* Load(const std::string& path);
+    // Loads every *.dict file, returns the number loaded
+    int LoadDirectory(const std::string& directory);
+
+    const SocketDictionary* Find(uint32_t id) const;
+    // In the order of preference, the last loaded first
+    std::vector<uint32_t> Ids() const;
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<SocketDictionary>> _dictionaries;
+}; // class SocketDictionaryRegistry
+
+} // namespace WebSocketApp
+
+#endif // SOCKETDICTIONARY_H
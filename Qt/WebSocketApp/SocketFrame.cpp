@@ -0,0 +1,79 @@
+﻿#include "SocketFrame.h"
+
+#include <QtEndian>
+
+namespace WebSocketApp {
+
+uint32_t HashMessageType(const char* str, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(str[i])) * 16777619u;
+    }
+    return hash;
+}
+
+//---------------------------------
+
+void SocketFrameHeader::Write(char* dest) const {
+    qToLittleEndian<quint32>(_typeId, dest);
+    qToLittleEndian<quint16>(_flags, dest + 4);
+    qToLittleEndian<quint16>(_version, dest + 6);
+    qToLittleEndian<qint32>(_requestId, dest + 8);
+    qToLittleEndian<quint32>(_payloadLength, dest + 12);
+    if (_version >= VERSION_TIMESTAMP) {
+        qToLittleEndian<qint64>(_timestamp, dest + 16);
+    }
+}
+
+void SocketFrameHeader::RewriteTimestamp(QByteArray& frame, int64_t timestamp) {
+    if (frame.length() >= SizeOf(VERSION_TIMESTAMP) && qFromLittleEndian<quint16>(frame.constData() + 6) >= VERSION_TIMESTAMP) {
+        qToLittleEndian<qint64>(timestamp, frame.data() + 16);
+    }
+}
+
+int SocketFrameHeader::RequiredSize(const char* src, int length) {
+    // The version decides the size
+    if (length < 8) {
+        return SizeOf(VERSION_MIN);
+    }
+    return SizeOf(qFromLittleEndian<quint16>(src + 6));
+}
+
+bool SocketFrameHeader::Read(const char* src, int length) {
+    if (!ReadHeader(src, length)) {
+        return false;
+    }
+
+    if (_payloadLength > (uint32_t)(length - Size())) {
+        OUTPUT_ERROR_LOG("フレームのペイロード長が不正：payloadLength=%u, length=%d", _payloadLength, length);
+        return false;
+    }
+
+    return true;
+}
+
+bool SocketFrameHeader::ReadHeader(const char* src, int length) {
+    if (length < SizeOf(VERSION_MIN)) {
+        OUTPUT_ERROR_LOG("フレームヘッダのサイズが不足：length=%d", length);
+        return false;
+    }
+
+    _typeId = qFromLittleEndian<quint32>(src);
+    _flags = qFromLittleEndian<quint16>(src + 4);
+    _version = qFromLittleEndian<quint16>(src + 6);
+    _requestId = qFromLittleEndian<qint32>(src + 8);
+    _payloadLength = qFromLittleEndian<quint32>(src + 12);
+
+    if (_version < VERSION_MIN || _version > VERSION) {
+        OUTPUT_ERROR_LOG("未対応のフレームバージョン：version=%d", _version);
+        return false;
+    }
+    if (length < Size()) {
+        OUTPUT_ERROR_LOG("フレームヘッダのサイズが不足：length=%d", length);
+        return false;
+    }
+    _timestamp = (_version >= VERSION_TIMESTAMP) ? qFromLittleEndian<qint64>(src + 16) : 0;
+    return true;
+}
+
+} // namespace WebSocketApp
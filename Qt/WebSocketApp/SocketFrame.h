@@ -0,0 +1,323 @@
+﻿#ifndef SOCKETFRAME_H
+#define SOCKETFRAME_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+#include <limits>
+
+namespace WebSocketApp {
+
+class SocketCompressionPolicy;
+
+// FNV-1a (32bit) of the message type name, shared with the device side
+constexpr uint32_t HashMessageType(const char* str, uint32_t hash = 2166136261u) {
+    return (*str == '\0') ? hash : HashMessageType(str + 1, (hash ^ static_cast<uint8_t>(*str)) * 16777619u);
+}
+
+extern uint32_t HashMessageType(const char* str, int length);
+
+//---------------------------------
+
+// Encoding of the payload of a binary frame
+enum class PayloadEncoding : int {
+    Json,
+    Cbor,
+}; // enum PayloadEncoding
+
+//---------------------------------
+
+// Header of a binary frame (little endian)
+//   [0]  uint32 typeId
+//   [4]  uint16 flags
+//   [6]  uint16 version
+//   [8]  int32  requestId
+//   [12] uint32 payloadLength
+//   [16] int64  timestamp (version 2 and later)
+// The payload is followed by the raw attachment bytes (if any) up to the end of the frame.
+// A Batch frame carries other frames instead, see SocketFrameBatch.
+// A ContextTakeover payload is the next message of the raw deflate stream of the connection (StreamDeflater),
+// ContextReset tells the receiver to drop the history of that stream first.
+// The top 4 bits of the flags name the codec of a Compressed payload (see SocketCodec), 0 being gzip/zlib.
+class SocketFrameHeader {
+public:
+    static const uint16_t VERSION_MIN = 1;
+    static const uint16_t VERSION_TIMESTAMP = 2;
+    static const uint16_t VERSION = 2;
+
+    static int SizeOf(uint16_t version) {
+        return (version >= VERSION_TIMESTAMP) ? 24 : 16;
+    }
+    // Bytes needed to read the header from the start of a frame of which length bytes have arrived
+    static int RequiredSize(const char* src, int length);
+
+    enum Flag : uint16_t {
+        None = 0,
+        Compressed = 1 << 0,
+        Attachment = 1 << 1,
+        Cbor = 1 << 2,
+        Batch = 1 << 3,
+        ContextTakeover = 1 << 4,
+        ContextReset = 1 << 5,
+    };
+
+    static const int CODEC_ID_SHIFT = 12;
+    static const uint16_t CODEC_ID_MASK = 0xF000;
+
+    SocketFrameHeader()
+        : _typeId(0)
+        , _flags(Flag::None)
+        , _version(VERSION)
+        , _requestId(-1)
+        , _payloadLength(0)
+        , _timestamp(0)
+    {
+    }
+
+    uint32_t TypeId() const {
+        return _typeId;
+    }
+    uint16_t Flags() const {
+        return _flags;
+    }
+    bool HasFlag(Flag flag) const {
+        return (_flags & flag) != 0;
+    }
+    PayloadEncoding Encoding() const {
+        return HasFlag(Flag::Cbor) ? PayloadEncoding::Cbor : PayloadEncoding::Json;
+    }
+    uint8_t CodecId() const {
+        return static_cast<uint8_t>(_flags >> CODEC_ID_SHIFT);
+    }
+    uint16_t Version() const {
+        return _version;
+    }
+    int RequestId() const {
+        return _requestId;
+    }
+    uint32_t PayloadLength() const {
+        return _payloadLength;
+    }
+    // MonotonicTime() of the sender when the message was created, 0 if the version has none
+    int64_t Timestamp() const {
+        return _timestamp;
+    }
+    int Size() const {
+        return SizeOf(_version);
+    }
+
+    void SetTypeId(uint32_t val) {
+        _typeId = val;
+    }
+    void SetFlag(Flag flag, bool enable = true) {
+        _flags = static_cast<uint16_t>(enable ? (_flags | flag) : (_flags & ~flag));
+    }
+    void SetCodecId(uint8_t val) {
+        _flags = static_cast<uint16_t>((_flags & ~CODEC_ID_MASK) | ((val << CODEC_ID_SHIFT) & CODEC_ID_MASK));
+    }
+    void SetRequestId(int val) {
+        _requestId = val;
+    }
+    void SetPayloadLength(uint32_t val) {
+        _payloadLength = val;
+    }
+    void SetVersion(uint16_t val) {
+        _version = val;
+    }
+    void SetTimestamp(int64_t val) {
+        _timestamp = val;
+    }
+
+    void Write(char* dest) const;
+    // Reads the header of a complete frame of length bytes
+    bool Read(const char* src, int length);
+    // Reads the header only, the rest of the frame may not have arrived yet
+    bool ReadHeader(const char* src, int length);
+
+    // Replaces the timestamp of an encoded frame (if its version has one)
+    static void RewriteTimestamp(QByteArray& frame, int64_t timestamp);
+
+private:
+    uint32_t _typeId;
+    uint16_t _flags;
+    uint16_t _version;
+    int32_t _requestId;
+    uint32_t _payloadLength;
+    int64_t _timestamp;
+}; // class SocketFrameHeader
+
+//---------------------------------
+
+// Compression applied to payloads
+enum class CompressionCodec : int {
+    None,
+    GZip,
+    // One raw deflate stream per direction across all messages, binary frames only
+    DeflateStream,
+    // LZ4 block, for links where compressing costs more time than sending
+    Lz4,
+}; // enum CompressionCodec
+
+//---------------------------------
+
+// Wire settings of one connection, agreed on by SocketCapabilityMessage.
+//   The defaults are what every device build understands: gzip compressed JSON in text envelopes.
+//   A size or count of 0 means no limit.
+class SocketConnectionOptions {
+public:
+    static const int COMPRESSION_LEVEL_DEFAULT = 1; // Z_BEST_SPEED
+    // What QWebSocket accepts by default, so no transfer that worked in text envelopes is cut off
+    static const int MAX_FRAME_SIZE_DEFAULT = std::numeric_limits<int>::max() - 1;
+
+    SocketConnectionOptions()
+        : _negotiated(false)
+        , _binaryFrame(false)
+        , _frameVersion(SocketFrameHeader::VERSION_MIN)
+        , _encoding(PayloadEncoding::Json)
+        , _codec(CompressionCodec::GZip)
+        , _remoteCodecs(1u << static_cast<int>(CompressionCodec::GZip))
+        , _compressionLevel(COMPRESSION_LEVEL_DEFAULT)
+        , _maxFrameSize(0)
+        , _chunkSize(0)
+        , _batchMaxMessages(0)
+        , _batchMaxBytes(0)
+        , _batchDelay(0)
+        , _deflater(nullptr)
+        , _takeoverDeflater(nullptr)
+        , _dictionary(nullptr)
+        , _compressionPolicy(nullptr)
+    {
+    }
+
+    bool IsNegotiated() const {
+        return _negotiated;
+    }
+    bool IsBinaryFrame() const {
+        return _binaryFrame;
+    }
+    // Header version of the binary frames to send
+    uint16_t FrameVersion() const {
+        return _frameVersion;
+    }
+    PayloadEncoding Encoding() const {
+        return _encoding;
+    }
+    CompressionCodec Codec() const {
+        return _codec;
+    }
+    // Whether the peer can read payloads of the codec, which may differ from Codec() per message type
+    bool SupportsCodec(CompressionCodec codec) const {
+        return codec == CompressionCodec::None || (_remoteCodecs & (1u << static_cast<int>(codec))) != 0;
+    }
+    int CompressionLevel() const {
+        return _compressionLevel;
+    }
+    // Largest message the peer accepts
+    int MaxFrameSize() const {
+        return _maxFrameSize;
+    }
+    // Size of the WebSocket frames a large message is split into
+    int ChunkSize() const {
+        return _chunkSize;
+    }
+    int BatchMaxMessages() const {
+        return _batchMaxMessages;
+    }
+    int BatchMaxBytes() const {
+        return _batchMaxBytes;
+    }
+    // Microseconds
+    int BatchDelay() const {
+        return _batchDelay;
+    }
+    // Compression context of the connection, or of the calling thread when none is set
+    GZipDeflater& Deflater() const {
+        return (_deflater != nullptr) ? *_deflater : GZipDeflater::ThreadInstance();
+    }
+    // Stream of the connection for CompressionCodec::DeflateStream
+    StreamDeflater* TakeoverDeflater() const {
+        return _takeoverDeflater;
+    }
+    // Payloads go through TakeoverDeflater(), otherwise they are compressed on their own with gzip
+    bool IsContextTakeover() const {
+        return _binaryFrame && _codec == CompressionCodec::DeflateStream && _takeoverDeflater != nullptr;
+    }
+    // Preset dictionary for payloads compressed on their own, nullptr for none
+    const SocketDictionary* Dictionary() const {
+        return _dictionary;
+    }
+    // Picks the level per payload when set, otherwise every payload is compressed at CompressionLevel()
+    SocketCompressionPolicy* CompressionPolicy() const {
+        return _compressionPolicy;
+    }
+
+    void SetNegotiated(bool val) {
+        _negotiated = val;
+    }
+    void SetBinaryFrame(bool val) {
+        _binaryFrame = val;
+    }
+    void SetFrameVersion(uint16_t val) {
+        _frameVersion = val;
+    }
+    void SetEncoding(PayloadEncoding val) {
+        _encoding = val;
+    }
+    void SetCodec(CompressionCodec val) {
+        _codec = val;
+    }
+    void SetSupportedCodec(CompressionCodec codec, bool enable = true) {
+        uint32_t bit = 1u << static_cast<int>(codec);
+        _remoteCodecs = enable ? (_remoteCodecs | bit) : (_remoteCodecs & ~bit);
+    }
+    void SetCompressionLevel(int val) {
+        _compressionLevel = val;
+    }
+    void SetMaxFrameSize(int val) {
+        _maxFrameSize = val;
+    }
+    void SetChunkSize(int val) {
+        _chunkSize = val;
+    }
+    void SetBatchLimits(int maxMessages, int maxBytes, int delay) {
+        _batchMaxMessages = maxMessages;
+        _batchMaxBytes = maxBytes;
+        _batchDelay = delay;
+    }
+    // Not owned, must outlive the options
+    void SetDeflater(GZipDeflater* val) {
+        _deflater = val;
+    }
+    // Not owned, must outlive the options
+    void SetTakeoverDeflater(StreamDeflater* val) {
+        _takeoverDeflater = val;
+    }
+    void SetDictionary(const SocketDictionary* val) {
+        _dictionary = val;
+    }
+    // Not owned, must outlive the options
+    void SetCompressionPolicy(SocketCompressionPolicy* val) {
+        _compressionPolicy = val;
+    }
+
+private:
+    bool _negotiated;
+    bool _binaryFrame;
+    uint16_t _frameVersion;
+    PayloadEncoding _encoding;
+    CompressionCodec _codec;
+    uint32_t _remoteCodecs;
+    int _compressionLevel;
+    int _maxFrameSize;
+    int _chunkSize;
+    int _batchMaxMessages;
+    int _batchMaxBytes;
+    int _batchDelay;
+    GZipDeflater* _deflater;
+    StreamDeflater* _takeoverDeflater;
+    const SocketDictionary* _dictionary;
+    SocketCompressionPolicy* _compressionPolicy;
+}; // class SocketConnectionOptions
+
+} // namespace WebSocketApp
+
+#endif // SOCKETFRAME_H
@@ -0,0 +1,107 @@
+﻿#include "SocketFrameBatch.h"
+#include "SocketClock.h"
+#include "SocketCodec.h"
+
+#include <QtEndian>
+
+namespace WebSocketApp {
+
+static const int FRAME_LENGTH_SIZE = 4;
+
+void SocketFrameBatch::Append(const QByteArray& frame) {
+    char length[FRAME_LENGTH_SIZE];
+    qToLittleEndian<quint32>(frame.length(), length);
+    _payload.append(length, FRAME_LENGTH_SIZE);
+    _payload.append(frame);
+    ++_count;
+}
+
+void SocketFrameBatch::Clear() {
+    // Keep the capacity for the next batch
+    _payload.resize(0);
+    _count = 0;
+}
+
+bool SocketFrameBatch::Export(QByteArray& frame, const SocketConnectionOptions& options) const {
+    if (_count == 0) {
+        return false;
+    }
+    if (_count == 1 && (options.BatchMaxBytes() <= 0 || _payload.length() < options.BatchMaxBytes())) {
+        frame = _payload.mid(FRAME_LENGTH_SIZE);
+        return true;
+    }
+
+    const char* payload = _payload.constData();
+    int payloadLength = _payload.length();
+
+    QByteArray compressed;
+    bool contextReset = (options.IsContextTakeover() && options.TakeoverDeflater()->IsResetPending());
+    CompressionCodec compression = SocketCodec::CompressPayload(TYPE_ID, payload, payloadLength, compressed, options);
+    if (compression != CompressionCodec::None) {
+        payload = compressed.constData();
+        payloadLength = compressed.length();
+    }
+    bool takeover = (compression == CompressionCodec::DeflateStream);
+    const SocketCodec* codec = SocketCodec::Find(compression);
+
+    SocketFrameHeader header;
+    header.SetTypeId(TYPE_ID);
+    header.SetVersion(options.FrameVersion());
+    header.SetFlag(SocketFrameHeader::Batch);
+    header.SetFlag(SocketFrameHeader::Compressed, compression != CompressionCodec::None);
+    header.SetCodecId(codec != nullptr ? codec->Id() : 0);
+    header.SetFlag(SocketFrameHeader::ContextTakeover, takeover);
+    header.SetFlag(SocketFrameHeader::ContextReset, takeover && contextReset);
+    header.SetPayloadLength(payloadLength);
+    header.SetTimestamp(MonotonicTime());
+
+    frame.resize(header.Size() + payloadLength);
+    header.Write(frame.data());
+    memcpy(frame.data() + header.Size(), payload, payloadLength);
+    return true;
+}
+
+bool SocketFrameBatch::Unpack(const QByteArray& frame, QByteArray& buffer, std::vector<QByteArray>& frames) {
+    frames.clear();
+
+    SocketFrameHeader header;
+    if (!header.Read(frame.constData(), frame.length()) || !header.HasFlag(SocketFrameHeader::Batch)) {
+        return false;
+    }
+
+    const char* payload = frame.constData() + header.Size();
+    int payloadLength = (int)header.PayloadLength();
+    if (header.HasFlag(SocketFrameHeader::ContextTakeover)) {
+        OUTPUT_ERROR_LOG("バッチはコンテキスト引き継ぎの圧縮のため単独では解凍できません");
+        return false;
+    }
+    if (header.HasFlag(SocketFrameHeader::Compressed)) {
+        payloadLength = SocketCodec::DecompressPayload(header, payload, payloadLength, buffer);
+        if (payloadLength <= 0) {
+            OUTPUT_ERROR_LOG("バッチの解凍に失敗");
+            return false;
+        }
+        payload = buffer.constData();
+    }
+
+    const char* current = payload;
+    const char* end = payload + payloadLength;
+    while (current < end) {
+        if (end - current < FRAME_LENGTH_SIZE) {
+            OUTPUT_ERROR_LOG("バッチの書式が不正：offset=%d", (int)(current - payload));
+            return false;
+        }
+        uint32_t length = qFromLittleEndian<quint32>(current);
+        current += FRAME_LENGTH_SIZE;
+        if (length > (uint32_t)(end - current)) {
+            OUTPUT_ERROR_LOG("バッチ内のフレーム長が不正：length=%u", length);
+            return false;
+        }
+
+        frames.push_back(QByteArray::fromRawData(current, (int)length));
+        current += length;
+    }
+    return true;
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,46 @@
+﻿#ifndef SOCKETFRAMEBATCH_H
+#define SOCKETFRAMEBATCH_H
+
+#include "SocketFrame.h"
+#include <vector>
+
+namespace WebSocketApp {
+
+// Packs many small frames into one Batch frame, so they share one WebSocket frame and one compression stream.
+//   Batch payload : { uint32 frameLength, frame }...
+class SocketFrameBatch {
+public:
+    static constexpr uint32_t TYPE_ID = HashMessageType("SocketFrameBatch");
+
+    SocketFrameBatch()
+        : _count(0)
+    {
+    }
+
+    int Count() const {
+        return _count;
+    }
+    int Size() const {
+        return _payload.length();
+    }
+    bool IsEmpty() const {
+        return _count == 0;
+    }
+
+    void Append(const QByteArray& frame);
+    void Clear();
+
+    // A small batch of one is exported as that frame alone, a large one is still compressed
+    bool Export(QByteArray& frame, const SocketConnectionOptions& options) const;
+
+    // NOTE: The frames refer to the memory of frame (or buffer when it was compressed)
+    static bool Unpack(const QByteArray& frame, QByteArray& buffer, std::vector<QByteArray>& frames);
+
+private:
+    QByteArray _payload;
+    int _count;
+}; // class SocketFrameBatch
+
+} // namespace WebSocketApp
+
+#endif // SOCKETFRAMEBATCH_H
@@ -0,0 +1,719 @@
+﻿#include "SocketJson.h"
+#include "SocketBase64.h"
+
+#include <QLocale>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOCKET_JSON_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SOCKET_JSON_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+inline bool IsWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline bool NeedsEscape(uchar c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+void AppendUtf8(std::string& dest, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        dest += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        dest += static_cast<char>(0xC0 | (codePoint >> 6));
+        dest += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        dest += static_cast<char>(0xE0 | (codePoint >> 12));
+        dest += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        dest += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        dest += static_cast<char>(0xF0 | (codePoint >> 18));
+        dest += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        dest += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        dest += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+//---------------------------------
+// Structural scanner
+//   Each Find*() returns the first byte in [p, end) of the given class, or end.
+//   16 bytes are classified at once with SSE2 / NEON; the tail falls back to the scalar loop.
+
+inline bool IsStringSpecial(uchar c) {
+    return c == '"' || c == '\\';
+}
+
+inline bool IsStructural(uchar c) {
+    return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
+}
+
+#if defined(SOCKET_JSON_SSE2)
+
+inline int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline __m128i MatchByte(__m128i block, char c) {
+    return _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+}
+
+inline uint32_t StringSpecialMask(__m128i block) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(MatchByte(block, '"'), MatchByte(block, '\\'))));
+}
+
+inline uint32_t EscapeMask(__m128i block) {
+    // Unsigned c < 0x20 is min(c, 0x1F) == c
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1F)), block);
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(control, _mm_or_si128(MatchByte(block, '"'), MatchByte(block, '\\')))));
+}
+
+inline uint32_t StructuralMask(__m128i block) {
+    // '{' | 0x20 == '{' and '[' | 0x20 == '{', likewise for the closing brackets
+    __m128i folded = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i brackets = _mm_or_si128(MatchByte(folded, '{'), MatchByte(folded, '}'));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(brackets, MatchByte(block, '"'))));
+}
+
+#define SOCKET_JSON_FIND(name, maskFunction, scalarFunction) \
+    const char* name(const char* p, const char* end) { \
+        for (; end - p >= 16; p += 16) { \
+            uint32_t mask = maskFunction(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); \
+            if (mask != 0) { \
+                return p + CountTrailingZeros(mask); \
+            } \
+        } \
+        while (p < end && !scalarFunction(static_cast<uchar>(*p))) { \
+            ++p; \
+        } \
+        return p; \
+    }
+
+#elif defined(SOCKET_JSON_NEON)
+
+inline int CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+inline uint64_t ToMask(uint8x16_t matches) {
+    // Narrow each byte to a nibble: 4 mask bits per input byte
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+}
+
+inline uint8x16_t MatchByte(uint8x16_t block, char c) {
+    return vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(c)));
+}
+
+inline uint64_t StringSpecialMask(uint8x16_t block) {
+    return ToMask(vorrq_u8(MatchByte(block, '"'), MatchByte(block, '\\')));
+}
+
+inline uint64_t EscapeMask(uint8x16_t block) {
+    uint8x16_t control = vcltq_u8(block, vdupq_n_u8(0x20));
+    return ToMask(vorrq_u8(control, vorrq_u8(MatchByte(block, '"'), MatchByte(block, '\\'))));
+}
+
+inline uint64_t StructuralMask(uint8x16_t block) {
+    uint8x16_t folded = vorrq_u8(block, vdupq_n_u8(0x20));
+    uint8x16_t brackets = vorrq_u8(MatchByte(folded, '{'), MatchByte(folded, '}'));
+    return ToMask(vorrq_u8(brackets, MatchByte(block, '"')));
+}
+
+#define SOCKET_JSON_FIND(name, maskFunction, scalarFunction) \
+    const char* name(const char* p, const char* end) { \
+        for (; end - p >= 16; p += 16) { \
+            uint64_t mask = maskFunction(vld1q_u8(reinterpret_cast<const uint8_t*>(p))); \
+            if (mask != 0) { \
+                return p + (CountTrailingZeros(mask) >> 2); \
+            } \
+        } \
+        while (p < end && !scalarFunction(static_cast<uchar>(*p))) { \
+            ++p; \
+        } \
+        return p; \
+    }
+
+#else
+
+#define SOCKET_JSON_FIND(name, maskFunction, scalarFunction) \
+    const char* name(const char* p, const char* end) { \
+        while (p < end && !scalarFunction(static_cast<uchar>(*p))) { \
+            ++p; \
+        } \
+        return p; \
+    }
+
+#endif
+
+SOCKET_JSON_FIND(FindStringSpecial, StringSpecialMask, IsStringSpecial)
+SOCKET_JSON_FIND(FindEscape, EscapeMask, NeedsEscape)
+SOCKET_JSON_FIND(FindStructural, StructuralMask, IsStructural)
+
+#undef SOCKET_JSON_FIND
+
+} // namespace
+
+//---------------------------------
+
+namespace WebSocketApp {
+
+void JsonWriter::WriteKey(const char* key, int keyLength) {
+    if (!_first) {
+        _buffer.append(',');
+    }
+    _first = false;
+
+    _buffer.append('"');
+    _buffer.append(key, keyLength);
+    _buffer.append("\":", 2);
+}
+
+void JsonWriter::WriteInteger(int64_t value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* begin = end;
+
+    uint64_t absolute = (value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+    do {
+        *--begin = static_cast<char>('0' + absolute % 10);
+        absolute /= 10;
+    } while (absolute != 0);
+    if (value < 0) {
+        *--begin = '-';
+    }
+
+    _buffer.append(begin, static_cast<int>(end - begin));
+}
+
+void JsonWriter::WriteString(const char* str, int length) {
+    _buffer.append('"');
+
+    // Append unescaped runs in bulk
+    const char* end = str + length;
+    const char* runBegin = str;
+    while (true) {
+        const char* special = FindEscape(runBegin, end);
+        _buffer.append(runBegin, static_cast<int>(special - runBegin));
+        if (special == end) {
+            break;
+        }
+        runBegin = special + 1;
+
+        uchar c = static_cast<uchar>(*special);
+
+        switch (c) {
+        case '"':
+            _buffer.append("\\\"", 2);
+            break;
+        case '\\':
+            _buffer.append("\\\\", 2);
+            break;
+        case '\n':
+            _buffer.append("\\n", 2);
+            break;
+        case '\r':
+            _buffer.append("\\r", 2);
+            break;
+        case '\t':
+            _buffer.append("\\t", 2);
+            break;
+        default:
+            {
+                char escaped[] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xF] };
+                _buffer.append(escaped, sizeof(escaped));
+            }
+            break;
+        }
+    }
+
+    _buffer.append('"');
+}
+
+void JsonWriter::Write(const char* key, int keyLength, bool value) {
+    WriteKey(key, keyLength);
+    if (value) {
+        _buffer.append("true", 4);
+    } else {
+        _buffer.append("false", 5);
+    }
+}
+
+void JsonWriter::Write(const char* key, int keyLength, int value) {
+    WriteKey(key, keyLength);
+    WriteInteger(value);
+}
+
+void JsonWriter::Write(const char* key, int keyLength, int64_t value) {
+    WriteKey(key, keyLength);
+    WriteInteger(value);
+}
+
+void JsonWriter::Write(const char* key, int keyLength, float value) {
+    WriteKey(key, keyLength);
+    // QByteArray::number() always uses the C locale
+    _buffer.append(QByteArray::number(static_cast<double>(value), 'g', 9));
+}
+
+void JsonWriter::Write(const char* key, int keyLength, double value) {
+    WriteKey(key, keyLength);
+    _buffer.append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+}
+
+void JsonWriter::Write(const char* key, int keyLength, const std::string& value) {
+    WriteKey(key, keyLength);
+    WriteString(value.c_str(), static_cast<int>(value.size()));
+}
+
+void JsonWriter::Write(const char* key, int keyLength, const std::vector<std::string>& value) {
+    BeginArray(key, keyLength);
+    for (const auto& item : value) {
+        WriteElement(item.c_str(), static_cast<int>(item.size()));
+    }
+    EndArray();
+}
+
+void JsonWriter::BeginArray(const char* key, int keyLength) {
+    WriteKey(key, keyLength);
+    _buffer.append('[');
+    _first = true;
+}
+
+void JsonWriter::WriteElement(const char* str, int length) {
+    if (!_first) {
+        _buffer.append(',');
+    }
+    _first = false;
+    WriteString(str, length);
+}
+
+void JsonWriter::EndArray() {
+    _buffer.append(']');
+    _first = false;
+}
+
+void JsonWriter::WriteBase64(const char* key, int keyLength, const QByteArray& value) {
+    WriteKey(key, keyLength);
+    // The base64 alphabet never needs escaping
+    _buffer.append('"');
+    AppendBase64(_buffer, value.constData(), value.length());
+    _buffer.append('"');
+}
+
+//---------------------------------
+
+bool JsonReader::Fail() {
+    _error = true;
+    return false;
+}
+
+bool JsonReader::SkipWhitespace() {
+    while (_current < _end && IsWhitespace(*_current)) {
+        ++_current;
+    }
+    return _current < _end;
+}
+
+bool JsonReader::Expect(char c) {
+    if (!SkipWhitespace() || *_current != c) {
+        return Fail();
+    }
+    ++_current;
+    return true;
+}
+
+bool JsonReader::ReadLiteral(const char* literal, int length) {
+    if (_end - _current < length || memcmp(_current, literal, length) != 0) {
+        return Fail();
+    }
+    _current += length;
+    return true;
+}
+
+bool JsonReader::BeginObject() {
+    if (!Expect('{')) {
+        return false;
+    }
+    _firstMember = true;
+    return true;
+}
+
+bool JsonReader::NextKey(const char*& key, int& keyLength) {
+    if (_error || !SkipWhitespace()) {
+        return Fail();
+    }
+
+    if (*_current == '}') {
+        ++_current;
+        return false;
+    }
+    if (!_firstMember && !Expect(',')) {
+        return false;
+    }
+    _firstMember = false;
+
+    std::string scratch;
+    if (!ReadStringView(key, keyLength, scratch)) {
+        return false;
+    }
+    if (!scratch.empty()) {
+        // Escaped keys never match a field name
+        key = "";
+        keyLength = 0;
+    }
+
+    return Expect(':');
+}
+
+bool JsonReader::ReadStringView(const char*& str, int& length, std::string& scratch) {
+    if (!Expect('"')) {
+        return false;
+    }
+
+    const char* begin = _current;
+    _current = FindStringSpecial(_current, _end);
+    if (_current >= _end) {
+        return Fail();
+    }
+
+    if (*_current == '"') {
+        str = begin;
+        length = static_cast<int>(_current - begin);
+        ++_current;
+        return true;
+    }
+
+    if (!ReadEscapedString(begin, scratch)) {
+        return false;
+    }
+    str = scratch.c_str();
+    length = static_cast<int>(scratch.size());
+    return true;
+}
+
+bool JsonReader::SkipString() {
+    if (!Expect('"')) {
+        return false;
+    }
+
+    while (true) {
+        _current = FindStringSpecial(_current, _end);
+        if (_current >= _end) {
+            return Fail();
+        }
+        if (*_current++ == '"') {
+            return true;
+        }
+        // Skip the escaped character; \uXXXX needs no special care
+        ++_current;
+    }
+}
+
+bool JsonReader::ReadEscapedString(const char* begin, std::string& value) {
+    value.assign(begin, _current - begin);
+
+    while (_current < _end) {
+        const char* special = FindStringSpecial(_current, _end);
+        value.append(_current, special - _current);
+        _current = special;
+        if (_current >= _end) {
+            break;
+        }
+        if (*_current++ == '"') {
+            return true;
+        }
+        if (_current >= _end) {
+            break;
+        }
+
+        char c = *_current++;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            value += c;
+            break;
+        case 'b':
+            value += '\b';
+            break;
+        case 'f':
+            value += '\f';
+            break;
+        case 'n':
+            value += '\n';
+            break;
+        case 'r':
+            value += '\r';
+            break;
+        case 't':
+            value += '\t';
+            break;
+        case 'u':
+            {
+                uint32_t codePoint = 0;
+                for (int i = 0; i < 4; ++i) {
+                    int hex = (_current < _end ? HexValue(*_current++) : -1);
+                    if (hex < 0) {
+                        return Fail();
+                    }
+                    codePoint = (codePoint << 4) | hex;
+                }
+
+                // Combine a surrogate pair
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && _end - _current >= 6 && _current[0] == '\\' && _current[1] == 'u') {
+                    uint32_t low = 0;
+                    for (int i = 2; i < 6; ++i) {
+                        int hex = HexValue(_current[i]);
+                        if (hex < 0) {
+                            return Fail();
+                        }
+                        low = (low << 4) | hex;
+                    }
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        _current += 6;
+                    }
+                }
+                AppendUtf8(value, codePoint);
+            }
+            break;
+        default:
+            return Fail();
+        }
+    }
+    return Fail();
+}
+
+bool JsonReader::ReadNumberToken(const char*& token, int& length) {
+    if (!SkipWhitespace()) {
+        return Fail();
+    }
+
+    token = _current;
+    while (_current < _end) {
+        char c = *_current;
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+            ++_current;
+        } else {
+            break;
+        }
+    }
+    length = static_cast<int>(_current - token);
+    return (length > 0 ? true : Fail());
+}
+
+bool JsonReader::Read(bool& value) {
+    if (!SkipWhitespace()) {
+        return Fail();
+    }
+    if (*_current == 't') {
+        value = true;
+        return ReadLiteral("true", 4);
+    }
+    value = false;
+    return ReadLiteral("false", 5);
+}
+
+bool JsonReader::Read(int& value) {
+    int64_t longValue = 0;
+    if (!Read(longValue)) {
+        return false;
+    }
+    value = static_cast<int>(longValue);
+    return true;
+}
+
+bool JsonReader::Read(int64_t& value) {
+    const char* token = nullptr;
+    int length = 0;
+    if (!ReadNumberToken(token, length)) {
+        return false;
+    }
+
+    const char* c = token;
+    const char* end = token + length;
+    bool negative = (*c == '-');
+    if (negative) {
+        ++c;
+    }
+
+    uint64_t absolute = 0;
+    for (; c < end && *c >= '0' && *c <= '9'; ++c) {
+        absolute = absolute * 10 + (*c - '0');
+    }
+    if (c != end) {
+        // Fractional or exponent form
+        double doubleValue = QByteArray::fromRawData(token, length).toDouble();
+        value = static_cast<int64_t>(doubleValue);
+        return true;
+    }
+
+    value = negative ? -static_cast<int64_t>(absolute) : static_cast<int64_t>(absolute);
+    return true;
+}
+
+bool JsonReader::Read(float& value) {
+    double doubleValue = 0;
+    if (!Read(doubleValue)) {
+        return false;
+    }
+    value = static_cast<float>(doubleValue);
+    return true;
+}
+
+bool JsonReader::Read(double& value) {
+    const char* token = nullptr;
+    int length = 0;
+    if (!ReadNumberToken(token, length)) {
+        return false;
+    }
+
+    // QByteArray::toDouble() always uses the C locale
+    bool ok = false;
+    value = QByteArray::fromRawData(token, length).toDouble(&ok);
+    return (ok ? true : Fail());
+}
+
+bool JsonReader::Read(std::string& value) {
+    if (!SkipWhitespace()) {
+        return Fail();
+    }
+    if (*_current == 'n') {
+        value.clear();
+        return ReadLiteral("null", 4);
+    }
+
+    const char* str = nullptr;
+    int length = 0;
+    std::string scratch;
+    if (!ReadStringView(str, length, scratch)) {
+        return false;
+    }
+    if (str == scratch.c_str()) {
+        value.swap(scratch);
+    } else {
+        value.assign(str, length);
+    }
+    return true;
+}
+
+bool JsonReader::Read(std::vector<std::string>& value) {
+    value.clear();
+    return ReadArray([&value](JsonReader& reader) {
+        value.emplace_back();
+        return reader.Read(value.back());
+    });
+}
+
+bool JsonReader::BeginArray(bool& isNull) {
+    isNull = false;
+    if (!SkipWhitespace()) {
+        return Fail();
+    }
+    if (*_current == 'n') {
+        isNull = true;
+        return ReadLiteral("null", 4);
+    }
+    return Expect('[');
+}
+
+bool JsonReader::NextElement(bool& first) {
+    if (_error || !SkipWhitespace()) {
+        return Fail();
+    }
+
+    if (*_current == ']') {
+        ++_current;
+        return false;
+    }
+    if (!first && !Expect(',')) {
+        return false;
+    }
+    first = false;
+    return true;
+}
+
+bool JsonReader::SkipValue() {
+    if (!SkipWhitespace()) {
+        return Fail();
+    }
+
+    switch (*_current) {
+    case '"':
+        return SkipString();
+    case '{':
+    case '[':
+        {
+            // Jump between structural bytes and track the nesting depth only;
+            // strings are skipped so their brackets are ignored
+            int depth = 0;
+            while (true) {
+                _current = FindStructural(_current, _end);
+                if (_current >= _end) {
+                    return Fail();
+                }
+
+                char c = *_current;
+                if (c == '"') {
+                    if (!SkipString()) {
+                        return false;
+                    }
+                    continue;
+                }
+
+                ++_current;
+                if (c == '{' || c == '[') {
+                    ++depth;
+                } else if (--depth == 0) {
+                    return true;
+                }
+            }
+        }
+    case 't':
+        return ReadLiteral("true", 4);
+    case 'f':
+        return ReadLiteral("false", 5);
+    case 'n':
+        return ReadLiteral("null", 4);
+    default:
+        {
+            const char* token = nullptr;
+            int length = 0;
+            return ReadNumberToken(token, length);
+        }
+    }
+}
+
+} // namespace WebSocketApp
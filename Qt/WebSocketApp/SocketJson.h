@@ -0,0 +1,160 @@
+﻿#ifndef SOCKETJSON_H
+#define SOCKETJSON_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+#include <type_traits>
+#include <vector>
+
+namespace WebSocketApp {
+
+// Appends compact JSON directly to an output buffer
+class JsonWriter {
+public:
+    explicit JsonWriter(QByteArray& buffer)
+        : _buffer(buffer)
+        , _first(true)
+    {
+    }
+
+    void BeginObject() {
+        _buffer.append('{');
+        _first = true;
+    }
+    void EndObject() {
+        _buffer.append('}');
+        _first = false;
+    }
+
+    void Write(const char* key, int keyLength, bool value);
+    void Write(const char* key, int keyLength, int value);
+    void Write(const char* key, int keyLength, int64_t value);
+    void Write(const char* key, int keyLength, float value);
+    void Write(const char* key, int keyLength, double value);
+    void Write(const char* key, int keyLength, const std::string& value);
+    void Write(const char* key, int keyLength, const std::vector<std::string>& value);
+    void WriteBase64(const char* key, int keyLength, const QByteArray& value);
+
+    // Writes an array of strings one element at a time: BeginArray(), WriteElement()..., EndArray()
+    void BeginArray(const char* key, int keyLength);
+    void WriteElement(const char* str, int length);
+    void EndArray();
+
+    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    void Write(const char* key, int keyLength, T value) {
+        Write(key, keyLength, static_cast<int>(value));
+    }
+
+private:
+    QByteArray& _buffer;
+    bool _first;
+
+    void WriteKey(const char* key, int keyLength);
+    void WriteInteger(int64_t value);
+    void WriteString(const char* str, int length);
+}; // class JsonWriter
+
+//---------------------------------
+
+// Reads JSON in a single pass over the input without building a DOM
+//   The input does not have to be null terminated.
+class JsonReader {
+public:
+    JsonReader(const char* data, int length)
+        : _source(nullptr)
+        , _current(data)
+        , _end(data + length)
+        , _error(false)
+        , _firstMember(true)
+    {
+    }
+    // Lets string views be kept as slices of source
+    explicit JsonReader(const QByteArray& source)
+        : _source(&source)
+        , _current(source.constData())
+        , _end(source.constData() + source.length())
+        , _error(false)
+        , _firstMember(true)
+    {
+    }
+
+    // The buffer being read, or nullptr when it was given as a plain pointer
+    const QByteArray* Source() const {
+        return _source;
+    }
+
+    bool HasError() const {
+        return _error;
+    }
+
+    bool BeginObject();
+    // Returns false at the end of the object (or on error)
+    bool NextKey(const char*& key, int& keyLength);
+
+    bool Read(bool& value);
+    bool Read(int& value);
+    bool Read(int64_t& value);
+    bool Read(float& value);
+    bool Read(double& value);
+    bool Read(std::string& value);
+    bool Read(std::vector<std::string>& value);
+
+    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    bool Read(T& value) {
+        int intValue = 0;
+        if (!Read(intValue)) {
+            return false;
+        }
+        value = static_cast<T>(intValue);
+        return true;
+    }
+
+    // Returns the string as a view into the input when it has no escapes, otherwise unescaped into scratch
+    bool ReadStringView(const char*& str, int& length, std::string& scratch);
+
+    // Reads an array one element at a time: BeginArray(), then NextElement() before each element
+    //   until it returns false. A null array reads as an empty one.
+    bool BeginArray(bool& isNull);
+    bool NextElement(bool& first);
+
+    // func(JsonReader&) reads exactly one element and returns false to abort
+    template<class Func>
+    bool ReadArray(Func func) {
+        bool isNull = false;
+        if (!BeginArray(isNull)) {
+            return false;
+        }
+        if (isNull) {
+            return true;
+        }
+
+        bool first = true;
+        while (NextElement(first)) {
+            if (!func(*this)) {
+                return Fail();
+            }
+        }
+        return !_error;
+    }
+
+    bool SkipValue();
+
+private:
+    const QByteArray* _source;
+    const char* _current;
+    const char* _end;
+    bool _error;
+    bool _firstMember;
+
+    bool Fail();
+    bool SkipWhitespace();
+    bool Expect(char c);
+    bool ReadLiteral(const char* literal, int length);
+    bool ReadNumberToken(const char*& token, int& length);
+    bool SkipString();
+    bool ReadEscapedString(const char* begin, std::string& value);
+}; // class JsonReader
+
+} // namespace WebSocketApp
+
+#endif // SOCKETJSON_H
@@ -1,75 +1,52 @@
 ﻿#include "SocketMessage.h"
-
-const char* SockeTextMessage::MESSAGE_TYPE = "SockeTextMessage";
-const char* SocketConnectionInformationMessage::MESSAGE_TYPE = "SocketConnectionInformationMessage";
-const char* SocketMoveGameObjectMessage::MESSAGE_TYPE = "SocketMoveGameObjectMessage";
-const char* SocketRequestMessage::MESSAGE_TYPE = "SocketRequestMessage";
-const char* SocketResponseMessage::MESSAGE_TYPE = "SocketResponseMessage";
-const char* SocketScreenShotRequestMessage::MESSAGE_TYPE = "SocketScreenShotRequestMessage";
-const char* SocketFileListRequestMessage::MESSAGE_TYPE = "SocketFileListRequestMessage";
-const char* SocketFileUploadRequestMessage::MESSAGE_TYPE = "SocketFileUploadRequestMessage";
-const char* SocketConnectGameObjectRequestMessage::MESSAGE_TYPE = "SocketConnectGameObjectRequestMessage";
-const char* SocketLogMessage::MESSAGE_TYPE = "SocketLogMessage";
-const char* SocketFileListMessage::MESSAGE_TYPE = "SocketFileListMessage";
-const char* SocketFileMessage::MESSAGE_TYPE = "SocketFileMessage";
-const char* SocketImageDataMessage::MESSAGE_TYPE = "SocketImageDataMessage";
-const char* SocketScreenShotMessage::MESSAGE_TYPE = "SocketScreenShotMessage";
-
-
-SocketMessageBase* SocketMessageBase::ImportMessage(const QString& val) {
-    auto index = val.indexOf(',');
-    if (index == -1) {
-        return nullptr;
-    }
-
-    const auto& typeKey = val.mid(0, index);
-    if (index+1 >= val.length()) {
-        return nullptr;
-    }
-    ++index;
-
-    bool compressed = (val[index] == 'c');
-    index += 2;
-
-    QByteArray decodedArray;
-    {
-        const auto& base64Encoded = val.mid(index);
-        if (!compressed) {
-            decodedArray = QByteArray::fromBase64(base64Encoded.toUtf8());
-        } else {
-            auto compressedArray = QByteArray::fromBase64(base64Encoded.toUtf8());
-
-            std::vector<char> decompressed;
-            auto decompressedLength = WebSocketApp::DecompressGZip(compressedArray.data(), compressedArray.length(), decompressed);
-            if (decompressedLength == -1) {
-                OUTPUT_ERROR_LOG("%sの解凍に失敗", typeKey.toUtf8().data());
-                return nullptr;
-            }
-            decodedArray = QByteArray(&(decompressed[0]), decompressed.size());
-        }
-    }
-    QJsonDocument document = QJsonDocument::fromJson(decodedArray);
-
-    SocketMessageBase* message = nullptr;
-    {
-        if (typeKey == SocketLogMessage::MESSAGE_TYPE) {
-            message = new SocketLogMessage();
-        } else if (typeKey == SocketConnectionInformationMessage::MESSAGE_TYPE) {
-            message = new SocketConnectionInformationMessage();
-        } else if (typeKey == SocketFileListMessage::MESSAGE_TYPE) {
-            message = new SocketFileListMessage();
-        } else if (typeKey == SocketFileMessage::MESSAGE_TYPE) {
-            message = new SocketFileMessage();
-        } else if (typeKey == SocketScreenShotMessage::MESSAGE_TYPE) {
-            message = new SocketScreenShotMessage();
-        }
-    }
+#include "SocketBase64.h"
+#include "SocketCodec.h"
+#include "SocketCompressionPolicy.h"
+#include "SocketDictionary.h"
+
+#include <algorithm>
+
+DEFINE_SOCKET_MESSAGE_TYPE(SockeTextMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketConnectionInformationMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketCapabilityMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketClockSyncMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketMoveGameObjectMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketRequestMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketResponseMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketScreenShotRequestMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketFileListRequestMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketFileUploadRequestMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketConnectGameObjectRequestMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketLogMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketFileListMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketFileMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketImageDataMessage)
+DEFINE_SOCKET_MESSAGE_TYPE(SocketScreenShotMessage)
+
+REGISTER_SOCKET_MESSAGE(SocketLogMessage)
+REGISTER_SOCKET_MESSAGE(SocketConnectionInformationMessage)
+REGISTER_SOCKET_MESSAGE(SocketCapabilityMessage)
+REGISTER_SOCKET_MESSAGE(SocketClockSyncMessage)
+REGISTER_SOCKET_MESSAGE(SocketFileListMessage)
+REGISTER_SOCKET_MESSAGE(SocketFileMessage)
+REGISTER_SOCKET_MESSAGE(SocketScreenShotMessage)
+
+
+SocketMessageBase* SocketMessageBase::ImportPayload(SocketMessageBase* message, const QByteArray& payload, WebSocketApp::PayloadEncoding encoding) {
     if (message == nullptr) {
         return nullptr;
     }
 
-    auto obj = document.object();
-    if (!message->FromJson(obj)) {
+    bool result = false;
+    if (encoding == WebSocketApp::PayloadEncoding::Cbor) {
+        WebSocketApp::CborReader reader(payload.constData(), payload.length());
+        result = message->DecodeCbor(reader);
+    } else {
+        WebSocketApp::JsonReader reader(payload);
+        result = message->DecodeJson(reader);
+    }
+    if (!result) {
+        OUTPUT_ERROR_LOG("%sの読み込みに失敗", message->MessageType().c_str());
         delete message;
         return nullptr;
     }
@@ -77,411 +54,386 @@ SocketMessageBase* SocketMessageBase::ImportMessage(const QString& val) {
     return message;
 }
 
-bool SocketMessageBase::ExportMessage(QString& message) const {
-    QJsonObject obj;
-    if (!ToJson(obj)) {
-        return false;
-    }
-
-    message = QFORMAT_STR("%s,", _messageType.c_str());
-
-    if (!obj.empty()) {
-        QJsonDocument document(obj);
-
-        QByteArray array = document.toJson(QJsonDocument::Compact);
-        {
-            std::vector<char> compressed;
-            if (WebSocketApp::CompressGZip(array.data(), array.length(), compressed) <= 0) {
-                message += "-,";
-            } else if ((int)compressed.size() >= array.length()) {
-                message += "-,";
-            } else {
-                message += "c,";
-                array = QByteArray(&(compressed[0]), compressed.size());
-            }
-        }
-        message += array.toBase64();
+SocketMessageBase* SocketMessageBase::ImportMessage(const QByteArray& val) {
+    // "Type,c,<base64>" : every part is sliced out of val without copying
+    auto index = val.indexOf(',');
+    if (index == -1) {
+        return nullptr;
     }
-    return true;
-}
 
-bool SocketMessageBase::ToJson(QJsonObject& obj) const {
-    SET_JSON_VALUE(_messageType, obj);
-    return true;
-}
-
-bool SocketMessageBase::FromJson(QJsonObject& obj) {
-    if (!GET_JSON_VALUE(_messageType, obj)) {
-        return false;
+    if (index+1 >= val.length()) {
+        return nullptr;
     }
-    return true;
-}
-
-//---------------------------------
 
-bool SockeTextMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    SocketMessageBase* message = SocketMessageRegistry::Instance().Create(WebSocketApp::HashMessageType(val.constData(), index));
+    if (message == nullptr) {
+        OUTPUT_ERROR_LOG("未対応のメッセージタイプ：%s", std::string(val.constData(), index).c_str());
+        return nullptr;
     }
+    // The text envelope carries no timestamp
+    message->SetTimestamp(0);
+    ++index;
 
-    SET_JSON_VALUE(_text, obj);
-
-    return true;
-}
-
-//---------------------------------
-
-int SocketRequestMessage::_nextRequestId = 0;
+    const WebSocketApp::SocketCodec* codec = WebSocketApp::SocketCodec::FindByFlag(val[index]);
+    index += 2;
 
-bool SocketRequestMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    const auto& base64Encoded = QByteArray::fromRawData(val.constData() + index, qMax(0, val.length() - index));
+    if (codec == nullptr) {
+        QByteArray payload;
+        WebSocketApp::FromBase64(base64Encoded.constData(), base64Encoded.length(), payload);
+        return ImportPayload(message, payload, WebSocketApp::PayloadEncoding::Json);
     }
 
-    SET_JSON_VALUE(_request, obj);
-    SET_JSON_VALUE(_requestId, obj);
-
-    return true;
-}
-
-//---------------------------------
-
-bool SocketScreenShotRequestMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketRequestMessage::ToJson(obj)) {
-        return false;;
+    // Decoded and decompressed in one pass. The payload is kept by a lazily decoded attachment,
+    // so it goes into an owning buffer that the parser then reads in place.
+    QByteArray decompressed;
+    if (codec->DecompressBase64(base64Encoded.constData(), base64Encoded.length(), decompressed) <= 0) {
+        OUTPUT_ERROR_LOG("%sの解凍に失敗", message->MessageType().c_str());
+        delete message;
+        return nullptr;
     }
-
-    SET_JSON_VALUE(_stop, obj);
-    SET_JSON_VALUE(_interval, obj);
-    return true;
+    return ImportPayload(message, decompressed, WebSocketApp::PayloadEncoding::Json);
 }
 
-//---------------------------------
-
-bool SocketFileListRequestMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketRequestMessage::ToJson(obj)) {
-        return false;;
+SocketMessageBase* SocketMessageBase::ImportMessage(const std::string& messageType, const QByteArray& payload) {
+    SocketMessageBase* message = SocketMessageRegistry::Instance().Create(WebSocketApp::HashMessageType(messageType.c_str(), (int)messageType.size()));
+    if (message == nullptr) {
+        OUTPUT_ERROR_LOG("未対応のメッセージタイプ：%s", messageType.c_str());
+        return nullptr;
     }
-
-    SET_JSON_INT_VALUE(_directoryType, obj);
-    SET_JSON_VALUE(_targetPath, obj);
-    return true;
+    message->SetTimestamp(0);
+    return ImportPayload(message, payload, WebSocketApp::PayloadEncoding::Json);
 }
 
-//---------------------------------
-
-bool SocketFileUploadRequestMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketRequestMessage::ToJson(obj)) {
-        return false;;
+SocketMessageBase* SocketMessageBase::ImportBinaryMessage(const QByteArray& val, WebSocketApp::SocketFrameHeader* frameHeader) {
+    WebSocketApp::SocketFrameHeader header;
+    if (!header.Read(val.constData(), val.length())) {
+        return nullptr;
     }
-
-    SET_JSON_INT_VALUE(_directoryType, obj);
-    SET_JSON_VALUE(_targetPath, obj);
-    return true;
-}
-
-//---------------------------------
-
-bool SocketConnectGameObjectRequestMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketRequestMessage::ToJson(obj)) {
-        return false;;
+    if (frameHeader != nullptr) {
+        *frameHeader = header;
     }
 
-    SET_JSON_VALUE(_gameObjectName, obj);
-    return true;
-}
-
-//---------------------------------
-
-bool SocketResponseMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    SocketMessageBase* message = SocketMessageRegistry::Instance().Create(header.TypeId());
+    if (message == nullptr) {
+        OUTPUT_ERROR_LOG("未対応のメッセージタイプ：typeId=0x%08X", header.TypeId());
+        return nullptr;
     }
 
-    SET_JSON_VALUE(_request, obj);
-    SET_JSON_VALUE(_requestId, obj);
+    message->SetTimestamp(header.Timestamp());
 
-    return true;
-}
-
-bool SocketResponseMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
+    const char* payload = val.constData() + header.Size();
+    int payloadLength = (int)header.PayloadLength();
+    if (header.HasFlag(WebSocketApp::SocketFrameHeader::Attachment) && message->Attachment() != nullptr) {
+        int attachmentOffset = header.Size() + payloadLength;
+        message->Attachment()->SetEncoded(val, attachmentOffset, val.length() - attachmentOffset, WebSocketApp::SocketAttachment::Encoding::Raw);
     }
 
-    if (!GET_JSON_VALUE(_request, obj)) {
-        return false;
+    if (!header.HasFlag(WebSocketApp::SocketFrameHeader::Compressed)) {
+        return ImportPayload(message, QByteArray::fromRawData(payload, payloadLength), header.Encoding());
     }
-    if (!GET_JSON_VALUE(_requestId, obj)) {
-        return false;
+    if (header.HasFlag(WebSocketApp::SocketFrameHeader::ContextTakeover)) {
+        // Only SocketBinaryStreamDecoder follows the stream of the connection
+        OUTPUT_ERROR_LOG("%sはコンテキスト引き継ぎの圧縮のため単独では解凍できません", message->MessageType().c_str());
+        delete message;
+        return nullptr;
     }
 
-    return true;
-}
-
-//---------------------------------
-
-bool SocketLogMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
+    QByteArray decompressed;
+    if (WebSocketApp::SocketCodec::DecompressPayload(header, payload, payloadLength, decompressed) <= 0) {
+        OUTPUT_ERROR_LOG("%sの解凍に失敗", message->MessageType().c_str());
+        delete message;
+        return nullptr;
     }
+    return ImportPayload(message, decompressed, header.Encoding());
+}
 
-    if (!GET_JSON_INT_VALUE(LogType, _logType, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_time, obj)) {
+bool SocketMessageBase::ExportPayload(QByteArray& payload, WebSocketApp::CompressionCodec& compression, bool embedAttachment, WebSocketApp::PayloadEncoding encoding, const WebSocketApp::SocketConnectionOptions& options) const {
+    payload.clear();
+    // A file that cannot be read fails the export, rather than sending (and caching) the message without it
+    if (Attachment() != nullptr && !Attachment()->Decode()) {
+        OUTPUT_ERROR_LOG("%sの添付データを読み込めません", _messageType.c_str());
         return false;
     }
-    if (!GET_JSON_VALUE(_log, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_stackTrace, obj)) {
-        return false;
+    const WebSocketApp::SocketAttachment* attachment = (embedAttachment ? Attachment() : nullptr);
+    if (encoding == WebSocketApp::PayloadEncoding::Cbor) {
+        // Byte strings are native to CBOR, so the attachment needs no base64
+        WebSocketApp::CborWriter writer(payload);
+        writer.BeginMap();
+        if (!EncodeCbor(writer)) {
+            return false;
+        }
+        if (attachment != nullptr) {
+            writer.WriteBytes(SocketMessageCodec::ATTACHMENT_CBOR_KEY, attachment->Bytes());
+        }
+        writer.EndMap();
+    } else {
+        WebSocketApp::JsonWriter writer(payload);
+        writer.BeginObject();
+        if (!EncodeJson(writer)) {
+            return false;
+        }
+        if (attachment != nullptr) {
+            const char* key = AttachmentKey();
+            writer.WriteBase64(key, (int)strlen(key), attachment->Bytes());
+        }
+        writer.EndObject();
     }
 
-    return true;
-}
-
-bool SocketLogMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    QByteArray compressedBuffer;
+    compression = WebSocketApp::SocketCodec::CompressPayload(TypeId(), payload.constData(), payload.length(), compressedBuffer, options);
+    if (compression != WebSocketApp::CompressionCodec::None) {
+        payload.swap(compressedBuffer);
     }
-
-    SET_JSON_INT_VALUE(_logType, obj);
-    SET_JSON_VALUE(_log, obj);
-    SET_JSON_VALUE(_stackTrace, obj);
     return true;
 }
 
-//---------------------------------
-
-bool SocketConnectionInformationMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
-    }
+bool SocketMessageBase::ExportMessage(QByteArray& message, const WebSocketApp::SocketConnectionOptions& options) const {
+    // The text envelope cannot mark a context takeover payload
+    WebSocketApp::SocketConnectionOptions textOptions = options;
+    textOptions.SetTakeoverDeflater(nullptr);
 
-    if (!GET_JSON_VALUE(_requestId, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_applicationName, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_uuid, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_deviceName, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_deviceModel, obj)) {
+    QByteArray array;
+    WebSocketApp::CompressionCodec compression = WebSocketApp::CompressionCodec::None;
+    if (!ExportPayload(array, compression, true, WebSocketApp::PayloadEncoding::Json, textOptions)) {
         return false;
     }
+    const WebSocketApp::SocketCodec* codec = WebSocketApp::SocketCodec::Find(compression);
 
-    return true;
-}
-
-bool SocketConnectionInformationMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    message.clear();
+    message.reserve((int)_messageType.size() + 3 + WebSocketApp::Base64EncodedSize(array.length()));
+    message.append(_messageType.c_str(), (int)_messageType.size());
+    message.append(',');
+    if (!array.isEmpty()) {
+        message.append(codec != nullptr ? codec->Flag() : '-');
+        message.append(',');
+        WebSocketApp::AppendBase64(message, array.constData(), array.length());
     }
-
-    SET_JSON_VALUE(_applicationName, obj);
-    SET_JSON_VALUE(_uuid, obj);
-    SET_JSON_VALUE(_deviceName, obj);
-    SET_JSON_VALUE(_deviceModel, obj);
     return true;
 }
 
-//---------------------------------
-
-bool SocketFileListMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
-    }
+bool SocketMessageBase::ExportBinaryMessage(QByteArray& message, const WebSocketApp::SocketConnectionOptions& options) const {
+    bool contextReset = (options.IsContextTakeover() && options.TakeoverDeflater()->IsResetPending());
 
-    if (!GET_JSON_VALUE(_requestId, obj)) {
+    QByteArray payload;
+    WebSocketApp::CompressionCodec compression = WebSocketApp::CompressionCodec::None;
+    if (!ExportPayload(payload, compression, false, options.Encoding(), options)) {
         return false;
     }
-    if (!GET_JSON_VALUE(_directory, obj)) {
-        return false;
-    }
-    if (!ImportFiles(obj)) {
-        return false;;
+    bool takeover = (compression == WebSocketApp::CompressionCodec::DeflateStream);
+    const WebSocketApp::SocketCodec* codec = WebSocketApp::SocketCodec::Find(compression);
+
+    const QByteArray* attachment = (Attachment() != nullptr ? &(Attachment()->Bytes()) : nullptr);
+    int attachmentLength = (attachment != nullptr ? attachment->length() : 0);
+
+    WebSocketApp::SocketFrameHeader header;
+    header.SetTypeId(TypeId());
+    header.SetVersion(options.FrameVersion());
+    header.SetFlag(WebSocketApp::SocketFrameHeader::Compressed, compression != WebSocketApp::CompressionCodec::None);
+    header.SetCodecId(codec != nullptr ? codec->Id() : 0);
+    header.SetFlag(WebSocketApp::SocketFrameHeader::Attachment, attachment != nullptr);
+    header.SetFlag(WebSocketApp::SocketFrameHeader::Cbor, options.Encoding() == WebSocketApp::PayloadEncoding::Cbor);
+    header.SetFlag(WebSocketApp::SocketFrameHeader::ContextTakeover, takeover);
+    header.SetFlag(WebSocketApp::SocketFrameHeader::ContextReset, takeover && contextReset);
+    header.SetRequestId(RequestId());
+    header.SetPayloadLength(payload.length());
+    header.SetTimestamp(_timestamp);
+
+    message.resize(header.Size() + payload.length() + attachmentLength);
+    char* dest = message.data();
+    header.Write(dest);
+    dest += header.Size();
+    if (!payload.isEmpty()) {
+        memcpy(dest, payload.constData(), payload.length());
+        dest += payload.length();
+    }
+    if (attachmentLength > 0) {
+        memcpy(dest, attachment->constData(), attachmentLength);
     }
-    if (!ImportDirectories(obj)) {
-        return false;;
-    }
-
     return true;
 }
 
-bool SocketFileListMessage::ImportFiles(QJsonObject& obj) {
-    _files.clear();
+bool SocketMessageBase::CacheKey(const WebSocketApp::SocketConnectionOptions& options, std::string& key) const {
+    // A context takeover payload depends on every message sent before it
+    if (!IsCacheable() || options.IsContextTakeover()) {
+        return false;
+    }
 
-    QJsonValueRef value = obj["_files"];
-    if (!value.isArray()) {
+    // Hashing attachment bytes would cost about as much as encoding them, so only files are identified
+    const WebSocketApp::SocketAttachment* attachment = Attachment();
+    bool hasAttachment = (attachment != nullptr && !(attachment->IsDecoded() && attachment->Bytes().isEmpty()));
+    if (hasAttachment && attachment->Identity().empty()) {
         return false;
     }
 
-    auto files = value.toArray();
-    for (int i = 0, count = files.count(); i < count; ++i) {
-        _files.push_back(files[i].toString().toUtf8().data());
+    QByteArray fields;
+    WebSocketApp::JsonWriter writer(fields);
+    writer.BeginObject();
+    if (!EncodeJson(writer)) {
+        return false;
     }
+    writer.EndObject();
 
+    uint32_t dictionaryId = (options.Dictionary() != nullptr ? options.Dictionary()->Id() : 0);
+    WebSocketApp::CompressionCodec codec = (options.CompressionPolicy() != nullptr) ? options.CompressionPolicy()->Codec(TypeId(), options) : options.Codec();
+    key = FORMAT_STR("%d,%d,%d,%d,%d,%08x,", options.IsBinaryFrame() ? 1 : 0, options.FrameVersion(), (int)options.Encoding(), (int)codec, options.CompressionLevel(), dictionaryId);
+    key.append(fields.constData(), fields.length());
+    if (hasAttachment) {
+        key += '\n';
+        key += attachment->Identity();
+    }
     return true;
 }
 
-bool SocketFileListMessage::ImportDirectories(QJsonObject& obj) {
-    _directories.clear();
+bool SocketMessageBase::EncodeJson(WebSocketApp::JsonWriter& writer) const {
+    return SocketMessageCodec::EncodeJson(*this, Fields(), writer);
+}
 
-    QJsonValueRef value = obj["_directories"];
-    if (!value.isArray()) {
-        return false;
-    }
+bool SocketMessageBase::DecodeJson(WebSocketApp::JsonReader& reader) {
+    return SocketMessageCodec::DecodeJson(*this, Fields(), AttachmentKey(), reader);
+}
 
-    auto directories = value.toArray();
-    for (int i = 0, count = directories.count(); i < count; ++i) {
-        _directories.push_back(directories[i].toString().toUtf8().data());
-    }
+bool SocketMessageBase::EncodeCbor(WebSocketApp::CborWriter& writer) const {
+    return SocketMessageCodec::EncodeCbor(*this, Fields(), writer);
+}
 
-    return true;
+bool SocketMessageBase::DecodeCbor(WebSocketApp::CborReader& reader) {
+    return SocketMessageCodec::DecodeCbor(*this, Fields(), reader);
 }
 
 //---------------------------------
 
-bool SocketImageDataMessage::SetImage(const std::string& imagePath) {
-    std::vector<char> buffer;
-    if (!WebSocketApp::ReadFile(imagePath, buffer)) {
-        return false;
-    }
+int SocketRequestMessage::_nextRequestId = 0;
 
-    QByteArray array(&(buffer[0]), buffer.size());
-    _imageData = array.toBase64().data();
+//---------------------------------
 
-    return true;
+const char* SocketCapabilityMessage::ENCODING_JSON = "json";
+const char* SocketCapabilityMessage::ENCODING_CBOR = "cbor";
+const char* SocketCapabilityMessage::CODEC_NONE = "none";
+const char* SocketCapabilityMessage::CODEC_GZIP = "gzip";
+const char* SocketCapabilityMessage::CODEC_DEFLATE_STREAM = "deflate-stream";
+const char* SocketCapabilityMessage::CODEC_LZ4 = "lz4";
+
+static const std::pair<WebSocketApp::CompressionCodec, const char*> CODEC_NAMES[] = {
+    { WebSocketApp::CompressionCodec::None, SocketCapabilityMessage::CODEC_NONE },
+    { WebSocketApp::CompressionCodec::GZip, SocketCapabilityMessage::CODEC_GZIP },
+    { WebSocketApp::CompressionCodec::DeflateStream, SocketCapabilityMessage::CODEC_DEFLATE_STREAM },
+    { WebSocketApp::CompressionCodec::Lz4, SocketCapabilityMessage::CODEC_LZ4 },
+};
+
+const char* SocketCapabilityMessage::CodecName(WebSocketApp::CompressionCodec codec) {
+    for (const auto& item : CODEC_NAMES) {
+        if (item.first == codec) {
+            return item.second;
+        }
+    }
+    return CODEC_NONE;
 }
 
-bool SocketImageDataMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
+SocketCapabilityMessage::SocketCapabilityMessage()
+    : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
+    , _frameVersion(WebSocketApp::SocketFrameHeader::VERSION)
+    , _encodings({ ENCODING_CBOR, ENCODING_JSON })
+    // LZ4 is picked per message type (SocketCompressionPolicy::SetCodec), deflate compresses better by default
+    , _codecs({ CODEC_DEFLATE_STREAM, CODEC_GZIP, CODEC_LZ4, CODEC_NONE })
+    , _compressionLevel(WebSocketApp::SocketConnectionOptions::COMPRESSION_LEVEL_DEFAULT)
+    , _maxFrameSize(WebSocketApp::SocketConnectionOptions::MAX_FRAME_SIZE_DEFAULT)
+    , _chunkSize(64 * 1024)
+    , _batchMaxMessages(256)
+    , _batchMaxBytes(64 * 1024)
+    , _batchDelay(500)
+{
+    for (uint32_t id : WebSocketApp::SocketDictionaryRegistry::Instance().Ids()) {
+        _dictionaries.push_back(WebSocketApp::SocketDictionary::FormatId(id));
     }
-
-    if (!GET_JSON_VALUE(_imageData, obj)) {
-        return false;
-    }
-    _bytes = QByteArray::fromBase64(QByteArray(_imageData.c_str(), _imageData.size()));
-
-    return true;
 }
 
-bool SocketImageDataMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+static const std::string* FindCommon(const std::vector<std::string>& preferred, const std::vector<std::string>& supported) {
+    for (const auto& name : preferred) {
+        if (std::find(supported.begin(), supported.end(), name) != supported.end()) {
+            return &name;
+        }
     }
-
-    SET_JSON_VALUE(_imageData, obj);
-    return true;
+    return nullptr;
 }
 
-//---------------------------------
-
-bool SocketFileMessage::SetFile(const std::string& dataPath, UnityDirectoryType directoryType /*= UnityDirectoryType::Invalid*/) {
-    std::vector<char> buffer;
-    if (!WebSocketApp::ReadFile(dataPath, buffer)) {
-        return false;
+// 0 is no limit, so it loses to any actual limit
+static int MinLimit(int a, int b) {
+    if (a <= 0) {
+        return qMax(b, 0);
+    } else if (b <= 0) {
+        return a;
     }
+    return qMin(a, b);
+}
 
-    QByteArray array(&(buffer[0]), buffer.size());
-    _data = array.toBase64().data();
+WebSocketApp::SocketConnectionOptions SocketCapabilityMessage::Negotiate(const SocketCapabilityMessage& remote) const {
+    WebSocketApp::SocketConnectionOptions options;
+    options.SetNegotiated(true);
 
-    _directoryType = directoryType;
-    _targetPath = dataPath;
+    // Frame versions are backward compatible, so the older one of both sides is used
+    options.SetBinaryFrame(remote.FrameVersion() >= WebSocketApp::SocketFrameHeader::VERSION_MIN);
+    if (options.IsBinaryFrame()) {
+        options.SetFrameVersion(static_cast<uint16_t>(qMin(_frameVersion, remote.FrameVersion())));
 
-    return true;
-}
-
-bool SocketFileMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
+        const std::string* encoding = FindCommon(_encodings, remote.Encodings());
+        if (encoding != nullptr && *encoding == ENCODING_CBOR) {
+            options.SetEncoding(WebSocketApp::PayloadEncoding::Cbor);
+        }
     }
 
-    if (!GET_JSON_VALUE(_requestId, obj)) {
-        return false;
-    }
-    if (!GET_JSON_INT_VALUE(UnityDirectoryType, _directoryType, obj)) {
-        return false;
+    // Context takeover payloads can only be marked in binary frames
+    std::vector<std::string> codecs = _codecs;
+    if (!options.IsBinaryFrame()) {
+        codecs.erase(std::remove(codecs.begin(), codecs.end(), CODEC_DEFLATE_STREAM), codecs.end());
     }
-    if (!GET_JSON_VALUE(_targetPath, obj)) {
-        return false;
+    const std::string* codec = FindCommon(codecs, remote.Codecs());
+    options.SetCodec(WebSocketApp::CompressionCodec::None);
+    options.SetSupportedCodec(WebSocketApp::CompressionCodec::GZip, false);
+    for (const auto& item : CODEC_NAMES) {
+        if (codec != nullptr && *codec == item.second) {
+            options.SetCodec(item.first);
+        }
+        bool supported = std::find(codecs.begin(), codecs.end(), item.second) != codecs.end()
+            && std::find(remote.Codecs().begin(), remote.Codecs().end(), item.second) != remote.Codecs().end();
+        options.SetSupportedCodec(item.first, supported);
     }
+    options.SetCompressionLevel(qBound(1, MinLimit(_compressionLevel, remote.CompressionLevel()), 9));
 
-    if (!GET_JSON_VALUE(_data, obj)) {
-        return false;
+    uint32_t dictionaryId = 0;
+    const std::string* dictionary = FindCommon(_dictionaries, remote.Dictionaries());
+    if (dictionary != nullptr && WebSocketApp::SocketDictionary::ParseId(*dictionary, dictionaryId)) {
+        options.SetDictionary(WebSocketApp::SocketDictionaryRegistry::Instance().Find(dictionaryId));
     }
-    _bytes = QByteArray::fromBase64(QByteArray(_data.c_str(), _data.size()));
 
-    return true;
-}
+    // Our frames have to fit the limits of the remote side
+    options.SetMaxFrameSize(qMax(remote.MaxFrameSize(), 0));
+    options.SetChunkSize(MinLimit(_chunkSize, remote.ChunkSize()));
 
-bool SocketFileMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
+    // Batching needs both sides, so here 0 disables it
+    options.SetBatchLimits(qMin(_batchMaxMessages, remote.BatchMaxMessages()), qMin(_batchMaxBytes, remote.BatchMaxBytes()), qMin(_batchDelay, remote.BatchDelay()));
+    if (options.BatchMaxMessages() <= 0 || options.BatchMaxBytes() <= 0) {
+        options.SetBatchLimits(0, 0, 0);
     }
 
-    SET_JSON_VALUE(_requestId, obj);
-    SET_JSON_INT_VALUE(_directoryType, obj);
-    SET_JSON_VALUE(_targetPath, obj);
-    SET_JSON_VALUE(_data, obj);
-    return true;
+    return options;
 }
 
 //---------------------------------
 
-bool SocketScreenShotMessage::FromJson(QJsonObject& obj) {
-    if (!SocketImageDataMessage::FromJson(obj)) {
-        return false;;
-    }
-
-    if (!GET_JSON_VALUE(_requestId, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_dateTime, obj)) {
-        return false;
-    }
-
-    return true;
+bool SocketImageDataMessage::SetImage(const std::string& imagePath) {
+    return _imageData.SetFile(imagePath);
 }
 
 //---------------------------------
 
-bool SocketMoveGameObjectMessage::FromJson(QJsonObject& obj) {
-    if (!SocketMessageBase::FromJson(obj)) {
-        return false;;
-    }
-
-    if (!GET_JSON_VALUE(_manipulateTarget, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_x, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_y, obj)) {
-        return false;
-    }
-    if (!GET_JSON_VALUE(_z, obj)) {
+bool SocketFileMessage::SetFile(const std::string& dataPath, UnityDirectoryType directoryType /*= UnityDirectoryType::Invalid*/) {
+    if (!_data.SetFile(dataPath)) {
         return false;
     }
 
-    return true;
-}
-
-bool SocketMoveGameObjectMessage::ToJson(QJsonObject& obj) const {
-    if (!SocketMessageBase::ToJson(obj)) {
-        return false;;
-    }
+    _directoryType = directoryType;
+    _targetPath = dataPath;
 
-    SET_JSON_VALUE(_manipulateTarget, obj);
-    SET_JSON_VALUE(_x, obj);
-    SET_JSON_VALUE(_y, obj);
-    SET_JSON_VALUE(_z, obj);
     return true;
 }
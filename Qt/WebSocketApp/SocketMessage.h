@@ -2,16 +2,11 @@
 #define SOCKETMESSAGE_H
 
 #include "WebSocketApp.h"
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-
-#define JSON_ARG(var) #var, (var)
-#define GET_JSON_VALUE(var, obj) GetJsonValue(JSON_ARG(var), obj)
-#define GET_JSON_INT_VALUE(type, var, obj) GetJsonIntValue<type>(JSON_ARG(var), obj)
-
-#define SET_JSON_VALUE(var, obj) SetJsonValue(JSON_ARG(var), obj)
-#define SET_JSON_INT_VALUE(var, obj) SetJsonValue(#var, (int)(var), obj)
+#include "SocketFrame.h"
+#include "SocketClock.h"
+#include "SocketMessageRegistry.h"
+#include "SocketMessageCodec.h"
+#include "SocketPathList.h"
 
 enum class UnityDirectoryType : int
 {
@@ -28,8 +23,10 @@ enum class UnityDirectoryType : int
 class SocketMessageBase
 {
 public:
-    SocketMessageBase(const char* messageType)
+    SocketMessageBase(const char* messageType, uint32_t typeId)
         : _messageType(messageType)
+        , _typeId(typeId)
+        , _timestamp(WebSocketApp::MonotonicTime())
     {
     }
 
@@ -40,98 +37,84 @@ public:
         return _messageType;
     }
 
-    static SocketMessageBase* ImportMessage(const QString& val);
-    bool ExportMessage(QString& message) const;
-
-protected:
-    std::string _messageType;
-
-    virtual bool FromJson(QJsonObject& obj);
-    virtual bool ToJson(QJsonObject& obj) const;
-
-    bool GetJsonValue(const char* key, bool& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isBool()) {
-            return false;
-        }
-        value = json.toBool();
-        return true;;
+    uint32_t TypeId() const {
+        return _typeId;
     }
 
-    bool GetJsonValue(const char* key, float& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isDouble()) {
-            return false;
-        }
-        value = static_cast<float>(json.toDouble());
-        return true;;
+    virtual int RequestId() const {
+        return -1;
     }
 
-    bool GetJsonValue(const char* key, double& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isDouble()) {
-            return false;
-        }
-        value = json.toDouble();
-        return true;;
+    // MonotonicTime() of the sender when the message was created.
+    //   0 for received messages that carried none (text envelopes and version 1 frames).
+    int64_t Timestamp() const {
+        return _timestamp;
     }
 
-    bool GetJsonValue(const char* key, int& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isDouble()) {
-            return false;
-        }
-        value = json.toInt();
-        return true;;
+    void SetTimestamp(int64_t val) {
+        _timestamp = val;
     }
 
-    template<class T>
-    bool GetJsonIntValue(const char* key, T& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isDouble()) {
-            return false;
-        }
-        value = static_cast<T>(json.toInt());
-        return true;;
-    }
+    // The text envelope is ASCII, so it is handled as bytes from the socket onwards
+    static SocketMessageBase* ImportMessage(const QByteArray& val);
+    // A text envelope whose payload has already been decoded from base64 and decompressed
+    static SocketMessageBase* ImportMessage(const std::string& messageType, const QByteArray& payload);
+    bool ExportMessage(QByteArray& message, const WebSocketApp::SocketConnectionOptions& options = WebSocketApp::SocketConnectionOptions()) const;
 
-    bool GetJsonValue(const char* key, std::string& value, QJsonObject& obj) {
-        auto json = obj[key];
-        if (!json.isString()) {
-            return false;
-        }
-        value = json.toString().toUtf8().data();
-        return true;;
-    }
+    // NOTE: An attachment shares the memory of val; when val is a fromRawData() view it must outlive the returned message
+    static SocketMessageBase* ImportBinaryMessage(const QByteArray& val, WebSocketApp::SocketFrameHeader* header = nullptr);
+    bool ExportBinaryMessage(QByteArray& message, const WebSocketApp::SocketConnectionOptions& options = WebSocketApp::SocketConnectionOptions()) const;
 
-    void SetJsonValue(const char* key, bool value, QJsonObject& obj) const {
-        obj[key] = value;
-    }
-    void SetJsonValue(const char* key, float value, QJsonObject& obj) const {
-        obj[key] = static_cast<double>(value);
+    // Messages that are sent unchanged to many devices, worth keeping encoded in SocketMessageCache
+    virtual bool IsCacheable() const {
+        return false;
     }
-    void SetJsonValue(const char* key, double value, QJsonObject& obj) const {
-        obj[key] = value;
+    // Identifies the encoded form by the wire settings, the fields and the identity of the attachment.
+    //   Returns false when the message cannot be identified cheaply.
+    bool CacheKey(const WebSocketApp::SocketConnectionOptions& options, std::string& key) const;
+
+    // Raw bytes sent next to the payload instead of inside it
+    virtual const WebSocketApp::SocketAttachment* Attachment() const {
+        return nullptr;
     }
-    void SetJsonValue(const char* key, int value, QJsonObject& obj) const {
-        obj[key] = value;
+    virtual WebSocketApp::SocketAttachment* Attachment() {
+        return nullptr;
     }
-    void SetJsonValue(const char* key, int64_t value, QJsonObject& obj) const {
-        obj[key] = value;
+
+protected:
+    std::string _messageType;
+    uint32_t _typeId;
+    int64_t _timestamp;
+
+    typedef SocketMessageBase SelfType;
+    static constexpr auto Fields() {
+        return std::make_tuple(SOCKET_MESSAGE_HEADER_FIELD(_messageType));
     }
-    void SetJsonValue(const char* key, const std::string& value, QJsonObject& obj) const {
-        obj[key] = value.c_str();
+
+    // Writes the fields only, the caller opens and closes the object
+    virtual bool EncodeJson(WebSocketApp::JsonWriter& writer) const;
+    virtual bool DecodeJson(WebSocketApp::JsonReader& reader);
+    virtual bool EncodeCbor(WebSocketApp::CborWriter& writer) const;
+    virtual bool DecodeCbor(WebSocketApp::CborReader& reader);
+
+    // JSON key used to embed the attachment as base64 in the text envelope
+    virtual const char* AttachmentKey() const {
+        return nullptr;
     }
+
+    // compression is the codec the payload ended up compressed with, None if it was not
+    bool ExportPayload(QByteArray& payload, WebSocketApp::CompressionCodec& compression, bool embedAttachment, WebSocketApp::PayloadEncoding encoding, const WebSocketApp::SocketConnectionOptions& options) const;
+    static SocketMessageBase* ImportPayload(SocketMessageBase* message, const QByteArray& payload, WebSocketApp::PayloadEncoding encoding);
 }; // class SocketMessageBase
 
 //---------------------------------
 
 class SockeTextMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SockeTextMessage)
 
     SockeTextMessage(const std::string& text)
-        : SocketMessageBase(MESSAGE_TYPE)
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
         , _text(text)
     {
     }
@@ -139,17 +122,18 @@ public:
 private:
     std::string _text;
 
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SockeTextMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_text))
 }; // class SockeTextMessage
 
 //---------------------------------
 
 class SocketRequestMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketRequestMessage)
 
     SocketRequestMessage(const std::string& request)
-        : SocketMessageBase(MESSAGE_TYPE)
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
         , _request(request)
         , _requestId(_nextRequestId++)
     {
@@ -159,7 +143,7 @@ public:
         return _request;
     }
 
-    int RequestId() const {
+    int RequestId() const override {
         return _requestId;
     }
 
@@ -172,30 +156,32 @@ public:
     }
 
 protected:
-    SocketRequestMessage(const char* messageType, const std::string& request)
-        : SocketMessageBase(messageType)
+    SocketRequestMessage(const char* messageType, uint32_t typeId, const std::string& request)
+        : SocketMessageBase(messageType, typeId)
         , _request(request)
         , _requestId(_nextRequestId++)
     {
     }
 
-    bool ToJson(QJsonObject& obj) const override;
-
 private:
     static int _nextRequestId;
 
     std::string _request;
     int _requestId;
+
+    SOCKET_MESSAGE_FIELDS(SocketRequestMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_request),
+        SOCKET_MESSAGE_FIELD(_requestId))
 }; // class SocketRequestMessage
 
 //---------------------------------
 
 class SocketResponseMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketResponseMessage)
 
     SocketResponseMessage()
-        : SocketMessageBase(MESSAGE_TYPE)
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
         , _requestId(-1)
     {
     }
@@ -204,7 +190,7 @@ public:
         return _request;
     }
 
-    int RequestId() const {
+    int RequestId() const override {
         return _requestId;
     }
 
@@ -217,35 +203,36 @@ public:
     }
 
 protected:
-    SocketResponseMessage(const char* messageType, const std::string& request)
-        : SocketMessageBase(messageType)
+    SocketResponseMessage(const char* messageType, uint32_t typeId, const std::string& request)
+        : SocketMessageBase(messageType, typeId)
         , _request(request)
     {
     }
 
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
-
 private:
     std::string _request;
     int _requestId;
+
+    SOCKET_MESSAGE_FIELDS(SocketResponseMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_request),
+        SOCKET_MESSAGE_FIELD(_requestId))
 }; // class SocketResponseMessage
 
 //---------------------------------
 
 class SocketScreenShotRequestMessage : public SocketRequestMessage {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketScreenShotRequestMessage)
 
     SocketScreenShotRequestMessage(bool stop)
-        : SocketRequestMessage(MESSAGE_TYPE, MESSAGE_TYPE)
+        : SocketRequestMessage(MESSAGE_TYPE, TYPE_ID, MESSAGE_TYPE)
         , _stop(stop)
         , _interval(-1)
     {
     }
 
     SocketScreenShotRequestMessage(float interval)
-        : SocketRequestMessage(MESSAGE_TYPE, MESSAGE_TYPE)
+        : SocketRequestMessage(MESSAGE_TYPE, TYPE_ID, MESSAGE_TYPE)
         , _stop(false)
         , _interval(interval)
     {
@@ -255,19 +242,26 @@ private:
     bool _stop;
     float _interval;
 
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SocketScreenShotRequestMessage, SocketRequestMessage,
+        SOCKET_MESSAGE_FIELD(_stop),
+        SOCKET_MESSAGE_FIELD(_interval))
 }; // class SocketScreenShotRequestMessage
 
 //---------------------------------
 
 class SocketFileListRequestMessage : public SocketRequestMessage {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketFileListRequestMessage)
 
-    SocketFileListRequestMessage(UnityDirectoryType directoryType, const std::string& targetPath)
-        : SocketRequestMessage(MESSAGE_TYPE, MESSAGE_TYPE)
+    // Entries per SocketFileListMessage
+    static const int PAGE_SIZE_DEFAULT = 4096;
+
+    SocketFileListRequestMessage(UnityDirectoryType directoryType, const std::string& targetPath, const std::string& continuationToken = std::string())
+        : SocketRequestMessage(MESSAGE_TYPE, TYPE_ID, MESSAGE_TYPE)
         , _directoryType(directoryType)
         , _targetPath(targetPath)
+        , _pageSize(PAGE_SIZE_DEFAULT)
+        , _continuationToken(continuationToken)
     {
     }
 
@@ -279,6 +273,15 @@ public:
         return _targetPath;
     }
 
+    int PageSize() const {
+        return _pageSize;
+    }
+
+    // Empty for the first page, otherwise the token of the previous page
+    const std::string& ContinuationToken() const {
+        return _continuationToken;
+    }
+
     void SetDirectoryType(UnityDirectoryType val) {
         _directoryType = val;
     }
@@ -287,21 +290,35 @@ public:
         _targetPath = val;
     }
 
+    void SetPageSize(int val) {
+        _pageSize = val;
+    }
+
+    void SetContinuationToken(const std::string& val) {
+        _continuationToken = val;
+    }
+
 private:
     UnityDirectoryType _directoryType;
     std::string _targetPath;
-
-    bool ToJson(QJsonObject& obj) const override;
+    int _pageSize;
+    std::string _continuationToken;
+
+    SOCKET_MESSAGE_FIELDS(SocketFileListRequestMessage, SocketRequestMessage,
+        SOCKET_MESSAGE_FIELD(_directoryType),
+        SOCKET_MESSAGE_FIELD(_targetPath),
+        SOCKET_MESSAGE_FIELD(_pageSize),
+        SOCKET_MESSAGE_FIELD(_continuationToken))
 }; // class SocketFileListRequestMessage
 
 //---------------------------------
 
 class SocketFileUploadRequestMessage : public SocketRequestMessage {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketFileUploadRequestMessage)
 
     SocketFileUploadRequestMessage(UnityDirectoryType directoryType, const std::string& targetPath)
-        : SocketRequestMessage(MESSAGE_TYPE, MESSAGE_TYPE)
+        : SocketRequestMessage(MESSAGE_TYPE, TYPE_ID, MESSAGE_TYPE)
         , _directoryType(directoryType)
         , _targetPath(targetPath)
     {
@@ -327,17 +344,19 @@ private:
     UnityDirectoryType _directoryType;
     std::string _targetPath;
 
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SocketFileUploadRequestMessage, SocketRequestMessage,
+        SOCKET_MESSAGE_FIELD(_directoryType),
+        SOCKET_MESSAGE_FIELD(_targetPath))
 }; // class SocketFileUploadRequestMessage
 
 //---------------------------------
 
 class SocketConnectGameObjectRequestMessage : public SocketRequestMessage {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketConnectGameObjectRequestMessage)
 
     SocketConnectGameObjectRequestMessage(const std::string& gameObjectName)
-        : SocketRequestMessage(MESSAGE_TYPE, MESSAGE_TYPE)
+        : SocketRequestMessage(MESSAGE_TYPE, TYPE_ID, MESSAGE_TYPE)
         , _gameObjectName(gameObjectName)
     {
     }
@@ -353,14 +372,15 @@ public:
 private:
     std::string _gameObjectName;
 
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SocketConnectGameObjectRequestMessage, SocketRequestMessage,
+        SOCKET_MESSAGE_FIELD(_gameObjectName))
 }; // class SocketConnectGameObjectRequestMessage
 
 //---------------------------------
 
 class SocketLogMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketLogMessage)
 
     enum class LogType : int
     {
@@ -374,7 +394,7 @@ public:
     };
 
     SocketLogMessage()
-        : SocketMessageBase(MESSAGE_TYPE)
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
         , _logType(LogType::Invalid)
     {
     }
@@ -411,17 +431,32 @@ private:
     std::string _log;
     std::string _stackTrace;
 
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SocketLogMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_logType),
+        SOCKET_MESSAGE_FIELD(_time),
+        SOCKET_MESSAGE_FIELD(_log),
+        SOCKET_MESSAGE_FIELD(_stackTrace))
 }; // class SocketLogMessage
 
 //---------------------------------
 
 class SocketConnectionInformationMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketConnectionInformationMessage)
 
-    SocketConnectionInformationMessage() : SocketMessageBase(MESSAGE_TYPE) {
+    SocketConnectionInformationMessage()
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
+        , _requestId(-1)
+        , _frameVersion(0)
+    {
+    }
+
+    int RequestId() const override {
+        return _requestId;
+    }
+
+    bool IsCacheable() const override {
+        return true;
     }
 
     const std::string& ApplicationName() const {
@@ -436,6 +471,10 @@ public:
     const std::string& DeviceModel() const {
         return _deviceModel;
     }
+    // Newest binary frame version the device reads, 0 for builds that only know text frames
+    int FrameVersion() const {
+        return _frameVersion;
+    }
 
     void SetApplicationName(const std::string& val) {
         _applicationName = val;
@@ -449,6 +488,9 @@ public:
     void SetDeviceModel(const std::string& val) {
         _deviceModel = val;
     }
+    void SetFrameVersion(int val) {
+        _frameVersion = val;
+    }
 
 private:
     int _requestId;
@@ -456,55 +498,243 @@ private:
     std::string _uuid;
     std::string _deviceName;
     std::string _deviceModel;
-
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
+    int _frameVersion;
+
+    SOCKET_MESSAGE_FIELDS(SocketConnectionInformationMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_requestId),
+        SOCKET_MESSAGE_FIELD(_applicationName),
+        SOCKET_MESSAGE_FIELD(_uuid),
+        SOCKET_MESSAGE_FIELD(_deviceName),
+        SOCKET_MESSAGE_FIELD(_deviceModel),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_frameVersion))
 }; // class SocketConnectionInformationMessage
 
 //---------------------------------
 
+// Exchanged by both ends once the device has advertised a frame version in SocketConnectionInformationMessage.
+//   The lists are ordered by preference. Older devices never receive it and keep the default SocketConnectionOptions.
+class SocketCapabilityMessage : public SocketMessageBase {
+public:
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketCapabilityMessage)
+
+    static const char* ENCODING_JSON;
+    static const char* ENCODING_CBOR;
+    static const char* CODEC_NONE;
+    static const char* CODEC_GZIP;
+    static const char* CODEC_DEFLATE_STREAM;
+    static const char* CODEC_LZ4;
+
+    static const char* CodecName(WebSocketApp::CompressionCodec codec);
+
+    // Capabilities of this tool
+    SocketCapabilityMessage();
+
+    int FrameVersion() const {
+        return _frameVersion;
+    }
+    const std::vector<std::string>& Encodings() const {
+        return _encodings;
+    }
+    const std::vector<std::string>& Codecs() const {
+        return _codecs;
+    }
+    int CompressionLevel() const {
+        return _compressionLevel;
+    }
+    int MaxFrameSize() const {
+        return _maxFrameSize;
+    }
+    int ChunkSize() const {
+        return _chunkSize;
+    }
+    int BatchMaxMessages() const {
+        return _batchMaxMessages;
+    }
+    int BatchMaxBytes() const {
+        return _batchMaxBytes;
+    }
+    int BatchDelay() const {
+        return _batchDelay;
+    }
+    // Ids (SocketDictionary::FormatId) of the preset dictionaries, preferred first
+    const std::vector<std::string>& Dictionaries() const {
+        return _dictionaries;
+    }
+
+    // Picks the first of our preferences that remote also supports, and the tighter of both limits
+    WebSocketApp::SocketConnectionOptions Negotiate(const SocketCapabilityMessage& remote) const;
+
+private:
+    int _frameVersion;
+    std::vector<std::string> _encodings;
+    std::vector<std::string> _codecs;
+    int _compressionLevel;
+    int _maxFrameSize;
+    int _chunkSize;
+    int _batchMaxMessages;
+    int _batchMaxBytes;
+    int _batchDelay;
+    std::vector<std::string> _dictionaries;
+
+    SOCKET_MESSAGE_FIELDS(SocketCapabilityMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_frameVersion),
+        SOCKET_MESSAGE_FIELD(_encodings),
+        SOCKET_MESSAGE_FIELD(_codecs),
+        SOCKET_MESSAGE_FIELD(_compressionLevel),
+        SOCKET_MESSAGE_FIELD(_maxFrameSize),
+        SOCKET_MESSAGE_FIELD(_chunkSize),
+        SOCKET_MESSAGE_FIELD(_batchMaxMessages),
+        SOCKET_MESSAGE_FIELD(_batchMaxBytes),
+        SOCKET_MESSAGE_FIELD(_batchDelay),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_dictionaries))
+}; // class SocketCapabilityMessage
+
+//---------------------------------
+
+// NTP style clock exchange: sent with OriginateTime set, the remote side fills in the rest and sends it back.
+//   All times are MonotonicTime() values of the side that took them.
+class SocketClockSyncMessage : public SocketMessageBase {
+public:
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketClockSyncMessage)
+
+    SocketClockSyncMessage()
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
+        , _originateTime(Timestamp())
+        , _receiveTime(0)
+        , _transmitTime(0)
+    {
+    }
+
+    int64_t OriginateTime() const {
+        return _originateTime;
+    }
+    int64_t ReceiveTime() const {
+        return _receiveTime;
+    }
+    int64_t TransmitTime() const {
+        return _transmitTime;
+    }
+
+    bool IsReply() const {
+        return _transmitTime != 0;
+    }
+
+    void SetOriginateTime(int64_t val) {
+        _originateTime = val;
+    }
+    void SetReceiveTime(int64_t val) {
+        _receiveTime = val;
+    }
+    void SetTransmitTime(int64_t val) {
+        _transmitTime = val;
+    }
+
+private:
+    int64_t _originateTime;
+    int64_t _receiveTime;
+    int64_t _transmitTime;
+
+    SOCKET_MESSAGE_FIELDS(SocketClockSyncMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_originateTime),
+        SOCKET_MESSAGE_FIELD(_receiveTime),
+        SOCKET_MESSAGE_FIELD(_transmitTime))
+}; // class SocketClockSyncMessage
+
+//---------------------------------
+
 class SocketFileListMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketFileListMessage)
+
+    SocketFileListMessage()
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
+        , _requestId(-1)
+    {
+    }
 
-    SocketFileListMessage() : SocketMessageBase(MESSAGE_TYPE) {
+    int RequestId() const override {
+        return _requestId;
     }
 
     const std::string& Directory() const {
         return _directory;
     }
 
-    const std::vector<std::string>& Files() const {
-        return _files;
+    // Devices that page their listings send front coded entries, older ones full paths
+    const WebSocketApp::SocketPathList& Files() const {
+        return _files.IsEmpty() ? _frontCodedFiles : _files;
+    }
+
+    const WebSocketApp::SocketPathList& Directories() const {
+        return _directories.IsEmpty() ? _frontCodedDirectories : _directories;
+    }
+
+    // Request it with SocketFileListRequestMessage to get the next page, empty on the last page
+    const std::string& ContinuationToken() const {
+        return _continuationToken;
+    }
+
+    bool HasNextPage() const {
+        return !_continuationToken.empty();
+    }
+
+    void SetRequestId(int val) {
+        _requestId = val;
+    }
+
+    void SetDirectory(const std::string& val) {
+        _directory = val;
+    }
+
+    WebSocketApp::SocketFrontCodedPathList& FrontCodedFiles() {
+        return _frontCodedFiles;
+    }
+
+    WebSocketApp::SocketFrontCodedPathList& FrontCodedDirectories() {
+        return _frontCodedDirectories;
     }
 
-    const std::vector<std::string>& Directories() const {
-        return _directories;
+    void SetContinuationToken(const std::string& val) {
+        _continuationToken = val;
     }
 
 private:
     int _requestId;
     std::string _directory;
-    std::vector<std::string> _files;
-    std::vector<std::string> _directories;
-
-    bool FromJson(QJsonObject& obj) override;
-    bool ImportFiles(QJsonObject& obj);
-    bool ImportDirectories(QJsonObject& obj);
+    WebSocketApp::SocketPathList _files;
+    WebSocketApp::SocketPathList _directories;
+    WebSocketApp::SocketFrontCodedPathList _frontCodedFiles;
+    WebSocketApp::SocketFrontCodedPathList _frontCodedDirectories;
+    std::string _continuationToken;
+
+    SOCKET_MESSAGE_FIELDS(SocketFileListMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_requestId),
+        SOCKET_MESSAGE_FIELD(_directory),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_files),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_directories),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_frontCodedFiles),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_frontCodedDirectories),
+        SOCKET_MESSAGE_OPTIONAL_FIELD(_continuationToken))
 }; // class SocketFileListMessage
 
 //---------------------------------
 
 class SocketFileMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketFileMessage)
 
-    SocketFileMessage() : SocketMessageBase(MESSAGE_TYPE) {
+    SocketFileMessage()
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
+        , _requestId(-1)
+    {
     }
-    SocketFileMessage(const char* messageType) : SocketMessageBase(messageType) {
+    SocketFileMessage(const char* messageType, uint32_t typeId)
+        : SocketMessageBase(messageType, typeId)
+        , _requestId(-1)
+    {
     }
 
-    int RequestId() const {
+    int RequestId() const override {
         return _requestId;
     }
 
@@ -516,8 +746,12 @@ public:
         return _targetPath;
     }
 
+    // Decoded on first access
     const QByteArray& Bytes() const {
-        return _bytes;
+        return _data.Bytes();
+    }
+    const WebSocketApp::SocketAttachment& Data() const {
+        return _data;
     }
 
     void SetDirectoryType(UnityDirectoryType val) {
@@ -530,9 +764,21 @@ public:
 
     bool SetFile(const std::string& dataPath, UnityDirectoryType directoryType = UnityDirectoryType::Invalid);
 
+    bool IsCacheable() const override {
+        return true;
+    }
+
+    const WebSocketApp::SocketAttachment* Attachment() const override {
+        return &_data;
+    }
+    WebSocketApp::SocketAttachment* Attachment() override {
+        return &_data;
+    }
+
 protected:
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
+    const char* AttachmentKey() const override {
+        return "_data";
+    }
 
 private:
     int _requestId;
@@ -540,43 +786,66 @@ private:
     UnityDirectoryType _directoryType;
     std::string _targetPath;
 
-    std::string _data;
-    QByteArray _bytes;
+    WebSocketApp::SocketAttachment _data;
+
+    SOCKET_MESSAGE_FIELDS(SocketFileMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_requestId),
+        SOCKET_MESSAGE_FIELD(_directoryType),
+        SOCKET_MESSAGE_FIELD(_targetPath))
 }; // class SocketFileMessage
 
 //---------------------------------
 
 class SocketImageDataMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketImageDataMessage)
 
-    SocketImageDataMessage() : SocketMessageBase(MESSAGE_TYPE) {
+    SocketImageDataMessage() : SocketMessageBase(MESSAGE_TYPE, TYPE_ID) {
     }
-    SocketImageDataMessage(const char* messageType) : SocketMessageBase(messageType) {
+    SocketImageDataMessage(const char* messageType, uint32_t typeId) : SocketMessageBase(messageType, typeId) {
     }
 
+    // Decoded on first access
     const QByteArray& Bytes() const {
-        return _bytes;
+        return _imageData.Bytes();
     }
 
     bool SetImage(const std::string& imagePath);
 
+    bool IsCacheable() const override {
+        return true;
+    }
+
+    const WebSocketApp::SocketAttachment* Attachment() const override {
+        return &_imageData;
+    }
+    WebSocketApp::SocketAttachment* Attachment() override {
+        return &_imageData;
+    }
+
 protected:
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
+    const char* AttachmentKey() const override {
+        return "_imageData";
+    }
 
 private:
-    std::string _imageData;
-    QByteArray _bytes;
+    WebSocketApp::SocketAttachment _imageData;
 }; // class SocketImageDataMessage
 
 //---------------------------------
 
 class SocketScreenShotMessage : public SocketImageDataMessage {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketScreenShotMessage)
+
+    SocketScreenShotMessage()
+        : SocketImageDataMessage(MESSAGE_TYPE, TYPE_ID)
+        , _requestId(-1)
+    {
+    }
 
-    SocketScreenShotMessage() : SocketImageDataMessage(MESSAGE_TYPE) {
+    int RequestId() const override {
+        return _requestId;
     }
 
     const std::string& DateTime() const {
@@ -591,17 +860,19 @@ private:
     int _requestId;
     std::string _dateTime;
 
-    bool FromJson(QJsonObject& obj) override;
+    SOCKET_MESSAGE_FIELDS(SocketScreenShotMessage, SocketImageDataMessage,
+        SOCKET_MESSAGE_FIELD(_requestId),
+        SOCKET_MESSAGE_FIELD(_dateTime))
 }; // class SocketScreenShotMessage
 
 //---------------------------------
 
 class SocketMoveGameObjectMessage : public SocketMessageBase {
 public:
-    static const char* MESSAGE_TYPE;
+    DECLARE_SOCKET_MESSAGE_TYPE(SocketMoveGameObjectMessage)
 
     SocketMoveGameObjectMessage(int manipulateTarget, float x = 0, float y = 0, float z = 0)
-        : SocketMessageBase(MESSAGE_TYPE)
+        : SocketMessageBase(MESSAGE_TYPE, TYPE_ID)
         , _manipulateTarget(manipulateTarget)
         , _x(x)
         , _y(y)
@@ -615,8 +886,11 @@ private:
     float _y;
     float _z;
 
-    bool FromJson(QJsonObject& obj) override;
-    bool ToJson(QJsonObject& obj) const override;
+    SOCKET_MESSAGE_FIELDS(SocketMoveGameObjectMessage, SocketMessageBase,
+        SOCKET_MESSAGE_FIELD(_manipulateTarget),
+        SOCKET_MESSAGE_FIELD(_x),
+        SOCKET_MESSAGE_FIELD(_y),
+        SOCKET_MESSAGE_FIELD(_z))
 }; // class SocketMoveGameObjectMessage
 
 #endif // SOCKETMESSAGE_H
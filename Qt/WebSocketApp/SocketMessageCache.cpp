@@ -0,0 +1,59 @@
+﻿#include "SocketMessageCache.h"
+
+namespace WebSocketApp {
+
+SocketMessageCache& SocketMessageCache::Instance() {
+    static SocketMessageCache instance;
+    return instance;
+}
+
+void SocketMessageCache::SetCapacity(int64_t val) {
+    _capacity = val;
+    Evict();
+}
+
+void SocketMessageCache::Clear() {
+    _index.clear();
+    _entries.clear();
+    _size = 0;
+}
+
+bool SocketMessageCache::Find(const std::string& key, QByteArray& encoded) {
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return false;
+    }
+
+    _entries.splice(_entries.begin(), _entries, it->second);
+    encoded = it->second->second;
+    return true;
+}
+
+void SocketMessageCache::Insert(const std::string& key, const QByteArray& encoded) {
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _size -= EntrySize(*it->second);
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+
+    int64_t size = static_cast<int64_t>(key.size()) + encoded.length();
+    if (size > _capacity) {
+        return;
+    }
+
+    _entries.emplace_front(key, encoded);
+    _index[key] = _entries.begin();
+    _size += size;
+    Evict();
+}
+
+void SocketMessageCache::Evict() {
+    while (_size > _capacity && !_entries.empty()) {
+        _size -= EntrySize(_entries.back());
+        _index.erase(_entries.back().first);
+        _entries.pop_back();
+    }
+}
+
+} // namespace WebSocketApp
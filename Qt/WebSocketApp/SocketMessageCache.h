@@ -0,0 +1,62 @@
+﻿#ifndef SOCKETMESSAGECACHE_H
+#define SOCKETMESSAGECACHE_H
+
+#include "WebSocketApp.h"
+#include <QByteArray>
+#include <list>
+#include <unordered_map>
+
+namespace WebSocketApp {
+
+// Finished frames (or text envelopes) of outbound messages, shared by all connections,
+//   so that a message sent to several devices is encoded once. See SocketMessageBase::CacheKey().
+//   The least recently used entries are dropped once the byte budget is exceeded,
+//   and an entry larger than the whole budget is not kept at all.
+class SocketMessageCache {
+public:
+    // Room for a large file upload sent to several devices in turn; set with --message-cache (MB) otherwise
+    static const int64_t CAPACITY_DEFAULT = 512LL * 1024 * 1024;
+
+    static SocketMessageCache& Instance();
+
+    explicit SocketMessageCache(int64_t capacity = CAPACITY_DEFAULT)
+        : _capacity(capacity)
+        , _size(0)
+    {
+    }
+
+    int64_t Capacity() const {
+        return _capacity;
+    }
+    int64_t Size() const {
+        return _size;
+    }
+    int Count() const {
+        return static_cast<int>(_index.size());
+    }
+
+    void SetCapacity(int64_t val);
+    void Clear();
+
+    // The bytes are shared with the cache, not copied
+    bool Find(const std::string& key, QByteArray& encoded);
+    void Insert(const std::string& key, const QByteArray& encoded);
+
+private:
+    typedef std::list<std::pair<std::string, QByteArray>> EntryList;
+
+    // Most recently used first
+    EntryList _entries;
+    std::unordered_map<std::string, EntryList::iterator> _index;
+    int64_t _capacity;
+    int64_t _size;
+
+    static int64_t EntrySize(const EntryList::value_type& entry) {
+        return static_cast<int64_t>(entry.first.size()) + entry.second.length();
+    }
+    void Evict();
+}; // class SocketMessageCache
+
+} // namespace WebSocketApp
+
+#endif // SOCKETMESSAGECACHE_H
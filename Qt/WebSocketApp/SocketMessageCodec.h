@@ -0,0 +1,235 @@
+﻿#ifndef SOCKETMESSAGECODEC_H
+#define SOCKETMESSAGECODEC_H
+
+#include "SocketJson.h"
+#include "SocketCbor.h"
+#include "SocketAttachment.h"
+#include <tuple>
+#include <utility>
+
+// Declares a serialized member inside SOCKET_MESSAGE_FIELDS()
+#define SOCKET_MESSAGE_FIELD(var) SocketMessageCodec::MakeField(#var, &SelfType::var)
+// Declares a member that binary frames already carry in their header (JSON only)
+#define SOCKET_MESSAGE_HEADER_FIELD(var) SocketMessageCodec::MakeField(#var, &SelfType::var, true)
+// Declares a member that may be missing from a received message (it keeps its default value)
+#define SOCKET_MESSAGE_OPTIONAL_FIELD(var) SocketMessageCodec::MakeField(#var, &SelfType::var, false, true)
+
+// Declares the serialized members of a message class once and generates its codec from them.
+//   The field list of the base class comes first, so a message is decoded in a single pass.
+//   The position in the list is the CBOR key: only append new fields at the end.
+#define SOCKET_MESSAGE_FIELDS(type, base, ...) \
+protected: \
+    typedef type SelfType; \
+    static constexpr auto Fields() { \
+        return std::tuple_cat(base::Fields(), std::make_tuple(__VA_ARGS__)); \
+    } \
+    bool EncodeJson(WebSocketApp::JsonWriter& writer) const override { \
+        return SocketMessageCodec::EncodeJson(*this, Fields(), writer); \
+    } \
+    bool DecodeJson(WebSocketApp::JsonReader& reader) override { \
+        return SocketMessageCodec::DecodeJson(*this, Fields(), AttachmentKey(), reader); \
+    } \
+    bool EncodeCbor(WebSocketApp::CborWriter& writer) const override { \
+        return SocketMessageCodec::EncodeCbor(*this, Fields(), writer); \
+    } \
+    bool DecodeCbor(WebSocketApp::CborReader& reader) override { \
+        return SocketMessageCodec::DecodeCbor(*this, Fields(), reader); \
+    } \
+private:
+
+namespace SocketMessageCodec {
+
+// CBOR key of the attachment, outside the range of field indices
+const int ATTACHMENT_CBOR_KEY = -1;
+
+template<class C, class T>
+struct Field {
+    const char* name;
+    int length;
+    T C::*member;
+    bool header;
+    bool optional;
+};
+
+template<class C, class T, int N>
+constexpr Field<C, T> MakeField(const char (&name)[N], T C::*member, bool header = false, bool optional = false) {
+    return Field<C, T>{ name, N - 1, member, header, optional };
+}
+
+// Member types the readers and writers do not know overload these in their own namespace
+template<class T>
+void WriteField(WebSocketApp::JsonWriter& writer, const char* key, int keyLength, const T& value) {
+    writer.Write(key, keyLength, value);
+}
+
+template<class T>
+void WriteField(WebSocketApp::CborWriter& writer, int key, const T& value) {
+    writer.Write(key, value);
+}
+
+template<class Reader, class T>
+bool ReadField(Reader& reader, T& value) {
+    return reader.Read(value);
+}
+
+template<class Message, class Fields>
+bool EncodeJson(const Message& message, const Fields& fields, WebSocketApp::JsonWriter& writer) {
+    std::apply([&](const auto&... field) {
+        (WriteField(writer, field.name, field.length, message.*(field.member)), ...);
+    }, fields);
+    return true;
+}
+
+template<class Fields, size_t... I>
+constexpr uint64_t JsonRequiredMask(const Fields& fields, std::index_sequence<I...>) {
+    return ((std::get<I>(fields).optional ? uint64_t(0) : uint64_t(1) << I) | ... | uint64_t(0));
+}
+
+template<class Message, class Fields, size_t... I>
+bool DecodeField(Message& message, const Fields& fields, const char* key, int keyLength, WebSocketApp::JsonReader& reader, uint64_t& found, std::index_sequence<I...>) {
+    bool matched = false;
+    bool result = true;
+    auto decode = [&](const auto& field, uint64_t bit) {
+        if (matched || field.length != keyLength || memcmp(field.name, key, keyLength) != 0) {
+            return;
+        }
+        matched = true;
+        found |= bit;
+        result = ReadField(reader, message.*(field.member));
+    };
+    (decode(std::get<I>(fields), uint64_t(1) << I), ...);
+
+    if (!matched) {
+        return reader.SkipValue();
+    }
+    return result;
+}
+
+template<class Message, class Fields>
+bool DecodeJson(Message& message, const Fields& fields, const char* attachmentKey, WebSocketApp::JsonReader& reader) {
+    constexpr size_t count = std::tuple_size<Fields>::value;
+    static_assert(count <= 64, "too many fields");
+    const uint64_t required = JsonRequiredMask(fields, std::make_index_sequence<count>());
+
+    if (!reader.BeginObject()) {
+        return false;
+    }
+
+    uint64_t found = 0;
+    const char* key = nullptr;
+    int keyLength = 0;
+    while (reader.NextKey(key, keyLength)) {
+        if (attachmentKey != nullptr && (int)strlen(attachmentKey) == keyLength && memcmp(attachmentKey, key, keyLength) == 0) {
+            // Attachment embedded as base64 by the text envelope, decoded when it is first used
+            const char* str = nullptr;
+            int length = 0;
+            std::string scratch;
+            if (!reader.ReadStringView(str, length, scratch)) {
+                return false;
+            }
+
+            auto* attachment = message.Attachment();
+            if (attachment == nullptr) {
+                continue;
+            }
+            const QByteArray* source = reader.Source();
+            if (source != nullptr && str >= source->constData() && str < source->constData() + source->length()) {
+                attachment->SetEncoded(*source, static_cast<int>(str - source->constData()), length, WebSocketApp::SocketAttachment::Encoding::Base64);
+            } else {
+                attachment->SetEncoded(QByteArray(str, length), 0, length, WebSocketApp::SocketAttachment::Encoding::Base64);
+            }
+            continue;
+        }
+
+        if (!DecodeField(message, fields, key, keyLength, reader, found, std::make_index_sequence<count>())) {
+            return false;
+        }
+    }
+    if (reader.HasError()) {
+        return false;
+    }
+
+    return (found & required) == required;
+}
+
+//---------------------------------
+
+template<class Message, class Fields, size_t... I>
+bool EncodeCborFields(const Message& message, const Fields& fields, WebSocketApp::CborWriter& writer, std::index_sequence<I...>) {
+    auto encode = [&](const auto& field, int key) {
+        if (!field.header) {
+            WriteField(writer, key, message.*(field.member));
+        }
+    };
+    (encode(std::get<I>(fields), static_cast<int>(I)), ...);
+    return true;
+}
+
+template<class Message, class Fields>
+bool EncodeCbor(const Message& message, const Fields& fields, WebSocketApp::CborWriter& writer) {
+    return EncodeCborFields(message, fields, writer, std::make_index_sequence<std::tuple_size<Fields>::value>());
+}
+
+template<class Fields, size_t... I>
+constexpr uint64_t CborRequiredMask(const Fields& fields, std::index_sequence<I...>) {
+    return ((std::get<I>(fields).header || std::get<I>(fields).optional ? uint64_t(0) : uint64_t(1) << I) | ... | uint64_t(0));
+}
+
+template<class Message, class Fields, size_t... I>
+bool DecodeCborField(Message& message, const Fields& fields, int key, WebSocketApp::CborReader& reader, uint64_t& found, std::index_sequence<I...>) {
+    bool matched = false;
+    bool result = true;
+    auto decode = [&](const auto& field, int index) {
+        if (matched || key != index || field.header) {
+            return;
+        }
+        matched = true;
+        found |= uint64_t(1) << index;
+        result = ReadField(reader, message.*(field.member));
+    };
+    (decode(std::get<I>(fields), static_cast<int>(I)), ...);
+
+    if (!matched) {
+        return reader.SkipValue();
+    }
+    return result;
+}
+
+template<class Message, class Fields>
+bool DecodeCbor(Message& message, const Fields& fields, WebSocketApp::CborReader& reader) {
+    constexpr size_t count = std::tuple_size<Fields>::value;
+    static_assert(count <= 64, "too many fields");
+    const uint64_t required = CborRequiredMask(fields, std::make_index_sequence<count>());
+
+    if (!reader.BeginMap()) {
+        return false;
+    }
+
+    uint64_t found = 0;
+    int key = 0;
+    while (reader.NextKey(key)) {
+        if (key == ATTACHMENT_CBOR_KEY) {
+            QByteArray bytes;
+            if (!reader.ReadBytes(bytes)) {
+                return false;
+            }
+            if (message.Attachment() != nullptr) {
+                message.Attachment()->SetBytes(bytes);
+            }
+            continue;
+        }
+
+        if (!DecodeCborField(message, fields, key, reader, found, std::make_index_sequence<count>())) {
+            return false;
+        }
+    }
+    if (reader.HasError()) {
+        return false;
+    }
+
+    return (found & required) == required;
+}
+
+} // namespace SocketMessageCodec
+
+#endif // SOCKETMESSAGECODEC_H
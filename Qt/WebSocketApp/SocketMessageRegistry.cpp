@@ -0,0 +1,25 @@
+﻿#include "SocketMessageRegistry.h"
+
+SocketMessageRegistry& SocketMessageRegistry::Instance() {
+    static SocketMessageRegistry instance;
+    return instance;
+}
+
+void SocketMessageRegistry::Register(uint32_t typeId, const char* messageType, Factory factory) {
+    auto it = _entries.find(typeId);
+    if (it != _entries.end()) {
+        OUTPUT_ERROR_LOG("メッセージタイプのIDが重複：%s, %s", it->second.messageType, messageType);
+        return;
+    }
+
+    Entry entry = { messageType, factory };
+    _entries[typeId] = entry;
+}
+
+SocketMessageBase* SocketMessageRegistry::Create(uint32_t typeId) const {
+    auto it = _entries.find(typeId);
+    if (it == _entries.end()) {
+        return nullptr;
+    }
+    return it->second.factory();
+}
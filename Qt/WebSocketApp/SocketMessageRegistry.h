@@ -0,0 +1,85 @@
+﻿#ifndef SOCKETMESSAGEREGISTRY_H
+#define SOCKETMESSAGEREGISTRY_H
+
+#include "SocketFrame.h"
+#include <unordered_map>
+
+class SocketMessageBase;
+
+#define DECLARE_SOCKET_MESSAGE_TYPE(type) \
+    static constexpr const char* MESSAGE_TYPE = #type; \
+    static constexpr uint32_t TYPE_ID = WebSocketApp::HashMessageType(#type);
+
+#define DEFINE_SOCKET_MESSAGE_TYPE(type) \
+    constexpr const char* type::MESSAGE_TYPE; \
+    constexpr uint32_t type::TYPE_ID;
+
+#define REGISTER_SOCKET_MESSAGE(type) \
+    static const SocketMessageRegistry::Registrar<type> type##Registrar;
+
+//---------------------------------
+
+// Factory table of the messages which can be received, keyed by TYPE_ID
+class SocketMessageRegistry {
+public:
+    typedef SocketMessageBase* (*Factory)();
+
+    template<class T>
+    class Registrar {
+    public:
+        Registrar() {
+            SocketMessageRegistry::Instance().Register(T::TYPE_ID, T::MESSAGE_TYPE, &Registrar::Create);
+        }
+
+    private:
+        static SocketMessageBase* Create() {
+            return new T();
+        }
+    }; // class Registrar
+
+    static SocketMessageRegistry& Instance();
+
+    void Register(uint32_t typeId, const char* messageType, Factory factory);
+    SocketMessageBase* Create(uint32_t typeId) const;
+
+private:
+    struct Entry {
+        const char* messageType;
+        Factory factory;
+    };
+
+    std::unordered_map<uint32_t, Entry> _entries;
+}; // class SocketMessageRegistry
+
+//---------------------------------
+
+// Handler table of a message receiver, keyed by TYPE_ID
+//   The receiver must provide bool AcceptMessage(T*) for every registered T.
+template<class Receiver>
+class SocketMessageDispatcher {
+public:
+    typedef bool (*Handler)(Receiver& receiver, SocketMessageBase* message);
+
+    template<class T>
+    SocketMessageDispatcher& Register() {
+        _handlers[T::TYPE_ID] = &SocketMessageDispatcher::Invoke<T>;
+        return *this;
+    }
+
+    // Returns nullptr when there is no handler for the type
+    Handler Find(uint32_t typeId) const {
+        auto it = _handlers.find(typeId);
+        return (it == _handlers.end() ? nullptr : it->second);
+    }
+
+private:
+    std::unordered_map<uint32_t, Handler> _handlers;
+
+    template<class T>
+    static bool Invoke(Receiver& receiver, SocketMessageBase* message) {
+        // The type id already identifies the class, so no dynamic_cast is needed
+        return receiver.AcceptMessage(static_cast<T*>(message));
+    }
+}; // class SocketMessageDispatcher
+
+#endif // SOCKETMESSAGEREGISTRY_H
@@ -0,0 +1,187 @@
+﻿#include "SocketPathList.h"
+
+#include <algorithm>
+#include <string>
+
+namespace WebSocketApp {
+
+void SocketPathList::Reserve(int count, int poolSize) {
+    _offsets.reserve(static_cast<size_t>(count) + 1);
+    _pool.reserve(static_cast<size_t>(poolSize));
+}
+
+void SocketPathList::Clear() {
+    _pool.clear();
+    _offsets.resize(1);
+}
+
+void SocketPathList::Append(const char* path, int length) {
+    _pool.insert(_pool.end(), path, path + length);
+    _offsets.push_back(static_cast<int>(_pool.size()));
+}
+
+void SocketPathList::Append(const SocketPathList& other) {
+    int base = PoolSize();
+    _pool.insert(_pool.end(), other._pool.begin(), other._pool.end());
+    _offsets.reserve(_offsets.size() + other.Count());
+    for (int i = 1, count = static_cast<int>(other._offsets.size()); i < count; ++i) {
+        _offsets.push_back(base + other._offsets[i]);
+    }
+}
+
+bool SocketPathList::AppendFrontCoded(int prefixLength, const char* suffix, int suffixLength) {
+    int last = _offsets.back();
+    int previous = IsEmpty() ? last : _offsets[_offsets.size() - 2];
+    if (prefixLength < 0 || prefixLength > last - previous) {
+        return false;
+    }
+
+    // The prefix is copied out of the pool itself, so make room first
+    _pool.resize(static_cast<size_t>(last) + prefixLength + suffixLength);
+    std::copy(_pool.begin() + previous, _pool.begin() + previous + prefixLength, _pool.begin() + last);
+    std::copy(suffix, suffix + suffixLength, _pool.begin() + last + prefixLength);
+    _offsets.push_back(static_cast<int>(_pool.size()));
+    return true;
+}
+
+int SocketPathList::SharedPrefixLength(int index) const {
+    if (index <= 0) {
+        return 0;
+    }
+    auto previous = At(index - 1);
+    auto current = At(index);
+    size_t length = 0;
+    size_t limit = std::min(previous.size(), current.size());
+    while (length < limit && previous[length] == current[length]) {
+        ++length;
+    }
+    return static_cast<int>(length);
+}
+
+//---------------------------------
+
+bool SocketFrontCodedPathList::AppendEntry(const char* entry, int length) {
+    int prefixLength = 0;
+    int i = 0;
+    for (; i < length && entry[i] >= '0' && entry[i] <= '9'; ++i) {
+        prefixLength = prefixLength * 10 + (entry[i] - '0');
+        if (prefixLength > PoolSize()) {
+            return false;
+        }
+    }
+    if (i == 0 || i >= length || entry[i] != ':') {
+        return false;
+    }
+    ++i;
+    return AppendFrontCoded(prefixLength, entry + i, length - i);
+}
+
+void SocketFrontCodedPathList::FormatEntry(int index, std::string& entry) const {
+    int prefixLength = SharedPrefixLength(index);
+    auto path = At(index);
+    entry = std::to_string(prefixLength);
+    entry += ':';
+    entry.append(path.data() + prefixLength, path.size() - prefixLength);
+}
+
+//---------------------------------
+
+void WriteField(JsonWriter& writer, const char* key, int keyLength, const SocketPathList& value) {
+    writer.BeginArray(key, keyLength);
+    for (int i = 0, count = value.Count(); i < count; ++i) {
+        auto path = value.At(i);
+        writer.WriteElement(path.data(), static_cast<int>(path.size()));
+    }
+    writer.EndArray();
+}
+
+void WriteField(JsonWriter& writer, const char* key, int keyLength, const SocketFrontCodedPathList& value) {
+    std::string entry;
+    writer.BeginArray(key, keyLength);
+    for (int i = 0, count = value.Count(); i < count; ++i) {
+        value.FormatEntry(i, entry);
+        writer.WriteElement(entry.c_str(), static_cast<int>(entry.size()));
+    }
+    writer.EndArray();
+}
+
+void WriteField(CborWriter& writer, int key, const SocketPathList& value) {
+    writer.BeginArray(key);
+    for (int i = 0, count = value.Count(); i < count; ++i) {
+        auto path = value.At(i);
+        writer.WriteElement(path.data(), static_cast<int>(path.size()));
+    }
+    writer.EndArray();
+}
+
+void WriteField(CborWriter& writer, int key, const SocketFrontCodedPathList& value) {
+    std::string entry;
+    writer.BeginArray(key);
+    for (int i = 0, count = value.Count(); i < count; ++i) {
+        value.FormatEntry(i, entry);
+        writer.WriteElement(entry.c_str(), static_cast<int>(entry.size()));
+    }
+    writer.EndArray();
+}
+
+bool ReadField(JsonReader& reader, SocketPathList& value) {
+    value.Clear();
+    std::string scratch;
+    return reader.ReadArray([&](JsonReader& reader) {
+        const char* str = nullptr;
+        int length = 0;
+        if (!reader.ReadStringView(str, length, scratch)) {
+            return false;
+        }
+        value.Append(str, length);
+        return true;
+    });
+}
+
+bool ReadField(JsonReader& reader, SocketFrontCodedPathList& value) {
+    value.Clear();
+    std::string scratch;
+    return reader.ReadArray([&](JsonReader& reader) {
+        const char* str = nullptr;
+        int length = 0;
+        if (!reader.ReadStringView(str, length, scratch)) {
+            return false;
+        }
+        return value.AppendEntry(str, length);
+    });
+}
+
+bool ReadField(CborReader& reader, SocketPathList& value) {
+    value.Clear();
+    bool isNull = false;
+    if (!reader.BeginArray(isNull) || isNull) {
+        return !reader.HasError();
+    }
+
+    std::string path;
+    while (reader.NextElement()) {
+        if (!reader.Read(path)) {
+            return false;
+        }
+        value.Append(path);
+    }
+    return !reader.HasError();
+}
+
+bool ReadField(CborReader& reader, SocketFrontCodedPathList& value) {
+    value.Clear();
+    bool isNull = false;
+    if (!reader.BeginArray(isNull) || isNull) {
+        return !reader.HasError();
+    }
+
+    std::string entry;
+    while (reader.NextElement()) {
+        if (!reader.Read(entry) || !value.AppendEntry(entry.c_str(), static_cast<int>(entry.size()))) {
+            return false;
+        }
+    }
+    return !reader.HasError();
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,86 @@
+﻿#ifndef SOCKETPATHLIST_H
+#define SOCKETPATHLIST_H
+
+#include "SocketJson.h"
+#include "SocketCbor.h"
+#include <string_view>
+#include <vector>
+
+namespace WebSocketApp {
+
+// Paths stored back to back in one char pool and addressed by offsets,
+//   so a listing of any size costs two allocations instead of one per entry.
+//   On the wire it is a plain array of strings.
+class SocketPathList {
+public:
+    SocketPathList()
+        : _offsets(1, 0)
+    {
+    }
+
+    int Count() const {
+        return static_cast<int>(_offsets.size()) - 1;
+    }
+    bool IsEmpty() const {
+        return Count() == 0;
+    }
+    // Total length of all paths
+    int PoolSize() const {
+        return static_cast<int>(_pool.size());
+    }
+
+    // Valid until the list is modified
+    std::string_view At(int index) const {
+        return std::string_view(_pool.data() + _offsets[index], _offsets[index + 1] - _offsets[index]);
+    }
+    std::string_view operator[](int index) const {
+        return At(index);
+    }
+
+    void Reserve(int count, int poolSize);
+    void Clear();
+
+    void Append(const char* path, int length);
+    void Append(std::string_view path) {
+        Append(path.data(), static_cast<int>(path.size()));
+    }
+    void Append(const SocketPathList& other);
+    // Appends the first prefixLength characters of the last path followed by suffix
+    bool AppendFrontCoded(int prefixLength, const char* suffix, int suffixLength);
+
+    // Length of the prefix the path at index shares with the one before it
+    int SharedPrefixLength(int index) const;
+
+private:
+    std::vector<char> _pool;
+    std::vector<int> _offsets;
+}; // class SocketPathList
+
+//---------------------------------
+
+// SocketPathList sent with front coding: each entry is "<n>:<suffix>",
+//   where n is the number of leading characters shared with the previous path.
+//   Sorted listings shrink to roughly their file names.
+class SocketFrontCodedPathList : public SocketPathList {
+public:
+    // Parses one "<n>:<suffix>" entry and appends the path
+    bool AppendEntry(const char* entry, int length);
+    // Formats the entry of the path at index
+    void FormatEntry(int index, std::string& entry) const;
+}; // class SocketFrontCodedPathList
+
+//---------------------------------
+
+// Codec hooks, found by SocketMessageCodec through argument dependent lookup
+extern void WriteField(JsonWriter& writer, const char* key, int keyLength, const SocketPathList& value);
+extern void WriteField(JsonWriter& writer, const char* key, int keyLength, const SocketFrontCodedPathList& value);
+extern void WriteField(CborWriter& writer, int key, const SocketPathList& value);
+extern void WriteField(CborWriter& writer, int key, const SocketFrontCodedPathList& value);
+extern bool ReadField(JsonReader& reader, SocketPathList& value);
+extern bool ReadField(JsonReader& reader, SocketFrontCodedPathList& value);
+extern bool ReadField(CborReader& reader, SocketPathList& value);
+extern bool ReadField(CborReader& reader, SocketFrontCodedPathList& value);
+
+} // namespace WebSocketApp
+
+#endif // SOCKETPATHLIST_H
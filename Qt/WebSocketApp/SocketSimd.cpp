@@ -0,0 +1,61 @@
+﻿#include "SocketSimd.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+WebSocketApp::SimdLevel DetectSimdLevel() {
+#if defined(SOCKET_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return WebSocketApp::SimdLevel::Avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return WebSocketApp::SimdLevel::Ssse3;
+    }
+#elif defined(SOCKET_SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    // AVX registers also need to be saved by the OS
+    bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (osAvx && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 5)) != 0) {
+            return WebSocketApp::SimdLevel::Avx2;
+        }
+    }
+    if (ssse3) {
+        return WebSocketApp::SimdLevel::Ssse3;
+    }
+#endif
+    return WebSocketApp::SimdLevel::Scalar;
+}
+
+} // namespace
+
+//---------------------------------
+
+namespace WebSocketApp {
+
+SimdLevel CpuSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Ssse3:
+        return "ssse3";
+    default:
+        return "scalar";
+    }
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,32 @@
+﻿#ifndef SOCKETSIMD_H
+#define SOCKETSIMD_H
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SOCKET_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// GCC and clang compile intrinsics only inside functions built for them, MSVC takes them anywhere
+#if defined(SOCKET_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SOCKET_SIMD_TARGET(features) __attribute__((target(features)))
+#else
+#define SOCKET_SIMD_TARGET(features)
+#endif
+
+namespace WebSocketApp {
+
+// Vector instructions the text codecs (SocketBase64, SocketUtf8) pick their kernels by
+enum class SimdLevel : int {
+    Scalar,
+    Ssse3,
+    Avx2,
+}; // enum SimdLevel
+
+// Best level of the running CPU, detected on the first call
+extern SimdLevel CpuSimdLevel();
+// "avx2", "ssse3" or "scalar"
+extern const char* SimdLevelName(SimdLevel level);
+
+} // namespace WebSocketApp
+
+#endif // SOCKETSIMD_H
@@ -0,0 +1,344 @@
+﻿#include "SocketStreamDecoder.h"
+#include "SocketBase64.h"
+
+namespace WebSocketApp {
+
+void SocketTextStreamDecoder::Clear() {
+    _state = State::MessageType;
+    _messageType.clear();
+    _codec = nullptr;
+    _base64Tail.clear();
+    _compressedPayload = QByteArray();
+    // Not reused: a decoded message may still refer to it
+    _payload = QByteArray();
+}
+
+bool SocketTextStreamDecoder::Append(const char* data, int length) {
+    const char* end = data + length;
+    while (data < end && _state != State::Payload) {
+        char c = *data++;
+        switch (_state) {
+        case State::MessageType:
+            if (c == ',') {
+                _state = State::Flag;
+            } else {
+                _messageType.push_back(c);
+            }
+            break;
+        case State::Flag:
+            _codec = SocketCodec::FindByFlag(c);
+            if (_codec != nullptr && _codec->Codec() == CompressionCodec::GZip && !_inflater.Begin()) {
+                _state = State::Error;
+                return false;
+            }
+            _state = State::Separator;
+            break;
+        case State::Separator:
+            _state = State::Payload;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (_state == State::Payload && data < end && !AppendBase64(data, (int)(end - data))) {
+        _state = State::Error;
+        return false;
+    }
+    return true;
+}
+
+bool SocketTextStreamDecoder::AppendBase64(const char* data, int length) {
+    // Only whole groups of 4 characters are decoded, the rest waits for the next frame
+    if (!_base64Tail.isEmpty()) {
+        int fill = qMin(4 - _base64Tail.length(), length);
+        _base64Tail.append(data, fill);
+        data += fill;
+        length -= fill;
+        if (_base64Tail.length() < 4) {
+            return true;
+        }
+        if (!AppendDecoded(_base64Tail.constData(), _base64Tail.length())) {
+            return false;
+        }
+        _base64Tail.clear();
+    }
+
+    int groupLength = length & ~3;
+    if (groupLength > 0 && !AppendDecoded(data, groupLength)) {
+        return false;
+    }
+    _base64Tail.append(data + groupLength, length - groupLength);
+    return true;
+}
+
+bool SocketTextStreamDecoder::AppendDecoded(const char* base64, int length) {
+    if (_codec == nullptr) {
+        AppendDecodedTo(base64, length, _payload);
+        return true;
+    }
+    if (_codec->Codec() != CompressionCodec::GZip) {
+        AppendDecodedTo(base64, length, _compressedPayload);
+        return true;
+    }
+    FromBase64(base64, length, _decoded);
+    return _inflater.Append(_decoded.constData(), _decoded.length(), _payload);
+}
+
+void SocketTextStreamDecoder::AppendDecodedTo(const char* base64, int length, QByteArray& dest) {
+    // Straight into dest unless the text needs the lenient decoder
+    int offset = dest.length();
+    dest.resize(offset + Base64DecodedSize(length));
+    int decodedLength = DecodeBase64(base64, length, dest.data() + offset);
+    if (decodedLength >= 0) {
+        dest.resize(offset + decodedLength);
+        return;
+    }
+    dest.resize(offset);
+    FromBase64(base64, length, _decoded);
+    dest.append(_decoded);
+}
+
+SocketMessageBase* SocketTextStreamDecoder::Finish() {
+    SocketMessageBase* message = nullptr;
+    if (_state != State::Payload) {
+        OUTPUT_ERROR_LOG("テキストメッセージの書式が不正：%s", _messageType.c_str());
+    } else if (!_base64Tail.isEmpty() && !AppendDecoded(_base64Tail.constData(), _base64Tail.length())) {
+        OUTPUT_ERROR_LOG("%sの解凍に失敗", _messageType.c_str());
+    } else if (_codec != nullptr && _codec->Codec() == CompressionCodec::GZip && !_inflater.IsFinished()) {
+        OUTPUT_ERROR_LOG("%sの解凍に失敗", _messageType.c_str());
+    } else if (_codec != nullptr && _codec->Codec() != CompressionCodec::GZip && _codec->Decompress(_compressedPayload.constData(), _compressedPayload.length(), _payload) <= 0) {
+        OUTPUT_ERROR_LOG("%sの解凍に失敗", _messageType.c_str());
+    } else {
+        message = SocketMessageBase::ImportMessage(_messageType, _payload);
+    }
+
+    Clear();
+    return message;
+}
+
+//---------------------------------
+
+void SocketBinaryStreamDecoder::Clear() {
+    _frame = QByteArray();
+    _header = SocketFrameHeader();
+    _headerRead = false;
+    _error = false;
+    _payloadLeft = 0;
+    _codec = nullptr;
+    _gzipSniffing = false;
+    _parallelGZip = false;
+    _compressedPayload = QByteArray();
+}
+
+bool SocketBinaryStreamDecoder::Append(const char* data, int length) {
+    if (_error) {
+        return false;
+    }
+
+    if (!_headerRead) {
+        // The header may be split across frames, and its size is known once the version has arrived
+        int required = 0;
+        while (length > 0 && _frame.length() < (required = SocketFrameHeader::RequiredSize(_frame.constData(), _frame.length()))) {
+            int count = qMin(required - _frame.length(), length);
+            _frame.append(data, count);
+            data += count;
+            length -= count;
+        }
+        if (_frame.length() < SocketFrameHeader::RequiredSize(_frame.constData(), _frame.length())) {
+            return true;
+        }
+
+        if (!_header.ReadHeader(_frame.constData(), _frame.length())) {
+            return Fail();
+        }
+        _headerRead = true;
+
+        // The lengths below come from the sender, nothing is reserved for them before this check
+        if (IsTooLarge((int64_t)_header.Size() + _header.PayloadLength())) {
+            OUTPUT_ERROR_LOG("フレームが最大サイズを超えています：typeId=0x%08X length=%u", _header.TypeId(), _header.PayloadLength());
+            return Fail();
+        }
+
+        if (_header.HasFlag(SocketFrameHeader::Compressed)) {
+            _payloadLeft = _header.PayloadLength();
+            if (_header.HasFlag(SocketFrameHeader::ContextTakeover)) {
+                if (_header.HasFlag(SocketFrameHeader::ContextReset)) {
+                    _contextBroken = !_takeoverInflater.Reset();
+                }
+                if (_contextBroken) {
+                    OUTPUT_ERROR_LOG("圧縮コンテキストが壊れているため解凍できません：typeId=0x%08X", _header.TypeId());
+                    return Fail();
+                }
+            } else if (_header.CodecId() != GZipCodec::ID) {
+                _codec = SocketCodec::FindById(_header.CodecId());
+                if (_codec == nullptr) {
+                    OUTPUT_ERROR_LOG("未対応の圧縮形式：codecId=%d", _header.CodecId());
+                    return Fail();
+                }
+                _compressedPayload.reserve((int)_payloadLeft);
+            } else {
+                _gzipSniffing = true;
+            }
+        } else {
+            _frame.reserve(_header.Size() + (int)_header.PayloadLength());
+        }
+    }
+
+    if (_payloadLeft > 0 && length > 0) {
+        int count = (int)qMin<uint32_t>(_payloadLeft, (uint32_t)length);
+        if (!InflatePayload(data, count)) {
+            OUTPUT_ERROR_LOG("ペイロードの解凍に失敗：typeId=0x%08X", _header.TypeId());
+            return Fail();
+        }
+        if (IsTooLarge(_frame.length())) {
+            OUTPUT_ERROR_LOG("解凍後のフレームが最大サイズを超えています：typeId=0x%08X", _header.TypeId());
+            return Fail();
+        }
+        data += count;
+        length -= count;
+        _payloadLeft -= count;
+
+        if (_payloadLeft == 0) {
+            if (!EndPayload()) {
+                OUTPUT_ERROR_LOG("ペイロードの解凍に失敗：typeId=0x%08X", _header.TypeId());
+                return Fail();
+            }
+            if (IsTooLarge(_frame.length())) {
+                OUTPUT_ERROR_LOG("解凍後のフレームが最大サイズを超えています：typeId=0x%08X", _header.TypeId());
+                return Fail();
+            }
+            _header.SetPayloadLength((uint32_t)(_frame.length() - _header.Size()));
+        }
+    }
+
+    // The attachment follows as is
+    if (length > 0) {
+        if (IsTooLarge((int64_t)_frame.length() + length)) {
+            OUTPUT_ERROR_LOG("フレームが最大サイズを超えています：typeId=0x%08X", _header.TypeId());
+            return Fail();
+        }
+        _frame.append(data, length);
+    }
+    return true;
+}
+
+void SocketBinaryStreamDecoder::Reset() {
+    Clear();
+    _takeoverInflater.Reset();
+    _contextBroken = false;
+}
+
+bool SocketBinaryStreamDecoder::InflatePayload(const char* data, int length) {
+    if (_gzipSniffing) {
+        return SniffGZip(data, length);
+    }
+    if (_codec != nullptr || _parallelGZip) {
+        _compressedPayload.append(data, length);
+        return true;
+    }
+    if (!_header.HasFlag(SocketFrameHeader::ContextTakeover)) {
+        return _inflater.Append(data, length, _frame, RemainingSize());
+    }
+    if (!_takeoverInflater.Append(data, length, _frame, RemainingSize())) {
+        // The history is lost until the sender resets the stream
+        _contextBroken = true;
+        return false;
+    }
+    return true;
+}
+
+bool SocketBinaryStreamDecoder::SniffGZip(const char* data, int length) {
+    int count = qMin(ParallelGZip::SIGNATURE_SIZE - _compressedPayload.length(), length);
+    _compressedPayload.append(data, count);
+    if (_compressedPayload.length() < ParallelGZip::SIGNATURE_SIZE) {
+        return true;
+    }
+    return StartGZip() && (count == length || InflatePayload(data + count, length - count));
+}
+
+bool SocketBinaryStreamDecoder::StartGZip() {
+    _gzipSniffing = false;
+    if (ParallelGZip::IsParallel(_compressedPayload.constData(), _compressedPayload.length())) {
+        // Inflated at once on all cores when complete
+        _parallelGZip = true;
+        _compressedPayload.reserve((int)_header.PayloadLength());
+        return true;
+    }
+
+    // Any other member is inflated frame by frame, starting with the bytes held so far
+    QByteArray head;
+    head.swap(_compressedPayload);
+    return _inflater.Begin() && _inflater.Append(head.constData(), head.length(), _frame, RemainingSize());
+}
+
+bool SocketBinaryStreamDecoder::EndPayload() {
+    if (_gzipSniffing && !StartGZip()) {
+        return false;
+    }
+    if (_parallelGZip) {
+        return EndParallelGZip();
+    }
+    if (_codec != nullptr) {
+        QByteArray payload;
+        if (_codec->Decompress(_compressedPayload.constData(), _compressedPayload.length(), payload, RemainingSize()) <= 0) {
+            return false;
+        }
+        _frame.append(payload);
+        _compressedPayload = QByteArray();
+        return true;
+    }
+    if (!_header.HasFlag(SocketFrameHeader::ContextTakeover)) {
+        return _inflater.IsFinished();
+    }
+    if (!_takeoverInflater.EndMessage(_frame, RemainingSize())) {
+        _contextBroken = true;
+        return false;
+    }
+    return true;
+}
+
+bool SocketBinaryStreamDecoder::EndParallelGZip() {
+    const char* data = _compressedPayload.constData();
+    int length = _compressedPayload.length();
+    QByteArray payload;
+    if (ParallelGZip::Decompress(data, length, payload, RemainingSize()) >= 0) {
+        _frame.append(payload);
+    } else {
+        // Not quite the layout of ParallelGZip (or too large), inflated a piece at a time up to what the frame has left
+        if (!_inflater.Begin()) {
+            return false;
+        }
+        for (int offset = 0; offset < length && !_inflater.IsFinished(); offset += ParallelGZip::CHUNK_SIZE) {
+            if (!_inflater.Append(data + offset, qMin(ParallelGZip::CHUNK_SIZE, length - offset), _frame, RemainingSize())) {
+                return false;
+            }
+        }
+        if (!_inflater.IsFinished()) {
+            return false;
+        }
+    }
+    _compressedPayload = QByteArray();
+    return true;
+}
+
+bool SocketBinaryStreamDecoder::Finish(QByteArray& frame) {
+    bool result = !_error && _headerRead && _payloadLeft == 0;
+    if (result && _header.HasFlag(SocketFrameHeader::Compressed)) {
+        _header.SetFlag(SocketFrameHeader::Compressed, false);
+        _header.SetFlag(SocketFrameHeader::ContextTakeover, false);
+        _header.SetFlag(SocketFrameHeader::ContextReset, false);
+        _header.SetCodecId(0);
+        _header.Write(_frame.data());
+    }
+    if (result) {
+        frame = _frame;
+    } else if (!_error) {
+        OUTPUT_ERROR_LOG("フレームが途中で終了：length=%d", _frame.length());
+    }
+
+    Clear();
+    return result;
+}
+
+} // namespace WebSocketApp
@@ -0,0 +1,114 @@
+﻿#ifndef SOCKETSTREAMDECODER_H
+#define SOCKETSTREAMDECODER_H
+
+#include "SocketCodec.h"
+#include "SocketMessage.h"
+#include <limits>
+
+namespace WebSocketApp {
+
+// Decodes a text envelope while its WebSocket frames arrive:
+//   base64 decoding and gzip decompression run per frame, only the parse waits for the last one.
+//   Other codecs decompress the whole payload at the end.
+class SocketTextStreamDecoder {
+public:
+    SocketTextStreamDecoder() {
+        Clear();
+    }
+
+    void Clear();
+    bool Append(const char* data, int length);
+    // After the last frame; the decoder is cleared for the next message
+    SocketMessageBase* Finish();
+
+private:
+    enum class State : int {
+        MessageType,
+        Flag,
+        Separator,
+        Payload,
+        Error,
+    }; // enum State
+
+    State _state;
+    std::string _messageType;
+    const SocketCodec* _codec;
+    QByteArray _base64Tail;
+    QByteArray _compressedPayload;
+    QByteArray _payload;
+    // Reused for each block of base64 on its way to the inflater
+    QByteArray _decoded;
+    GZipInflater _inflater;
+
+    bool AppendBase64(const char* data, int length);
+    // Takes whole groups of 4 characters, or the last of the payload
+    bool AppendDecoded(const char* base64, int length);
+    void AppendDecodedTo(const char* base64, int length, QByteArray& dest);
+}; // class SocketTextStreamDecoder
+
+//---------------------------------
+
+// Reassembles a binary frame while its WebSocket frames arrive.
+//   A gzip or context takeover payload is inflated on the way in, other codecs and ParallelGZip payloads
+//   are decompressed once complete, so the result is an uncompressed frame.
+class SocketBinaryStreamDecoder {
+public:
+    SocketBinaryStreamDecoder()
+        : _contextBroken(false)
+        , _maxFrameSize(0)
+    {
+        Clear();
+    }
+
+    void Clear();
+    // For a new connection, also drops the history of context takeover payloads
+    void Reset();
+    bool Append(const char* data, int length);
+    // After the last frame; the decoder is cleared for the next message
+    bool Finish(QByteArray& frame);
+
+    // Largest frame accepted, payload and decompressed frame alike; 0 for what a QByteArray can hold
+    void SetMaxFrameSize(int size) {
+        _maxFrameSize = size;
+    }
+
+private:
+    QByteArray _frame;
+    SocketFrameHeader _header;
+    bool _headerRead;
+    bool _error;
+    uint32_t _payloadLeft;
+    GZipInflater _inflater;
+    // Codec of a payload that is collected before decompressing, nullptr otherwise
+    const SocketCodec* _codec;
+    // The first bytes of a gzip payload are held until they show whether it is a ParallelGZip one
+    bool _gzipSniffing;
+    bool _parallelGZip;
+    QByteArray _compressedPayload;
+    // Survives Clear(), ContextTakeover payloads continue each other
+    StreamInflater _takeoverInflater;
+    bool _contextBroken;
+    int _maxFrameSize;
+
+    bool IsTooLarge(int64_t length) const {
+        return length > (_maxFrameSize > 0 ? _maxFrameSize : std::numeric_limits<int>::max());
+    }
+    // What the payload may still inflate to, handed to the inflaters so they stop at the limit
+    int RemainingSize() const {
+        return qMax(_maxFrameSize > 0 ? _maxFrameSize - _frame.length() : std::numeric_limits<int>::max() - _frame.length(), 1);
+    }
+    bool InflatePayload(const char* data, int length);
+    bool SniffGZip(const char* data, int length);
+    bool StartGZip();
+    bool EndPayload();
+    bool EndParallelGZip();
+
+    bool Fail() {
+        _error = true;
+        return false;
+    }
+}; // class SocketBinaryStreamDecoder
+
+} // namespace WebSocketApp
+
+#endif // SOCKETSTREAMDECODER_H
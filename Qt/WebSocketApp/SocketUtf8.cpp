@@ -0,0 +1,347 @@
+﻿#include "SocketUtf8.h"
+#include "SocketSimd.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+std::atomic<bool> simdEnabled(true);
+
+WebSocketApp::SimdLevel Simd() {
+    return simdEnabled.load(std::memory_order_relaxed) ? WebSocketApp::CpuSimdLevel() : WebSocketApp::SimdLevel::Scalar;
+}
+
+// Unicode 15, table 3-7
+bool IsValidScalar(const uchar* in, const uchar* end) {
+    while (in < end) {
+        uchar c = *in;
+        if (c < 0x80) {
+            ++in;
+            continue;
+        }
+
+        int length = 0;
+        uchar low = 0x80, high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            low = (c == 0xE0) ? 0xA0 : 0x80;
+            high = (c == 0xED) ? 0x9F : 0xBF;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            low = (c == 0xF0) ? 0x90 : 0x80;
+            high = (c == 0xF4) ? 0x8F : 0xBF;
+        } else {
+            return false;
+        }
+        if (end - in < length || in[1] < low || in[1] > high) {
+            return false;
+        }
+        for (int i = 2; i < length; ++i) {
+            if ((in[i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        in += length;
+    }
+    return true;
+}
+
+// One sequence of valid UTF-8
+inline void DecodeSequence(const uchar*& in, char16_t*& out) {
+    uint32_t c = in[0];
+    if (c < 0x80) {
+        *out++ = (char16_t)c;
+        in += 1;
+    } else if (c < 0xE0) {
+        *out++ = (char16_t)(((c & 0x1F) << 6) | (in[1] & 0x3F));
+        in += 2;
+    } else if (c < 0xF0) {
+        *out++ = (char16_t)(((c & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F));
+        in += 3;
+    } else {
+        uint32_t codePoint = ((c & 0x07) << 18) | ((in[1] & 0x3F) << 12) | ((in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+        codePoint -= 0x10000;
+        *out++ = (char16_t)(0xD800 + (codePoint >> 10));
+        *out++ = (char16_t)(0xDC00 + (codePoint & 0x3FF));
+        in += 4;
+    }
+}
+
+#ifdef SOCKET_SIMD_X86
+
+// Validation (J. Keiser and D. Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte")
+//   The high nibble of a byte, both nibbles of the byte before it index three tables of the errors
+//   each could be part of, and only an error all three agree on is real. What this misses, a third or
+//   fourth byte that is not a continuation, is checked against the lead bytes 2 and 3 back.
+
+const char TOO_SHORT = 1 << 0;
+const char TOO_LONG = 1 << 1;
+const char OVERLONG_3 = 1 << 2;
+const char TOO_LARGE = 1 << 3;
+const char SURROGATE = 1 << 4;
+const char OVERLONG_2 = 1 << 5;
+const char TOO_LARGE_1000 = 1 << 6;
+const char OVERLONG_4 = 1 << 6;
+const char TWO_CONTS = (char)(1 << 7);
+const char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define SOCKET_UTF8_BYTE1_HIGH \
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, \
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS, \
+    TOO_SHORT | OVERLONG_2, \
+    TOO_SHORT, \
+    TOO_SHORT | OVERLONG_3 | SURROGATE, \
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+#define SOCKET_UTF8_BYTE1_LOW \
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, \
+    CARRY | OVERLONG_2, \
+    CARRY, CARRY, \
+    CARRY | TOO_LARGE, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000
+#define SOCKET_UTF8_BYTE2_HIGH \
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+SOCKET_SIMD_TARGET("ssse3")
+inline __m128i ValidateBlock(__m128i input, __m128i previous) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+    __m128i byte1High = _mm_shuffle_epi8(_mm_setr_epi8(SOCKET_UTF8_BYTE1_HIGH), _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    __m128i byte1Low = _mm_shuffle_epi8(_mm_setr_epi8(SOCKET_UTF8_BYTE1_LOW), _mm_and_si128(prev1, nibble));
+    __m128i byte2High = _mm_shuffle_epi8(_mm_setr_epi8(SOCKET_UTF8_BYTE2_HIGH), _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+    // Bytes that have to be continuations as the third (1110____ two back) or fourth (11110___ three back)
+    __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 14), _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 13), _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, special);
+}
+
+SOCKET_SIMD_TARGET("ssse3")
+inline __m128i IncompleteBlock(__m128i input) {
+    // A lead byte in the last 3 that the block does not have room to finish
+    const __m128i max = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm_subs_epu8(input, max);
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline __m256i ValidateBlock(__m256i input, __m256i previous) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    // The byte alignment works per 128 bit lane, so the lanes are lined up with the ones before them first
+    __m256i before = _mm256_permute2x128_si256(previous, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, before, 15);
+    __m256i byte1High = _mm256_shuffle_epi8(_mm256_setr_epi8(SOCKET_UTF8_BYTE1_HIGH, SOCKET_UTF8_BYTE1_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte1Low = _mm256_shuffle_epi8(_mm256_setr_epi8(SOCKET_UTF8_BYTE1_LOW, SOCKET_UTF8_BYTE1_LOW),
+        _mm256_and_si256(prev1, nibble));
+    __m256i byte2High = _mm256_shuffle_epi8(_mm256_setr_epi8(SOCKET_UTF8_BYTE2_HIGH, SOCKET_UTF8_BYTE2_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    __m256i third = _mm256_subs_epu8(_mm256_alignr_epi8(input, before, 14), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(_mm256_alignr_epi8(input, before, 13), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, special);
+}
+
+SOCKET_SIMD_TARGET("avx2")
+inline __m256i IncompleteBlock(__m256i input) {
+    const __m256i max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+#undef SOCKET_UTF8_BYTE1_HIGH
+#undef SOCKET_UTF8_BYTE1_LOW
+#undef SOCKET_UTF8_BYTE2_HIGH
+
+inline int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// The last block is padded with zeros, so a sequence cut by the end of the text fails like any other
+SOCKET_SIMD_TARGET("ssse3")
+bool IsValidSsse3(const uchar* in, int length) {
+    __m128i error = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    for (int offset = 0; offset <= length; offset += 16) {
+        __m128i input;
+        if (length - offset >= 16) {
+            input = _mm_loadu_si128((const __m128i*)(in + offset));
+        } else {
+            uchar tail[16] = {};
+            if (offset < length) {
+                memcpy(tail, in + offset, length - offset);
+            }
+            input = _mm_loadu_si128((const __m128i*)tail);
+        }
+
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, incomplete);
+        } else {
+            error = _mm_or_si128(error, ValidateBlock(input, previous));
+        }
+        incomplete = IncompleteBlock(input);
+        previous = input;
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+SOCKET_SIMD_TARGET("avx2")
+bool IsValidAvx2(const uchar* in, int length) {
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    for (int offset = 0; offset <= length; offset += 32) {
+        __m256i input;
+        if (length - offset >= 32) {
+            input = _mm256_loadu_si256((const __m256i*)(in + offset));
+        } else {
+            uchar tail[32] = {};
+            if (offset < length) {
+                memcpy(tail, in + offset, length - offset);
+            }
+            input = _mm256_loadu_si256((const __m256i*)tail);
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, incomplete);
+        } else {
+            error = _mm256_or_si256(error, ValidateBlock(input, previous));
+        }
+        incomplete = IncompleteBlock(input);
+        previous = input;
+    }
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+// Conversion of valid UTF-8 while 16 bytes are left. Blocks of ASCII are widened whole, as are
+//   4 sequences of 3 bytes in a row; everything else is done one sequence at a time.
+//   dest has room for a code unit per byte, so the 16 code units of a store always fit.
+SOCKET_SIMD_TARGET("ssse3")
+void DecodeSsse3(const uchar*& in, const uchar* end, char16_t*& out) {
+    const __m128i zero = _mm_setzero_si128();
+    while (end - in >= 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+        int nonAscii = _mm_movemask_epi8(bytes);
+        if (nonAscii != 0xFFFF && (nonAscii & 1) == 0) {
+            _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi8(bytes, zero));
+            int ascii = (nonAscii == 0) ? 16 : CountTrailingZeros((uint32_t)nonAscii);
+            in += ascii;
+            out += ascii;
+            continue;
+        }
+
+        // 1110xxxx 10yyyyyy 10zzzzzz at 0, 3, 6 and 9
+        int leads = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8((char)0xF0)), _mm_set1_epi8((char)0xE0)));
+        if ((leads & 0xFFF) == 0x249 && (nonAscii & 0xFFF) == 0xFFF) {
+            // Each 32 bit lane gets zzzzzz yyyyyy xxxx from the bottom
+            __m128i lanes = _mm_shuffle_epi8(bytes, _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+            __m128i z = _mm_and_si128(lanes, _mm_set1_epi32(0x3F));
+            __m128i y = _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0x0FC0));
+            __m128i x = _mm_and_si128(_mm_srli_epi32(lanes, 4), _mm_set1_epi32(0xF000));
+            __m128i units = _mm_or_si128(_mm_or_si128(z, y), x);
+            units = _mm_shuffle_epi8(units, _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+            _mm_storel_epi64((__m128i*)out, units);
+            in += 12;
+            out += 4;
+            continue;
+        }
+        DecodeSequence(in, out);
+    }
+}
+
+#endif // SOCKET_SIMD_X86
+
+} // namespace
+
+//---------------------------------
+
+namespace WebSocketApp {
+
+bool IsValidUtf8(const char* src, int length) {
+    const uchar* in = (const uchar*)src;
+#ifdef SOCKET_SIMD_X86
+    switch (Simd()) {
+    case SimdLevel::Avx2:
+        return IsValidAvx2(in, length);
+    case SimdLevel::Ssse3:
+        return IsValidSsse3(in, length);
+    default:
+        break;
+    }
+#endif
+    return IsValidScalar(in, in + length);
+}
+
+int Utf8ToUtf16(const char* src, int length, char16_t* dest) {
+    if (!IsValidUtf8(src, length)) {
+        return -1;
+    }
+
+    const uchar* in = (const uchar*)src;
+    const uchar* end = in + length;
+    char16_t* out = dest;
+#ifdef SOCKET_SIMD_X86
+    if (Simd() != SimdLevel::Scalar) {
+        DecodeSsse3(in, end, out);
+    }
+#endif
+    while (in < end) {
+        DecodeSequence(in, out);
+    }
+    return (int)(out - dest);
+}
+
+void AppendUtf16(QString& dest, const char* src, int length) {
+    int offset = dest.length();
+    dest.resize(offset + length);
+    int decodedLength = Utf8ToUtf16(src, length, reinterpret_cast<char16_t*>(dest.data()) + offset);
+    if (decodedLength < 0) {
+        dest.resize(offset);
+        dest.append(QString::fromUtf8(src, length));
+        return;
+    }
+    dest.resize(offset + decodedLength);
+}
+
+void FromUtf8(const char* src, int length, QString& dest) {
+    dest.clear();
+    AppendUtf16(dest, src, length);
+}
+
+void SetUtf8SimdEnabled(bool enable) {
+    simdEnabled.store(enable, std::memory_order_relaxed);
+}
+
+const char* Utf8SimdName() {
+    return SimdLevelName(Simd());
+}
+
+} // namespace WebSocketApp
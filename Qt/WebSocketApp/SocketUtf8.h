@@ -0,0 +1,30 @@
+﻿#ifndef SOCKETUTF8_H
+#define SOCKETUTF8_H
+
+#include "WebSocketApp.h"
+#include <QString>
+
+namespace WebSocketApp {
+
+// UTF-8 to UTF-16 for text on its way from a message to the view
+//   Validation takes 32 (AVX2) or 16 (SSSE3) bytes at a time, and the conversion widens runs of ASCII
+//   and of 3 byte sequences (kana and kanji) with SSSE3. Anything else goes through the scalar code.
+
+// Whether src is well-formed UTF-8: no overlong forms, surrogates, code points past U+10FFFF or cut sequences
+extern bool IsValidUtf8(const char* src, int length);
+// Writes the UTF-16 of src to dest, which needs room for length code units.
+//   Returns the number written, or -1 when src is not valid UTF-8.
+extern int Utf8ToUtf16(const char* src, int length, char16_t* dest);
+
+extern void AppendUtf16(QString& dest, const char* src, int length);
+// Replaces dest with src; invalid sequences become U+FFFD as with QString::fromUtf8()
+extern void FromUtf8(const char* src, int length, QString& dest);
+
+// Vector code on (the default) or off, for benchmarks
+extern void SetUtf8SimdEnabled(bool enable);
+// "avx2", "ssse3" or "scalar"
+extern const char* Utf8SimdName();
+
+} // namespace WebSocketApp
+
+#endif // SOCKETUTF8_H
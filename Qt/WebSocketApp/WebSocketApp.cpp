@@ -1,17 +1,68 @@
 ﻿#include "WebSocketApp.h"
+#include "SocketBase64.h"
+#include "SocketDictionary.h"
 
 #include <QByteArray>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtEndian>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
 #include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "External/zlib/zlib.h"
 
 
 namespace {
 
 #define GZIP_WINDOWS_BIT 15 + 16
+#define ZLIB_WINDOWS_BIT 15
+// Detects a zlib or gzip header
+#define AUTO_WINDOWS_BIT 15 + 32
 #define GZIP_CHUNK_SIZE 32 * 1024
+#define DEFLATE_WINDOWS_BIT -15
+
+// Ends every Z_SYNC_FLUSH, so it is left out of the messages and added back before inflating
+const char SYNC_FLUSH_TAIL[] = { 0x00, 0x00, (char)0xFF, (char)0xFF };
+
+const uchar GZIP_MAGIC_1 = 0x1f;
+const uchar GZIP_MAGIC_2 = 0x8b;
+const uchar GZIP_DEFLATED = 8;
+const uchar GZIP_FLAG_EXTRA = 4;
+const uchar GZIP_OS_UNKNOWN = 255;
+const int GZIP_HEADER_SIZE = 10;
+const int GZIP_TRAILER_SIZE = 8;
+// deflate cannot expand data more than about 1032 times
+const int64_t DEFLATE_RATIO_MAX = 1032;
+const int GZIP_SIZE_HINT_MAX = 1 << 30;
+
+// Text decoded per inflate() call by DecompressBase64(), a multiple of 4
+const int BASE64_INFLATE_BLOCK_SIZE = 16 * 1024;
+
+// Size a gzip member of srcLength bytes claims in its ISIZE trailer, 0 when it is no gzip member
+//   ISIZE is the size modulo 2^32 and another member may follow, so it only sizes the output up front.
+int GZipSizeHint(const uchar* header, const uchar* trailer, int srcLength) {
+    if (srcLength < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE || header[0] != GZIP_MAGIC_1 || header[1] != GZIP_MAGIC_2) {
+        return 0;
+    }
+    int64_t size = qFromLittleEndian<quint32>(trailer + 4);
+    return (int)qMin(size, qMin(srcLength * DEFLATE_RATIO_MAX, (int64_t)GZIP_SIZE_HINT_MAX));
+}
+
+// Largest length dest may reach when at most maxLength bytes (0 for no limit) are appended to it
+int64_t InflateLimit(const QByteArray& dest, int maxLength) {
+    if (maxLength > 0) {
+        return qMin<int64_t>((int64_t)dest.length() + maxLength, std::numeric_limits<int>::max() - 1);
+    }
+    return std::numeric_limits<int>::max() - 1;
+}
 
 } // namespace
 
@@ -152,7 +203,7 @@ void OutputErrorLog(const char* fileName, const char* functionName, int line, co
     WriteErrorLog(log);
 }
 
-bool ReadFile(const std::string& path, std::vector<char>& buffer) {
+bool ReadFile(const std::string& path, QByteArray& buffer) {
     std::ifstream file(path, std::ios::in | std::ios::binary);
     if(!file) {
         OUTPUT_ERROR_LOG("ファイルの読み込み失敗：%s", path.c_str());
@@ -164,10 +215,15 @@ bool ReadFile(const std::string& path, std::vector<char>& buffer) {
     if (fileLength <= 0) {
         buffer.clear();
     }
+    else if (fileLength > std::numeric_limits<int>::max()) {
+        OUTPUT_ERROR_LOG("ファイルサイズが大きすぎる：%s (%lld bytes)", path.c_str(), (long long)fileLength);
+        return false;
+    }
     else {
         buffer.resize((int)fileLength);
-        auto length = file.read(&buffer[0], fileLength).gcount();
+        auto length = file.read(buffer.data(), fileLength).gcount();
         if (length != fileLength) {
+            OUTPUT_ERROR_LOG("ファイルの読み込み失敗：%s (%lld / %lld bytes)", path.c_str(), (long long)length, (long long)fileLength);
             return false;
         }
     }
@@ -176,15 +232,15 @@ bool ReadFile(const std::string& path, std::vector<char>& buffer) {
     return true;
 }
 
-bool writeFile(const std::string& path, const std::vector<char>& buffer) {
+bool writeFile(const std::string& path, const QByteArray& buffer) {
     std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
     {
         if (!file) {
             return false;
         }
 
-        if (!buffer.empty()) {
-            if (!file.write(&(buffer[0]), buffer.size())) {
+        if (!buffer.isEmpty()) {
+            if (!file.write(buffer.constData(), buffer.length())) {
                 return false;
             }
         }
@@ -196,186 +252,1003 @@ bool writeFile(const std::string& path, const std::vector<char>& buffer) {
 
 //---------------------------------
 
-int CompressGZip(z_stream& stream, const void* src, int srcLength, std::vector<char>& dest) {
-    // Declare vars
-    int flush = 0;
+// zlib asks for the same few block sizes for every stream, so freed blocks are kept for the next stream
+class ZStreamMemoryPool {
+public:
+    // Freed blocks beyond this go back to the heap
+    static const size_t POOLED_BYTES_MAX = 4 * 1024 * 1024;
 
-    // Extract pointer to input data
-    const uchar* input_data = (const uchar*)src;
-    int input_data_left = srcLength;
+    static ZStreamMemoryPool* Instance() {
+        // Never destroyed, thread local contexts may still free into it during shutdown
+        static ZStreamMemoryPool* instance = new ZStreamMemoryPool();
+        return instance;
+    }
 
-    uchar *output_data = (uchar *)&(dest[0]);
-    int output_length = 0;
-    uchar out[GZIP_CHUNK_SIZE];
+    static voidpf Alloc(voidpf opaque, uInt items, uInt size) {
+        return static_cast<ZStreamMemoryPool*>(opaque)->Allocate((size_t)items * size);
+    }
+    static void Free(voidpf opaque, voidpf address) {
+        static_cast<ZStreamMemoryPool*>(opaque)->Release(address);
+    }
 
-    // Compress data until available
-    int ret = Z_OK;
-    do {
-        // Determine current chunk size
-        int chunk_size = qMin(GZIP_CHUNK_SIZE, input_data_left);
+    void Setup(z_stream& stream) {
+        stream.zalloc = &ZStreamMemoryPool::Alloc;
+        stream.zfree = &ZStreamMemoryPool::Free;
+        stream.opaque = this;
+    }
 
-        // Set deflater references
-        stream.next_in = (uchar *)input_data;
-        stream.avail_in = chunk_size;
+private:
+    // Each block starts with its size, padded to keep the returned address aligned
+    static const size_t BLOCK_HEADER_SIZE = 16;
 
-        // Update interval variables
-        input_data += chunk_size;
-        input_data_left -= chunk_size;
+    std::mutex _mutex;
+    std::unordered_map<size_t, std::vector<char*>> _freeBlocks;
+    size_t _pooledBytes;
 
-        // Determine if it is the last chunk
-        flush = (input_data_left <= 0 ? Z_FINISH : Z_NO_FLUSH);
+    ZStreamMemoryPool()
+        : _pooledBytes(0)
+    {
+    }
 
-        // Deflate chunk and cumulate output
-        do {
-            // Set deflater references
-            stream.next_out = (uchar*)out;
-            stream.avail_out = GZIP_CHUNK_SIZE;
+    void* Allocate(size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _freeBlocks.find(size);
+            if (it != _freeBlocks.end() && !it->second.empty()) {
+                char* block = it->second.back();
+                it->second.pop_back();
+                _pooledBytes -= size;
+                return block + BLOCK_HEADER_SIZE;
+            }
+        }
 
-            // Try to deflate chunk
-            ret = deflate(&stream, flush);
+        char* block = static_cast<char*>(malloc(BLOCK_HEADER_SIZE + size));
+        if (block == nullptr) {
+            return Z_NULL;
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+        return block + BLOCK_HEADER_SIZE;
+    }
 
-            // Check errors
-            if(ret == Z_STREAM_ERROR)
-            {
-                return -1;
+    void Release(void* address) {
+        char* block = static_cast<char*>(address) - BLOCK_HEADER_SIZE;
+        size_t size = *reinterpret_cast<size_t*>(block);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_pooledBytes + size <= POOLED_BYTES_MAX) {
+                _freeBlocks[size].push_back(block);
+                _pooledBytes += size;
+                return;
             }
+        }
+        free(block);
+    }
+}; // class ZStreamMemoryPool
 
-            // Determine compressed size
-            int have = (GZIP_CHUNK_SIZE - stream.avail_out);
+int CompressGZip(const void* src, int srcLength, std::vector<char>& compressed, int level, const SocketDictionary* dictionary) {
+    return GZipDeflater::ThreadInstance().Compress(src, srcLength, compressed, level, dictionary);
+}
 
-            // Cumulate result
-            if(have > 0) {
-                int nextLength = output_length + have;
-                if (dest.size() < nextLength) {
-                     dest.resize(nextLength * 2);
-                     output_data = (uchar *)&(dest[output_length]);
-                }
+int DecompressGZip(const void* src, int srcLength, std::vector<char>& decompressed) {
+    QByteArray buffer;
+    int result = GZipInflater::ThreadInstance().Decompress(src, srcLength, buffer);
+    if (result > 0) {
+        decompressed.assign(buffer.constData(), buffer.constData() + result);
+    }
+    return result;
+}
 
-                memcpy(output_data, out, have);
-                output_data += have;
-                output_length += have;
-            }
-        } while (stream.avail_out == 0);
-    } while (flush != Z_FINISH);
+int DecompressGZip(const void* src, int srcLength, QByteArray& decompressed) {
+    QByteArray buffer;
+    int result = GZipInflater::ThreadInstance().Decompress(src, srcLength, buffer);
+    if (result > 0) {
+        decompressed = buffer;
+    }
+    return result;
+}
+
+//---------------------------------
 
-    return (ret != Z_STREAM_END) ? -1 : output_length;
+namespace {
+
+const int LZ4_MIN_MATCH = 4;
+// The last literals and the distance of the last match from the end, as the format requires
+const int LZ4_LAST_LITERALS = 5;
+const int LZ4_MATCH_FIND_LIMIT = 12;
+const int LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_LOG = 13;
+const int LZ4_SIZE_PREFIX = 4;
+// Beyond this ratio the header of a payload is a lie
+const int LZ4_MAX_RATIO = 255;
+
+inline uint32_t ReadUInt32(const uchar* src) {
+    uint32_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
 }
 
-int DecompressGZip(z_stream& stream, const void* src, int srcLength, std::vector<char>& dest) {
-    const uchar *input_data = (const uchar*)src;
-    int input_data_left = srcLength;
+inline uint32_t Lz4Hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
 
-    uchar *output_data = (uchar *)&(dest[0]);
-    int output_length = 0;
-    uchar out[GZIP_CHUNK_SIZE];
+// 15 in the token nibble, then the rest in bytes of up to 255
+inline uchar* WriteLz4Length(uchar* dest, int length) {
+    for (length -= 15; length >= 255; length -= 255) {
+        *dest++ = 255;
+    }
+    *dest++ = (uchar)length;
+    return dest;
+}
 
-    int ret = Z_OK;
+// Adds the bytes after a nibble of 15 to length, failing as soon as it passes limit
+//   A run of 255 bytes cannot overflow length this way, however long the input is.
+inline bool ReadLz4Length(const uchar*& src, const uchar* end, size_t limit, size_t& length) {
+    uchar value = 0;
     do {
-        int chunk_size = std::min<int>(GZIP_CHUNK_SIZE, input_data_left);
+        if (src >= end) {
+            return false;
+        }
+        value = *src++;
+        length += value;
+        if (length > limit) {
+            return false;
+        }
+    } while (value == 255);
+    return true;
+}
 
-        if(chunk_size <= 0) {
-        break;
+uchar* WriteLz4Sequence(uchar* dest, const uchar* literals, int literalLength, int offset, int matchLength) {
+    uchar* token = dest++;
+    *token = (uchar)(qMin(literalLength, 15) << 4);
+    if (literalLength >= 15) {
+        dest = WriteLz4Length(dest, literalLength);
+    }
+    memcpy(dest, literals, literalLength);
+    dest += literalLength;
+
+    if (matchLength > 0) {
+        *dest++ = (uchar)offset;
+        *dest++ = (uchar)(offset >> 8);
+        int length = matchLength - LZ4_MIN_MATCH;
+        *token |= (uchar)qMin(length, 15);
+        if (length >= 15) {
+            dest = WriteLz4Length(dest, length);
         }
+    }
+    return dest;
+}
 
-        stream.next_in = (uchar*)input_data;
-        stream.avail_in = chunk_size;
+} // namespace
 
-        // Update interval variables
-        input_data += chunk_size;
-        input_data_left -= chunk_size;
+int CompressLz4(const void* src, int srcLength, QByteArray& dest) {
+    if (srcLength < 0) {
+        return -1;
+    }
 
-        // Inflate chunk and cumulate output
-        do {
-            // Set inflater references
-            stream.next_out = out;
-            stream.avail_out = GZIP_CHUNK_SIZE;
+    dest.resize(LZ4_SIZE_PREFIX + srcLength + srcLength / 255 + 16);
+    uchar* out = (uchar*)dest.data();
+    qToLittleEndian<quint32>((quint32)srcLength, out);
+    out += LZ4_SIZE_PREFIX;
+
+    const uchar* base = (const uchar*)src;
+    const uchar* input = base;
+    const uchar* anchor = base;
+    const uchar* end = base + srcLength;
+    if (srcLength > LZ4_MATCH_FIND_LIMIT) {
+        const uchar* findLimit = end - LZ4_MATCH_FIND_LIMIT;
+        const uchar* matchLimit = end - LZ4_LAST_LITERALS;
+
+        // Positions + 1, so that 0 is empty
+        std::vector<int> table(1 << LZ4_HASH_LOG, 0);
+        int misses = 0;
+        ++input;
+        while (input < findLimit) {
+            uint32_t sequence = ReadUInt32(input);
+            int& entry = table[Lz4Hash(sequence)];
+            // Compared as positions, a pointer is only formed for an entry that is set
+            int previous = entry - 1;
+            entry = (int)(input - base) + 1;
+
+            if (previous < 0 || (input - base) - previous > LZ4_MAX_OFFSET || ReadUInt32(base + previous) != sequence) {
+                // Skip faster through data that does not match
+                input += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            const uchar* candidate = base + previous;
 
-            // Try to inflate chunk
-            ret = inflate(&stream, Z_NO_FLUSH);
+            while (input > anchor && candidate > base && input[-1] == candidate[-1]) {
+                --input;
+                --candidate;
+            }
+            const uchar* matchEnd = input + LZ4_MIN_MATCH;
+            const uchar* candidateEnd = candidate + LZ4_MIN_MATCH;
+            while (matchEnd < matchLimit && *matchEnd == *candidateEnd) {
+                ++matchEnd;
+                ++candidateEnd;
+            }
 
-            switch (ret) {
-            case Z_NEED_DICT:
-                ret = Z_DATA_ERROR;
-            case Z_DATA_ERROR:
-            case Z_MEM_ERROR:
-            case Z_STREAM_ERROR:
-                return -1;
+            out = WriteLz4Sequence(out, anchor, (int)(input - anchor), (int)(input - candidate), (int)(matchEnd - input));
+            input = matchEnd;
+            anchor = input;
+            if (input - 2 > base && input < findLimit) {
+                table[Lz4Hash(ReadUInt32(input - 2))] = (int)(input - 2 - base) + 1;
             }
+        }
+    }
 
-            // Determine decompressed size
-            int have = (GZIP_CHUNK_SIZE - stream.avail_out);
+    out = WriteLz4Sequence(out, anchor, (int)(end - anchor), 0, 0);
+    int length = (int)(out - (uchar*)dest.data());
+    dest.resize(length);
+    return length;
+}
 
-            // Cumulate result
-            if(have > 0) {
-                int nextLength = output_length + have;
-                if (dest.size() < nextLength) {
-                    dest.resize(nextLength * 2);
-                    output_data = (uchar *)&(dest[output_length]);
-                }
+int DecompressLz4(const void* src, int srcLength, QByteArray& dest, int maxLength) {
+    if (srcLength < LZ4_SIZE_PREFIX + 1) {
+        return -1;
+    }
+
+    const uchar* input = (const uchar*)src;
+    const uchar* inputEnd = input + srcLength;
+    uint32_t rawLength = qFromLittleEndian<quint32>(input);
+    input += LZ4_SIZE_PREFIX;
+    if (rawLength > (uint64_t)srcLength * LZ4_MAX_RATIO || rawLength > (uint32_t)std::numeric_limits<int>::max()
+        || (maxLength > 0 && rawLength > (uint32_t)maxLength)) {
+        return -1;
+    }
 
-                memcpy(output_data, out, have);
-                output_data += have;
-                output_length += have;
+    dest.resize((int)rawLength);
+    uchar* begin = (uchar*)dest.data();
+    uchar* out = begin;
+    uchar* outEnd = begin + rawLength;
+    while (input < inputEnd) {
+        int token = *input++;
+
+        // Every length is checked against what is left of the input and the output before it is used
+        size_t literalLength = token >> 4;
+        size_t literalLimit = qMin<size_t>(inputEnd - input, outEnd - out);
+        if (literalLength == 15 && !ReadLz4Length(input, inputEnd, literalLimit, literalLength)) {
+            return -1;
+        }
+        if (literalLength > (size_t)(inputEnd - input) || literalLength > (size_t)(outEnd - out)) {
+            return -1;
+        }
+        memcpy(out, input, literalLength);
+        input += literalLength;
+        out += literalLength;
+
+        // The last sequence has no match
+        if (input >= inputEnd) {
+            break;
+        }
+
+        if (inputEnd - input < 2) {
+            return -1;
+        }
+        int offset = input[0] | (input[1] << 8);
+        input += 2;
+        if (offset == 0 || offset > out - begin) {
+            return -1;
+        }
+
+        size_t matchLength = token & 15;
+        size_t outLeft = outEnd - out;
+        if (outLeft < (size_t)LZ4_MIN_MATCH) {
+            return -1;
+        }
+        if (matchLength == 15 && !ReadLz4Length(input, inputEnd, outLeft - LZ4_MIN_MATCH, matchLength)) {
+            return -1;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > outLeft) {
+            return -1;
+        }
+
+        const uchar* match = out - offset;
+        if ((size_t)offset >= matchLength) {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        } else {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < matchLength; ++i) {
+                *out++ = match[i];
             }
-        } while (stream.avail_out == 0);
+        }
+    }
+
+    if (out != outEnd) {
+        return -1;
+    }
+    return (int)rawLength;
+}
 
-    } while (ret != Z_STREAM_END);
+//---------------------------------
 
-    return (ret != Z_STREAM_END) ? -1 : output_length;
+GZipDeflater::GZipDeflater()
+    : _stream(new z_stream())
+    , _initialized(false)
+    , _level(0)
+    , _zlibWrapper(false)
+{
 }
 
-int CompressGZip(const void* src, int srcLength, std::vector<char>& compressed) {
-    int result = -1;
+GZipDeflater::~GZipDeflater() {
+    if (_initialized) {
+        deflateEnd(_stream);
+    }
+    delete _stream;
+}
 
-    z_stream stream;
-    {
-        stream.zalloc = nullptr;
-        stream.zfree = nullptr;
-        stream.opaque = nullptr;
-        stream.avail_in = 0;
-        stream.next_in = nullptr;
+GZipDeflater& GZipDeflater::ThreadInstance() {
+    thread_local GZipDeflater deflater;
+    return deflater;
+}
 
-        if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, GZIP_WINDOWS_BIT, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-            return -1;
+bool GZipDeflater::Begin(int level, const SocketDictionary* dictionary) {
+    bool zlibWrapper = (dictionary != nullptr);
+    if (_initialized) {
+        if (level != _level || zlibWrapper != _zlibWrapper) {
+            // deflateParams() of zlib 1.2.11 may try to flush a stream that was only reset, so start over
+            deflateEnd(_stream);
+            _initialized = false;
+        } else if (deflateReset(_stream) != Z_OK) {
+            return false;
         }
+    }
 
-        std::vector<char> buffer(srcLength);
-        result = CompressGZip(stream, src, srcLength, buffer);
-        if (result > 0) {
-            compressed.resize(result);
-            memcpy(&(compressed[0]), &(buffer[0]), result);
+    if (!_initialized) {
+        ZStreamMemoryPool::Instance()->Setup(*_stream);
+        _stream->avail_in = 0;
+        _stream->next_in = nullptr;
+        _initialized = (deflateInit2(_stream, level, Z_DEFLATED, zlibWrapper ? ZLIB_WINDOWS_BIT : GZIP_WINDOWS_BIT, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        _level = level;
+        _zlibWrapper = zlibWrapper;
+        if (!_initialized) {
+            return false;
         }
     }
-    deflateEnd(&stream);
 
+    // A reset drops the dictionary as well
+    if (dictionary != nullptr) {
+        const QByteArray& bytes = dictionary->Bytes();
+        return deflateSetDictionary(_stream, (const Bytef*)bytes.constData(), (uInt)bytes.length()) == Z_OK;
+    }
+    return true;
+}
+
+int GZipDeflater::Bound(int srcLength) const {
+    return (int)deflateBound(_stream, (uLong)srcLength);
+}
+
+int GZipDeflater::Deflate(const void* src, int srcLength, char* dest, int destLength) {
+    // dest holds deflateBound() bytes, so the whole member is written by a single call
+    _stream->next_in = (uchar*)src;
+    _stream->avail_in = srcLength;
+    _stream->next_out = (uchar*)dest;
+    _stream->avail_out = destLength;
+    if (deflate(_stream, Z_FINISH) != Z_STREAM_END) {
+        return -1;
+    }
+    return destLength - (int)_stream->avail_out;
+}
+
+int GZipDeflater::Compress(const void* src, int srcLength, QByteArray& dest, int level, const SocketDictionary* dictionary) {
+    if (!Begin(level, dictionary)) {
+        return -1;
+    }
+
+    dest.resize(Bound(srcLength));
+    int result = Deflate(src, srcLength, dest.data(), dest.length());
+    dest.resize(qMax(0, result));
     return result;
 }
 
-int DecompressGZip(const void* src, int srcLength, std::vector<char>& decompressed) {
-    int result = -1;
+int GZipDeflater::Compress(const void* src, int srcLength, std::vector<char>& dest, int level, const SocketDictionary* dictionary) {
+    if (!Begin(level, dictionary)) {
+        return -1;
+    }
 
-    z_stream stream;
-    {
-        stream.zalloc = nullptr;
-        stream.zfree = nullptr;
-        stream.opaque = nullptr;
-        stream.avail_in = 0;
-        stream.next_in = nullptr;
+    dest.resize(Bound(srcLength));
+    int result = Deflate(src, srcLength, dest.data(), (int)dest.size());
+    dest.resize(qMax(0, result));
+    return result;
+}
 
-        if (inflateInit2(&stream, GZIP_WINDOWS_BIT) != Z_OK) {
+//---------------------------------
+
+GZipInflater::GZipInflater()
+    : _stream(new z_stream())
+    , _initialized(false)
+    , _finished(false)
+{
+}
+
+GZipInflater::~GZipInflater() {
+    if (_initialized) {
+        inflateEnd(_stream);
+    }
+    delete _stream;
+}
+
+GZipInflater& GZipInflater::ThreadInstance() {
+    thread_local GZipInflater inflater;
+    return inflater;
+}
+
+bool GZipInflater::Begin() {
+    _finished = false;
+    if (_initialized) {
+        return inflateReset(_stream) == Z_OK;
+    }
+
+    ZStreamMemoryPool::Instance()->Setup(*_stream);
+    _stream->avail_in = 0;
+    _stream->next_in = nullptr;
+    _initialized = (inflateInit2(_stream, AUTO_WINDOWS_BIT) == Z_OK);
+    return _initialized;
+}
+
+bool GZipInflater::SetDictionary(uint32_t id) {
+    const SocketDictionary* dictionary = SocketDictionaryRegistry::Instance().Find(id);
+    if (dictionary == nullptr) {
+        OUTPUT_ERROR_LOG("辞書が見つかりません：id=%08x", id);
+        return false;
+    }
+
+    const QByteArray& bytes = dictionary->Bytes();
+    return inflateSetDictionary(_stream, (const Bytef*)bytes.constData(), (uInt)bytes.length()) == Z_OK;
+}
+
+int GZipInflater::Decompress(const void* src, int srcLength, QByteArray& dest, int maxLength) {
+    if (srcLength >= ParallelGZip::CHUNK_SIZE / 2) {
+        int result = ParallelGZip::Decompress(src, srcLength, dest, maxLength);
+        if (result >= 0) {
+            return result;
+        }
+    }
+
+    dest.clear();
+    if (!Begin()) {
+        return -1;
+    }
+    if (srcLength >= GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE) {
+        const uchar* input = (const uchar*)src;
+        int hint = GZipSizeHint(input, input + srcLength - GZIP_TRAILER_SIZE, srcLength);
+        dest.reserve(maxLength > 0 ? qMin(hint, maxLength) : hint);
+    }
+    if (!Append(src, srcLength, dest, maxLength) || !_finished) {
+        return -1;
+    }
+    return dest.length();
+}
+
+int GZipInflater::DecompressBase64(const char* src, int srcLength, QByteArray& dest) {
+    // The first 8 characters hold the gzip header up to FLG, the last 8 at least the 4 bytes of ISIZE
+    uchar header[6];
+    uchar tail[6];
+    int tailLength = -1;
+    if (srcLength >= 16 && (srcLength & 3) == 0 && DecodeBase64(src, 8, (char*)header) == 6) {
+        tailLength = DecodeBase64(src + srcLength - 8, 8, (char*)tail);
+    }
+    int compressedLength = (srcLength / 4 - 2) * 3 + tailLength;
+
+    // Text that toBase64() does not write is decoded the way QByteArray does, and a ParallelGZip member
+    // needs all of its chunks at hand
+    if (tailLength < GZIP_TRAILER_SIZE / 2
+        || (compressedLength >= ParallelGZip::CHUNK_SIZE / 2 && header[0] == GZIP_MAGIC_1 && header[3] == GZIP_FLAG_EXTRA)) {
+        QByteArray compressed = QByteArray::fromBase64(QByteArray::fromRawData(src, srcLength));
+        return Decompress(compressed.constData(), compressed.length(), dest);
+    }
+
+    dest.clear();
+    if (!Begin()) {
+        return -1;
+    }
+    dest.reserve(GZipSizeHint(header, tail + tailLength - GZIP_TRAILER_SIZE, compressedLength));
+
+    char block[BASE64_INFLATE_BLOCK_SIZE / 4 * 3];
+    for (int offset = 0; offset < srcLength && !_finished; offset += BASE64_INFLATE_BLOCK_SIZE) {
+        int blockLength = qMin(BASE64_INFLATE_BLOCK_SIZE, srcLength - offset);
+        int decodedLength = DecodeBase64(src + offset, blockLength, block);
+        if (decodedLength < 0) {
+            QByteArray compressed = QByteArray::fromBase64(QByteArray::fromRawData(src, srcLength));
+            return Decompress(compressed.constData(), compressed.length(), dest);
+        }
+        if (!Append(block, decodedLength, dest)) {
             return -1;
         }
+    }
+    if (!_finished) {
+        return -1;
+    }
+    return dest.length();
+}
 
-        std::vector<char> buffer(srcLength);
-        result = DecompressGZip(stream, src, srcLength, buffer);
-        if (result > 0) {
-            decompressed.resize(result);
-            memcpy(&(decompressed[0]), &(buffer[0]), result);
+bool GZipInflater::Append(const void* src, int srcLength, QByteArray& dest, int maxLength) {
+    if (!_initialized) {
+        return false;
+    }
+
+    // One byte of room past the limit tells whether there is more output than allowed
+    const int64_t limit = InflateLimit(dest, maxLength);
+    _stream->next_in = (uchar*)src;
+    _stream->avail_in = srcLength;
+    bool more = true;
+    while (!_finished && more) {
+        // Inflate straight into dest, using up whatever has been reserved in one go
+        int offset = dest.length();
+        int chunkSize = (int)qMin<int64_t>(qMax(GZIP_CHUNK_SIZE, (int)dest.capacity() - offset), limit + 1 - offset);
+        dest.resize(offset + chunkSize);
+        _stream->next_out = (uchar*)dest.data() + offset;
+        _stream->avail_out = chunkSize;
+
+        int ret = inflate(_stream, Z_NO_FLUSH);
+        dest.resize(offset + (chunkSize - (int)_stream->avail_out));
+        if (dest.length() > limit) {
+            return false;
         }
+        switch (ret) {
+        case Z_STREAM_END:
+            _finished = true;
+            break;
+        case Z_NEED_DICT:
+            // adler holds the id of the dictionary named by the zlib header
+            if (!SetDictionary((uint32_t)_stream->adler)) {
+                return false;
+            }
+            break;
+        case Z_OK:
+        case Z_BUF_ERROR:
+            // Z_BUF_ERROR only means that the input ran out
+            break;
+        default:
+            return false;
+        }
+        // A full output may hide more, even when all input has been consumed
+        more = (_stream->avail_in > 0 || _stream->avail_out == 0);
     }
-    inflateEnd(&stream);
+    return true;
+}
+
+//---------------------------------
+
+StreamDeflater::StreamDeflater()
+    : _stream(new z_stream())
+    , _initialized(false)
+    , _resetPending(true)
+    , _level(0)
+{
+}
+
+StreamDeflater::~StreamDeflater() {
+    if (_initialized) {
+        deflateEnd(_stream);
+    }
+    delete _stream;
+}
+
+void StreamDeflater::Reset() {
+    if (_initialized) {
+        deflateReset(_stream);
+    }
+    _resetPending = true;
+}
+
+bool StreamDeflater::Begin(int level) {
+    if (_initialized) {
+        if (level == _level) {
+            return true;
+        }
+        deflateEnd(_stream);
+        _initialized = false;
+        _resetPending = true;
+    }
+
+    ZStreamMemoryPool::Instance()->Setup(*_stream);
+    _stream->avail_in = 0;
+    _stream->next_in = nullptr;
+    _initialized = (deflateInit2(_stream, level, Z_DEFLATED, DEFLATE_WINDOWS_BIT, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    _level = level;
+    return _initialized;
+}
+
+int StreamDeflater::Compress(const void* src, int srcLength, QByteArray& dest, int level) {
+    if (!Begin(level)) {
+        return -1;
+    }
+
+    _stream->next_in = (uchar*)src;
+    _stream->avail_in = srcLength;
+    dest.resize(qMax((int)deflateBound(_stream, (uLong)srcLength), 64));
+    int written = 0;
+    while (true) {
+        _stream->next_out = (uchar*)dest.data() + written;
+        _stream->avail_out = dest.length() - written;
+        int ret = deflate(_stream, Z_SYNC_FLUSH);
+        written = dest.length() - (int)_stream->avail_out;
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            Reset();
+            return -1;
+        }
+        // The flush is complete once deflate() returns with room left
+        if (_stream->avail_out > 0) {
+            break;
+        }
+        dest.resize(dest.length() * 2);
+    }
+
+    if (written < (int)sizeof(SYNC_FLUSH_TAIL) || memcmp(dest.constData() + written - sizeof(SYNC_FLUSH_TAIL), SYNC_FLUSH_TAIL, sizeof(SYNC_FLUSH_TAIL)) != 0) {
+        Reset();
+        return -1;
+    }
+    written -= (int)sizeof(SYNC_FLUSH_TAIL);
+    dest.resize(written);
+    _resetPending = false;
+    return written;
+}
+
+//---------------------------------
+
+StreamInflater::StreamInflater()
+    : _stream(new z_stream())
+    , _initialized(false)
+{
+}
+
+StreamInflater::~StreamInflater() {
+    if (_initialized) {
+        inflateEnd(_stream);
+    }
+    delete _stream;
+}
+
+bool StreamInflater::Reset() {
+    if (_initialized) {
+        return inflateReset(_stream) == Z_OK;
+    }
+
+    ZStreamMemoryPool::Instance()->Setup(*_stream);
+    _stream->avail_in = 0;
+    _stream->next_in = nullptr;
+    _initialized = (inflateInit2(_stream, DEFLATE_WINDOWS_BIT) == Z_OK);
+    return _initialized;
+}
+
+bool StreamInflater::Append(const void* src, int srcLength, QByteArray& dest, int maxLength) {
+    if (!_initialized && !Reset()) {
+        return false;
+    }
+
+    const int64_t limit = InflateLimit(dest, maxLength);
+    _stream->next_in = (uchar*)src;
+    _stream->avail_in = srcLength;
+    bool more = true;
+    while (more) {
+        int offset = dest.length();
+        int chunkSize = (int)qMin<int64_t>(GZIP_CHUNK_SIZE, limit + 1 - offset);
+        dest.resize(offset + chunkSize);
+        _stream->next_out = (uchar*)dest.data() + offset;
+        _stream->avail_out = chunkSize;
+
+        int ret = inflate(_stream, Z_SYNC_FLUSH);
+        dest.resize(offset + (chunkSize - (int)_stream->avail_out));
+        if (dest.length() > limit) {
+            return false;
+        }
+        // Z_STREAM_END is an error too, the stream never has a final block
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        more = (_stream->avail_in > 0 || _stream->avail_out == 0);
+    }
+    return true;
+}
+
+bool StreamInflater::EndMessage(QByteArray& dest, int maxLength) {
+    return Append(SYNC_FLUSH_TAIL, (int)sizeof(SYNC_FLUSH_TAIL), dest, maxLength);
+}
+
+//---------------------------------
+
+namespace {
+
+// gzip header with FEXTRA, then XLEN, then the "KP" subfield: uint32 chunk size, uint32 compressed size per chunk
+const uchar PARALLEL_SUBFIELD_1 = 'K';
+const uchar PARALLEL_SUBFIELD_2 = 'P';
+const int EXTRA_FIELD_MAX = 65535;
+const int SUBFIELD_HEADER_SIZE = 4;
+const int PARALLEL_CHUNK_COUNT_MAX = (EXTRA_FIELD_MAX - SUBFIELD_HEADER_SIZE - 4) / 4;
+
+// The chunk size Compress() writes for srcLength bytes, the only one Decompress() accepts
+int64_t ParallelChunkSize(int64_t srcLength) {
+    return qMax<int64_t>(ParallelGZip::CHUNK_SIZE, (srcLength + PARALLEL_CHUNK_COUNT_MAX - 1) / PARALLEL_CHUNK_COUNT_MAX);
+}
+
+// Runs work(0) ... work(count - 1) on the global thread pool and the calling thread, returns whether all succeeded
+//   The caller takes part and only waits for the chunks, not for the runnables, so a busy pool cannot stall it.
+class ParallelJob {
+public:
+    static bool Run(int count, const std::function<bool(int)>& work) {
+        auto job = std::make_shared<ParallelJob>(count, work);
+        int helpers = qMin(count - 1, QThreadPool::globalInstance()->maxThreadCount());
+        for (int i = 0; i < helpers; ++i) {
+            QThreadPool::globalInstance()->start(new Runner(job));
+        }
+        job->Work();
 
+        std::unique_lock<std::mutex> lock(job->_mutex);
+        job->_finishedCondition.wait(lock, [&job]() { return job->_finished == job->_count; });
+        return job->_succeeded;
+    }
+
+    ParallelJob(int count, const std::function<bool(int)>& work)
+        : _count(count)
+        , _work(work)
+        , _next(0)
+        , _finished(0)
+        , _succeeded(true)
+    {
+    }
+
+private:
+    class Runner : public QRunnable {
+    public:
+        explicit Runner(const std::shared_ptr<ParallelJob>& job)
+            : _job(job)
+        {
+        }
+        void run() override {
+            _job->Work();
+        }
+
+    private:
+        std::shared_ptr<ParallelJob> _job;
+    }; // class Runner
+
+    const int _count;
+    std::function<bool(int)> _work;
+    std::atomic<int> _next;
+    std::mutex _mutex;
+    std::condition_variable _finishedCondition;
+    int _finished;
+    bool _succeeded;
+
+    void Work() {
+        for (int index = _next++; index < _count; index = _next++) {
+            bool result = _work(index);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _succeeded = _succeeded && result;
+            if (++_finished == _count) {
+                _finishedCondition.notify_all();
+            }
+        }
+    }
+}; // class ParallelJob
+
+// Raw deflate of one chunk, the context is kept per thread of the pool
+class ChunkDeflater {
+public:
+    ChunkDeflater()
+        : _initialized(false)
+        , _level(0)
+    {
+    }
+    ~ChunkDeflater() {
+        if (_initialized) {
+            deflateEnd(&_stream);
+        }
+    }
+
+    static ChunkDeflater& ThreadInstance() {
+        thread_local ChunkDeflater deflater;
+        return deflater;
+    }
+
+    // The last chunk ends the deflate stream, the others end with a sync flush
+    bool Compress(const uchar* src, int srcLength, std::vector<uchar>& dest, int level, bool last) {
+        if (_initialized && level != _level) {
+            deflateEnd(&_stream);
+            _initialized = false;
+        }
+        if (!_initialized) {
+            _stream = z_stream();
+            ZStreamMemoryPool::Instance()->Setup(_stream);
+            if (deflateInit2(&_stream, level, Z_DEFLATED, DEFLATE_WINDOWS_BIT, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return false;
+            }
+            _initialized = true;
+            _level = level;
+        } else if (deflateReset(&_stream) != Z_OK) {
+            return false;
+        }
+
+        // deflateBound() plus the empty stored block of the sync flush
+        dest.resize(deflateBound(&_stream, (uLong)srcLength) + 16);
+        _stream.next_in = (Bytef*)src;
+        _stream.avail_in = (uInt)srcLength;
+        _stream.next_out = dest.data();
+        _stream.avail_out = (uInt)dest.size();
+        int ret = deflate(&_stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        if (ret != (last ? Z_STREAM_END : Z_OK) || _stream.avail_in != 0) {
+            return false;
+        }
+        dest.resize(dest.size() - _stream.avail_out);
+        return true;
+    }
+
+private:
+    z_stream _stream;
+    bool _initialized;
+    int _level;
+}; // class ChunkDeflater
+
+bool InflateChunk(const uchar* src, int srcLength, uchar* dest, int destLength, bool last) {
+    z_stream stream = z_stream();
+    ZStreamMemoryPool::Instance()->Setup(stream);
+    if (inflateInit2(&stream, DEFLATE_WINDOWS_BIT) != Z_OK) {
+        return false;
+    }
+    stream.next_in = (Bytef*)src;
+    stream.avail_in = (uInt)srcLength;
+    stream.next_out = dest;
+    stream.avail_out = (uInt)destLength;
+    int ret = inflate(&stream, Z_SYNC_FLUSH);
+    // With the output full, the end of block and the sync flush may not have been read yet
+    uchar overflow = 0;
+    while (ret == Z_OK && stream.avail_out == 0 && stream.avail_in > 0) {
+        stream.next_out = &overflow;
+        stream.avail_out = 1;
+        ret = inflate(&stream, Z_SYNC_FLUSH);
+        if (stream.avail_out == 0) {
+            // More output than the header said
+            ret = Z_DATA_ERROR;
+        }
+        stream.avail_out = 0;
+    }
+    // Nothing may be left on either side: the sizes come from the header
+    bool result = (last ? ret == Z_STREAM_END : (ret == Z_OK || ret == Z_BUF_ERROR))
+        && stream.avail_in == 0 && stream.avail_out == 0;
+    inflateEnd(&stream);
     return result;
 }
 
+} // namespace
+
+const int ParallelGZip::CHUNK_SIZE;
+const int ParallelGZip::MINIMUM_SIZE;
+const int ParallelGZip::SIGNATURE_SIZE;
+
+int ParallelGZip::Compress(const void* src, int srcLength, QByteArray& dest, int level) {
+    if (srcLength <= 0) {
+        return -1;
+    }
+
+    int chunkSize = (int)ParallelChunkSize(srcLength);
+    int count = (srcLength + chunkSize - 1) / chunkSize;
+    const uchar* input = (const uchar*)src;
+
+    std::vector<std::vector<uchar>> chunks(count);
+    std::vector<uLong> crcs(count);
+    bool result = ParallelJob::Run(count, [&](int index) {
+        int offset = index * chunkSize;
+        int length = qMin(chunkSize, srcLength - offset);
+        crcs[index] = crc32(0, input + offset, (uInt)length);
+        return ChunkDeflater::ThreadInstance().Compress(input + offset, length, chunks[index], level, index == count - 1);
+    });
+    if (!result) {
+        return -1;
+    }
+
+    uLong crc = crcs[0];
+    int compressedLength = (int)chunks[0].size();
+    for (int i = 1; i < count; ++i) {
+        int length = qMin(chunkSize, srcLength - i * chunkSize);
+        crc = crc32_combine(crc, crcs[i], (z_off_t)length);
+        compressedLength += (int)chunks[i].size();
+    }
+
+    int subfieldLength = 4 + count * 4;
+    int extraLength = SUBFIELD_HEADER_SIZE + subfieldLength;
+    dest.resize(GZIP_HEADER_SIZE + 2 + extraLength + compressedLength + GZIP_TRAILER_SIZE);
+    uchar* out = (uchar*)dest.data();
+    const uchar header[GZIP_HEADER_SIZE] = { GZIP_MAGIC_1, GZIP_MAGIC_2, GZIP_DEFLATED, GZIP_FLAG_EXTRA, 0, 0, 0, 0, 0, GZIP_OS_UNKNOWN };
+    memcpy(out, header, GZIP_HEADER_SIZE);
+    out += GZIP_HEADER_SIZE;
+    qToLittleEndian<quint16>((quint16)extraLength, out);
+    out[2] = PARALLEL_SUBFIELD_1;
+    out[3] = PARALLEL_SUBFIELD_2;
+    qToLittleEndian<quint16>((quint16)subfieldLength, out + 4);
+    qToLittleEndian<quint32>((quint32)chunkSize, out + 6);
+    out += 2 + SUBFIELD_HEADER_SIZE + 4;
+    for (const auto& chunk : chunks) {
+        qToLittleEndian<quint32>((quint32)chunk.size(), out);
+        out += 4;
+    }
+    for (const auto& chunk : chunks) {
+        memcpy(out, chunk.data(), chunk.size());
+        out += chunk.size();
+    }
+    qToLittleEndian<quint32>((quint32)crc, out);
+    qToLittleEndian<quint32>((quint32)srcLength, out + 4);
+    return dest.length();
+}
+
+bool ParallelGZip::IsParallel(const void* src, int length) {
+    const uchar* input = (const uchar*)src;
+    return length >= SIGNATURE_SIZE
+        && input[0] == GZIP_MAGIC_1 && input[1] == GZIP_MAGIC_2 && input[2] == GZIP_DEFLATED && input[3] == GZIP_FLAG_EXTRA
+        && input[GZIP_HEADER_SIZE + 2] == PARALLEL_SUBFIELD_1 && input[GZIP_HEADER_SIZE + 3] == PARALLEL_SUBFIELD_2;
+}
+
+int ParallelGZip::Decompress(const void* src, int srcLength, QByteArray& dest, int maxLength) {
+    const uchar* input = (const uchar*)src;
+    const int extraOffset = GZIP_HEADER_SIZE + 2;
+    if (srcLength < extraOffset + SUBFIELD_HEADER_SIZE + 4 + GZIP_TRAILER_SIZE || !IsParallel(src, srcLength)) {
+        return -1;
+    }
+
+    // Only the layout written by Compress() is taken, anything else goes to GZipInflater
+    int extraLength = qFromLittleEndian<quint16>(input + GZIP_HEADER_SIZE);
+    const uchar* subfield = input + extraOffset;
+    int subfieldLength = qFromLittleEndian<quint16>(subfield + 2);
+    if (extraLength != SUBFIELD_HEADER_SIZE + subfieldLength || subfieldLength < 8 || (subfieldLength & 3) != 0
+        || extraOffset + extraLength + GZIP_TRAILER_SIZE > srcLength) {
+        return -1;
+    }
+
+    const uchar* trailer = input + srcLength - GZIP_TRAILER_SIZE;
+    uint32_t expectedCrc = qFromLittleEndian<quint32>(trailer);
+    uint32_t rawLength = qFromLittleEndian<quint32>(trailer + 4);
+    int64_t chunkSize = qFromLittleEndian<quint32>(subfield + SUBFIELD_HEADER_SIZE);
+    int count = (subfieldLength - 4) / 4;
+    // ISIZE and the chunk size are the sender's word, the output is allocated from them
+    if (rawLength == 0 || rawLength > (uint32_t)std::numeric_limits<int>::max()
+        || rawLength > srcLength * DEFLATE_RATIO_MAX || (maxLength > 0 && rawLength > (uint32_t)maxLength)
+        || chunkSize != ParallelChunkSize(rawLength) || (rawLength + chunkSize - 1) / chunkSize != count) {
+        return -1;
+    }
+
+    std::vector<int> offsets(count + 1);
+    const uchar* sizes = subfield + SUBFIELD_HEADER_SIZE + 4;
+    offsets[0] = extraOffset + extraLength;
+    for (int i = 0; i < count; ++i) {
+        int64_t end = (int64_t)offsets[i] + qFromLittleEndian<quint32>(sizes + i * 4);
+        if (end > srcLength - GZIP_TRAILER_SIZE) {
+            return -1;
+        }
+        offsets[i + 1] = (int)end;
+    }
+    if (offsets[count] != srcLength - GZIP_TRAILER_SIZE) {
+        return -1;
+    }
+
+    QByteArray buffer;
+    buffer.resize((int)rawLength);
+    uchar* output = (uchar*)buffer.data();
+    std::vector<uLong> crcs(count);
+    bool result = ParallelJob::Run(count, [&](int index) {
+        int64_t offset = index * chunkSize;
+        int length = (int)qMin<int64_t>(chunkSize, rawLength - offset);
+        if (!InflateChunk(input + offsets[index], offsets[index + 1] - offsets[index], output + offset, length, index == count - 1)) {
+            return false;
+        }
+        crcs[index] = crc32(0, output + offset, (uInt)length);
+        return true;
+    });
+    if (!result) {
+        return -1;
+    }
+
+    uLong crc = crcs[0];
+    for (int i = 1; i < count; ++i) {
+        crc = crc32_combine(crc, crcs[i], (z_off_t)qMin<int64_t>(chunkSize, rawLength - i * chunkSize));
+    }
+    if ((uint32_t)crc != expectedCrc) {
+        return -1;
+    }
+
+    dest = buffer;
+    return dest.length();
+}
+
 } // namespace WebSocketApp
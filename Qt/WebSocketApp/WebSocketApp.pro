@@ -2,7 +2,7 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets websockets
 
-CONFIG += c++11
+CONFIG += c++17
 
 win32 {
 	QMAKE_CXXFLAGS += -execution-charset:utf-8
@@ -14,8 +14,11 @@ win32 {
 
 SOURCES += \
 	External/zlib/adler32.c \
+	External/zlib/adler32_simd.c \
 	External/zlib/compress.c \
+	External/zlib/cpu_features.c \
 	External/zlib/crc32.c \
+	External/zlib/crc32_simd.c \
 	External/zlib/deflate.c \
 	External/zlib/infback.c \
 	External/zlib/inffast.c \
@@ -27,12 +30,29 @@ SOURCES += \
 	External/zlib/gzlib.c \
     ConnectionDialog.cpp \
     ImageWidget.cpp \
+    SocketAttachment.cpp \
+    SocketBase64.cpp \
+    SocketCbor.cpp \
+    SocketClock.cpp \
+    SocketCodec.cpp \
+    SocketCompressionPolicy.cpp \
+    SocketDictionary.cpp \
+    SocketFrame.cpp \
+    SocketFrameBatch.cpp \
+    SocketJson.cpp \
     SocketMessage.cpp \
+    SocketMessageCache.cpp \
+    SocketMessageRegistry.cpp \
+    SocketPathList.cpp \
+    SocketSimd.cpp \
+    SocketStreamDecoder.cpp \
+    SocketUtf8.cpp \
     WebSocketApp.cpp \
     main.cpp \
     MainWindow.cpp
 
 HEADERS += \
+	External/zlib/cpu_features.h \
 	External/zlib/crc32.h \
 	External/zlib/deflate.h \
 	External/zlib/inffast.h \
@@ -46,7 +66,24 @@ HEADERS += \
     ConnectionDialog.h \
     ImageWidget.h \
     MainWindow.h \
+    SocketAttachment.h \
+    SocketBase64.h \
+    SocketCbor.h \
+    SocketClock.h \
+    SocketCodec.h \
+    SocketCompressionPolicy.h \
+    SocketDictionary.h \
+    SocketFrame.h \
+    SocketFrameBatch.h \
+    SocketJson.h \
     SocketMessage.h \
+    SocketMessageCache.h \
+    SocketMessageCodec.h \
+    SocketMessageRegistry.h \
+    SocketPathList.h \
+    SocketSimd.h \
+    SocketStreamDecoder.h \
+    SocketUtf8.h \
     WebSocketApp.h
 
 FORMS += \
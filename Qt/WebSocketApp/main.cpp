@@ -1,10 +1,29 @@
 ﻿#include "MainWindow.h"
+#include "SocketDictionary.h"
+#include "SocketMessageCache.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption cacheOption("message-cache", "Memory for encoded messages sent to several devices, in MB (0 to disable)", "MB");
+    parser.addOption(cacheOption);
+    parser.process(a);
+    if (parser.isSet(cacheOption)) {
+        bool ok = false;
+        qlonglong megabytes = parser.value(cacheOption).toLongLong(&ok);
+        if (!ok || megabytes < 0) {
+            parser.showHelp(1);
+        }
+        WebSocketApp::SocketMessageCache::Instance().SetCapacity(megabytes * 1024 * 1024);
+    }
+
+    WebSocketApp::SocketDictionaryRegistry::Instance().LoadDirectory((QApplication::applicationDirPath() + "/" + WebSocketApp::SocketDictionaryRegistry::DIRECTORY_NAME).toStdString());
     MainWindow w;
     w.show();
     return a.exec();
@@ -0,0 +1,276 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using UnityEngine;
+
+namespace WebSocketApp
+{
+    // Header of a binary frame (little endian), the same layout as SocketFrameHeader of the tool
+    //   uint32 typeId, uint16 flags, uint16 version, int32 requestId, uint32 payloadLength, [int64 timestamp]
+    //   The payload follows, then the raw bytes of the attachment when Attachment is set.
+    public class SocketFrameHeader
+    {
+        public const ushort VERSION_MIN = 1;
+        public const ushort VERSION_TIMESTAMP = 2;
+        // Timestamps need the clock sync of the tool, which this side does not answer yet
+        public const ushort VERSION = 1;
+
+        public const ushort FLAG_COMPRESSED = 1 << 0;
+        public const ushort FLAG_ATTACHMENT = 1 << 1;
+        public const ushort FLAG_CBOR = 1 << 2;
+        public const ushort FLAG_BATCH = 1 << 3;
+        public const ushort FLAG_CONTEXT_TAKEOVER = 1 << 4;
+        public const ushort FLAG_CONTEXT_RESET = 1 << 5;
+
+        private const int CODEC_ID_SHIFT = 12;
+        public const int CODEC_ID_GZIP = 0;
+
+        public uint TypeId;
+        public ushort Flags;
+        public ushort Version = VERSION;
+        public int RequestId = -1;
+        public uint PayloadLength;
+        public long Timestamp;
+
+        public int Size
+        {
+            get => SizeOf(Version);
+        }
+
+        public int CodecId
+        {
+            get => Flags >> CODEC_ID_SHIFT;
+        }
+
+        public static int SizeOf(ushort version)
+        {
+            return (version >= VERSION_TIMESTAMP) ? 24 : 16;
+        }
+
+        // FNV-1a of the name of the message type
+        public static uint HashMessageType(string messageType)
+        {
+            uint hash = 2166136261u;
+            foreach (var c in messageType)
+            {
+                hash = unchecked((hash ^ (byte)c) * 16777619u);
+            }
+            return hash;
+        }
+
+        public bool HasFlag(ushort flag)
+        {
+            return (Flags & flag) != 0;
+        }
+
+        public bool Read(byte[] src, int offset, int length)
+        {
+            if (length < SizeOf(VERSION_MIN))
+            {
+                Debug.LogErrorFormat("フレームヘッダのサイズが不足：length={0}", length);
+                return false;
+            }
+
+            TypeId = ReadUInt32(src, offset);
+            Flags = (ushort)(src[offset + 4] | (src[offset + 5] << 8));
+            Version = (ushort)(src[offset + 6] | (src[offset + 7] << 8));
+            RequestId = (int)ReadUInt32(src, offset + 8);
+            PayloadLength = ReadUInt32(src, offset + 12);
+
+            if (Version < VERSION_MIN || Version > VERSION_TIMESTAMP)
+            {
+                Debug.LogErrorFormat("未対応のフレームバージョン：version={0}", Version);
+                return false;
+            }
+            if (length < Size)
+            {
+                Debug.LogErrorFormat("フレームヘッダのサイズが不足：length={0}", length);
+                return false;
+            }
+            Timestamp = (Version >= VERSION_TIMESTAMP) ? (long)((ulong)ReadUInt32(src, offset + 16) | ((ulong)ReadUInt32(src, offset + 20) << 32)) : 0;
+
+            if (PayloadLength > (uint)(length - Size))
+            {
+                Debug.LogErrorFormat("フレームのペイロード長が不正：payloadLength={0}, length={1}", PayloadLength, length);
+                return false;
+            }
+            return true;
+        }
+
+        public void Write(byte[] dest, int offset)
+        {
+            WriteUInt32(dest, offset, TypeId);
+            dest[offset + 4] = (byte)Flags;
+            dest[offset + 5] = (byte)(Flags >> 8);
+            dest[offset + 6] = (byte)Version;
+            dest[offset + 7] = (byte)(Version >> 8);
+            WriteUInt32(dest, offset + 8, (uint)RequestId);
+            WriteUInt32(dest, offset + 12, PayloadLength);
+            if (Version >= VERSION_TIMESTAMP)
+            {
+                WriteUInt32(dest, offset + 16, (uint)Timestamp);
+                WriteUInt32(dest, offset + 20, (uint)((ulong)Timestamp >> 32));
+            }
+        }
+
+        // Header and payload in a new array, PayloadLength is set from length
+        public byte[] CreateFrame(byte[] payload, int offset, int length)
+        {
+            PayloadLength = (uint)length;
+            var frame = new byte[Size + length];
+            Write(frame, 0);
+            Buffer.BlockCopy(payload, offset, frame, Size, length);
+            return frame;
+        }
+
+        public static uint ReadUInt32(byte[] src, int offset)
+        {
+            return (uint)(src[offset] | (src[offset + 1] << 8) | (src[offset + 2] << 16) | (src[offset + 3] << 24));
+        }
+
+        public static void WriteUInt32(byte[] dest, int offset, uint value)
+        {
+            dest[offset] = (byte)value;
+            dest[offset + 1] = (byte)(value >> 8);
+            dest[offset + 2] = (byte)(value >> 16);
+            dest[offset + 3] = (byte)(value >> 24);
+        }
+    } // class SocketFrameHeader
+
+    //---------------------------------
+
+    // Many small frames in one binary frame
+    //   Batch payload : { uint32 frameLength, frame }...
+    //   The payload is compressed as a whole, so the frames in it should not be.
+    public class SocketFrameBatch
+    {
+        public static readonly uint TYPE_ID = SocketFrameHeader.HashMessageType("SocketFrameBatch");
+
+        private const int FRAME_LENGTH_SIZE = 4;
+
+        private MemoryStream _payload = new MemoryStream();
+        private byte[] _frameLength = new byte[FRAME_LENGTH_SIZE];
+
+        public int Count
+        {
+            get;
+            private set;
+        } = 0;
+
+        public int Size
+        {
+            get => (int)_payload.Length;
+        }
+
+        public bool IsEmpty
+        {
+            get => Count == 0;
+        }
+
+        public void Append(byte[] frame)
+        {
+            SocketFrameHeader.WriteUInt32(_frameLength, 0, (uint)frame.Length);
+            _payload.Write(_frameLength, 0, FRAME_LENGTH_SIZE);
+            _payload.Write(frame, 0, frame.Length);
+            ++Count;
+        }
+
+        public void Clear()
+        {
+            // Keep the capacity for the next batch
+            _payload.SetLength(0);
+            Count = 0;
+        }
+
+        // A small batch of one is sent as the bare frame, a large one is still compressed
+        public byte[] Export(SocketConnectionOptions options)
+        {
+            if (Count == 0)
+            {
+                return null;
+            }
+            var payload = _payload.GetBuffer();
+            if (Count == 1 && Size < options.BatchMaxBytes)
+            {
+                var frame = new byte[Size - FRAME_LENGTH_SIZE];
+                Buffer.BlockCopy(payload, FRAME_LENGTH_SIZE, frame, 0, frame.Length);
+                return frame;
+            }
+
+            var header = new SocketFrameHeader();
+            header.TypeId = TYPE_ID;
+            header.Version = options.FrameVersion;
+            header.Flags = SocketFrameHeader.FLAG_BATCH;
+            if (options.IsCompressed)
+            {
+                var compressed = SocketMessageBase.Compress(payload, 0, Size);
+                if (compressed != null && compressed.Length < Size)
+                {
+                    header.Flags |= SocketFrameHeader.FLAG_COMPRESSED;
+                    return header.CreateFrame(compressed, 0, compressed.Length);
+                }
+            }
+            return header.CreateFrame(payload, 0, Size);
+        }
+
+        // frames refer to payload, the decompressed payload of the batch
+        public static bool Unpack(SocketFrameHeader header, byte[] payload, int offset, int length, List<ArraySegment<byte>> frames)
+        {
+            frames.Clear();
+            if (header.HasFlag(SocketFrameHeader.FLAG_CONTEXT_TAKEOVER))
+            {
+                Debug.LogError("バッチはコンテキスト引き継ぎの圧縮のため解凍できない");
+                return false;
+            }
+
+            int current = offset;
+            int end = offset + length;
+            while (current < end)
+            {
+                if (end - current < FRAME_LENGTH_SIZE)
+                {
+                    Debug.LogErrorFormat("バッチの書式が不正：offset={0}", current - offset);
+                    return false;
+                }
+                uint frameLength = SocketFrameHeader.ReadUInt32(payload, current);
+                current += FRAME_LENGTH_SIZE;
+                if (frameLength > (uint)(end - current))
+                {
+                    Debug.LogErrorFormat("バッチ内のフレーム長が不正：length={0}", frameLength);
+                    return false;
+                }
+
+                frames.Add(new ArraySegment<byte>(payload, current, (int)frameLength));
+                current += (int)frameLength;
+            }
+            return true;
+        }
+    } // class SocketFrameBatch
+
+    //---------------------------------
+
+    // What SocketCapabilityMessage settled on for the connection
+    public class SocketConnectionOptions
+    {
+        public bool IsBinaryFrame = false;
+        public ushort FrameVersion = SocketFrameHeader.VERSION;
+        public bool IsCompressed = true;
+        // Limit of the tool for our frames, 0 for none
+        public int MaxFrameSize = 0;
+        // 0 disables batching
+        public int BatchMaxMessages = 0;
+        public int BatchMaxBytes = 0;
+        // Microseconds
+        public int BatchDelay = 0;
+
+        public bool IsBatchEnabled
+        {
+            get => IsBinaryFrame && BatchMaxMessages > 0 && BatchMaxBytes > 0;
+        }
+
+        public SocketConnectionOptions Clone()
+        {
+            return (SocketConnectionOptions)MemberwiseClone();
+        }
+    } // class SocketConnectionOptions
+} // namespace WebSocketApp
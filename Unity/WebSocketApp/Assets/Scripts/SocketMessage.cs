@@ -26,6 +26,7 @@ namespace WebSocketApp
             {typeof(SockeTextMessage).Name,  typeof(SockeTextMessage)},
             {typeof(SocketRequestMessage).Name,  typeof(SocketRequestMessage)},
             {typeof(SocketConnectionInformationMessage).Name,  typeof(SocketConnectionInformationMessage)},
+            {typeof(SocketCapabilityMessage).Name,  typeof(SocketCapabilityMessage)},
             {typeof(SocketScreenShotRequestMessage).Name,  typeof(SocketScreenShotRequestMessage)},
             {typeof(SocketFileListRequestMessage).Name,  typeof(SocketFileListRequestMessage)},
             {typeof(SocketFileUploadRequestMessage).Name,  typeof(SocketFileUploadRequestMessage)},
@@ -35,6 +36,8 @@ namespace WebSocketApp
             {typeof(SocketMoveGameObjectMessage).Name,  typeof(SocketMoveGameObjectMessage)},
             {typeof(SocketImageDataMessage).Name,  typeof(SocketImageDataMessage)},
         };
+        // Binary frames name the type by the hash of its name
+        private static readonly Dictionary<uint, Type> MESSAGE_TYPE_IDS = CreateMessageTypeIds();
 
         public string MessageType
         {
@@ -42,6 +45,18 @@ namespace WebSocketApp
         }
         public string _messageType;
 
+        // Written to the header of a binary frame
+        public virtual int RequestId
+        {
+            get => -1;
+        }
+
+        // Length of the file or image data carried, known without exporting the message
+        public virtual int DataLength
+        {
+            get => 0;
+        }
+
         private static byte[] _base64Buffer = new byte[1024];
 
 
@@ -50,6 +65,21 @@ namespace WebSocketApp
             _messageType = GetType().Name;
         }
 
+        private static Dictionary<uint, Type> CreateMessageTypeIds()
+        {
+            var typeIds = new Dictionary<uint, Type>();
+            foreach (var pair in MESSAGE_TYPES)
+            {
+                typeIds.Add(SocketFrameHeader.HashMessageType(pair.Key), pair.Value);
+            }
+            return typeIds;
+        }
+
+        // Binary frames carry the file or image of a message as raw bytes after the payload
+        public virtual void SetAttachment(byte[] bytes, int offset, int length)
+        {
+        }
+
         public static SocketMessageBase ImportMessage(string val)
         {
             var index = val.IndexOf(',');
@@ -123,6 +153,106 @@ namespace WebSocketApp
             return result;
         }
 
+        public static SocketMessageBase ImportBinaryMessage(byte[] frame, int offset, int length)
+        {
+            var header = new SocketFrameHeader();
+            if (!header.Read(frame, offset, length))
+            {
+                return null;
+            }
+            if (!MESSAGE_TYPE_IDS.TryGetValue(header.TypeId, out var type))
+            {
+                Debug.LogErrorFormat("未対応のメッセージタイプ：typeId=0x{0:X8}", header.TypeId);
+                return null;
+            }
+            if (header.HasFlag(SocketFrameHeader.FLAG_CBOR))
+            {
+                Debug.LogErrorFormat("CBORのペイロードには対応していない：{0}", type.Name);
+                return null;
+            }
+
+            SocketMessageBase message = null;
+            try
+            {
+                if (!ReadPayload(header, frame, offset, out var payload))
+                {
+                    return null;
+                }
+                var json = System.Text.Encoding.UTF8.GetString(payload.Array, payload.Offset, payload.Count);
+                message = JsonUtility.FromJson(json, type) as SocketMessageBase;
+            }
+            catch (Exception ex)
+            {
+                Debug.LogException(ex);
+                return null;
+            }
+            if (message == null)
+            {
+                return null;
+            }
+
+            message._messageType = type.Name;
+            if (header.HasFlag(SocketFrameHeader.FLAG_ATTACHMENT))
+            {
+                int attachmentOffset = offset + header.Size + (int)header.PayloadLength;
+                message.SetAttachment(frame, attachmentOffset, offset + length - attachmentOffset);
+            }
+            return message;
+        }
+
+        // The payload of a frame, decompressed when it is
+        public static bool ReadPayload(SocketFrameHeader header, byte[] frame, int offset, out ArraySegment<byte> payload)
+        {
+            payload = new ArraySegment<byte>(frame, offset + header.Size, (int)header.PayloadLength);
+            if (!header.HasFlag(SocketFrameHeader.FLAG_COMPRESSED))
+            {
+                return true;
+            }
+
+            // Only gzip is offered to the tool, so nothing else should arrive
+            if (header.HasFlag(SocketFrameHeader.FLAG_CONTEXT_TAKEOVER) || header.CodecId != SocketFrameHeader.CODEC_ID_GZIP)
+            {
+                Debug.LogErrorFormat("未対応の圧縮形式：codecId={0}, flags=0x{1:X4}", header.CodecId, header.Flags);
+                return false;
+            }
+            var decompressed = Decompress(frame, payload.Offset, payload.Count);
+            if (decompressed == null)
+            {
+                return false;
+            }
+            payload = new ArraySegment<byte>(decompressed);
+            return true;
+        }
+
+        // The JSON is gzip compressed when that makes it smaller, like the text envelope
+        public static byte[] ExportBinaryMessage(SocketMessageBase message, SocketConnectionOptions options)
+        {
+            try
+            {
+                var payload = System.Text.Encoding.UTF8.GetBytes(JsonUtility.ToJson(message));
+
+                var header = new SocketFrameHeader();
+                header.TypeId = SocketFrameHeader.HashMessageType(message.MessageType);
+                header.Version = options.FrameVersion;
+                header.RequestId = message.RequestId;
+                if (options.IsCompressed && payload.Length > 0)
+                {
+                    var compressed = Compress(payload, 0, payload.Length);
+                    if (compressed != null && compressed.Length < payload.Length)
+                    {
+                        payload = compressed;
+                        header.Flags |= SocketFrameHeader.FLAG_COMPRESSED;
+                    }
+                }
+                return header.CreateFrame(payload, 0, payload.Length);
+            }
+            catch (Exception ex)
+            {
+                Debug.LogException(ex);
+                return null;
+            }
+        }
+
         public static string GetDirectory(UnityDirectoryType directoryType)
         {
             switch (directoryType)
@@ -156,7 +286,12 @@ namespace WebSocketApp
 
         public static byte[] Decompress(byte[] bytes)
         {
-            using (MemoryStream inStream = new MemoryStream(bytes))
+            return Decompress(bytes, 0, bytes.Length);
+        }
+
+        public static byte[] Decompress(byte[] bytes, int offset, int length)
+        {
+            using (MemoryStream inStream = new MemoryStream(bytes, offset, length))
             {
                 using (MemoryStream outStream = Decompress(inStream))
                 {
@@ -240,6 +375,11 @@ namespace WebSocketApp
     {
         public static readonly string MESSAGE_TYPE = typeof(SocketRequestMessage).Name;
 
+        public override int RequestId
+        {
+            get => _requestId;
+        }
+
         public string _request;
         public int _requestId;
     } // class SocketRequestMessage
@@ -264,6 +404,10 @@ namespace WebSocketApp
 
         public UnityDirectoryType _directoryType = UnityDirectoryType.Invalid;
         public string _targetPath;
+        // Entries per SocketFileListMessage, 0 from tools that take the whole listing at once
+        public int _pageSize = 0;
+        // Empty for the first page, otherwise the token of the previous page
+        public string _continuationToken;
     } // class SocketFileListRequestMessage
 
     //---------------------------------
@@ -339,15 +483,98 @@ namespace WebSocketApp
             }
         }
 
+        public override int RequestId
+        {
+            get => _requestId;
+        }
+
         public int _requestId;
         public string _applicationName;
         public string _uuid;
         public string _deviceName;
         public string _deviceModel;
+        // Newest binary frame version this side reads; the tool offers SocketCapabilityMessage only when it is set,
+        // builds without it never see that message
+        public int _frameVersion = SocketFrameHeader.VERSION;
     } // class SocketConnectionInformationMessage
 
     //---------------------------------
 
+    // Exchanged after SocketConnectionInformationMessage: the tool sends its capabilities, this side answers
+    // with its own and both pick what the other supports. The lists are ordered by preference.
+    [Serializable]
+    public class SocketCapabilityMessage : SocketMessageBase
+    {
+        public static readonly string MESSAGE_TYPE = typeof(SocketCapabilityMessage).Name;
+
+        public const string ENCODING_JSON = "json";
+        public const string CODEC_NONE = "none";
+        public const string CODEC_GZIP = "gzip";
+
+        // Capabilities of this side: JSON payloads, gzip (GZipStream) or none.
+        // Batches carry the Debug.Log floods, a delay under 1ms waits the 1ms of the flush timer.
+        public SocketCapabilityMessage() : base()
+        {
+            _frameVersion = SocketFrameHeader.VERSION;
+            _encodings = new string[] { ENCODING_JSON };
+            _codecs = new string[] { CODEC_GZIP, CODEC_NONE };
+            _compressionLevel = 1;
+            // As large as the tool takes, so no file that went through before negotiating is refused
+            _maxFrameSize = int.MaxValue - 1;
+            _chunkSize = 0;
+            _batchMaxMessages = 256;
+            _batchMaxBytes = 16 * 1024;
+            _batchDelay = 1000;
+        }
+
+        // The same rules as the tool: the older frame version, our first codec that remote supports
+        // and the tighter of both batch limits
+        public SocketConnectionOptions Negotiate(SocketCapabilityMessage remote)
+        {
+            var options = new SocketConnectionOptions();
+            options.IsBinaryFrame = (remote._frameVersion >= SocketFrameHeader.VERSION_MIN);
+            if (options.IsBinaryFrame)
+            {
+                options.FrameVersion = (ushort)Math.Min(_frameVersion, remote._frameVersion);
+            }
+
+            options.IsCompressed = false;
+            foreach (var codec in _codecs)
+            {
+                if (remote._codecs != null && Array.IndexOf(remote._codecs, codec) >= 0)
+                {
+                    options.IsCompressed = (codec == CODEC_GZIP);
+                    break;
+                }
+            }
+
+            options.MaxFrameSize = Math.Max(remote._maxFrameSize, 0);
+            options.BatchMaxMessages = Math.Min(_batchMaxMessages, remote._batchMaxMessages);
+            options.BatchMaxBytes = Math.Min(_batchMaxBytes, remote._batchMaxBytes);
+            options.BatchDelay = Math.Min(_batchDelay, remote._batchDelay);
+            if (options.BatchMaxMessages <= 0 || options.BatchMaxBytes <= 0)
+            {
+                options.BatchMaxMessages = 0;
+                options.BatchMaxBytes = 0;
+                options.BatchDelay = 0;
+            }
+            return options;
+        }
+
+        public int _frameVersion;
+        public string[] _encodings;
+        public string[] _codecs;
+        public int _compressionLevel;
+        public int _maxFrameSize;
+        public int _chunkSize;
+        public int _batchMaxMessages;
+        public int _batchMaxBytes;
+        // Microseconds
+        public int _batchDelay;
+    } // class SocketCapabilityMessage
+
+    //---------------------------------
+
     [Serializable]
     public class SocketFileListMessage : SocketMessageBase
     {
@@ -358,10 +585,13 @@ namespace WebSocketApp
             _requestId = requestId;
         }
 
-        public void UpdateList(UnityDirectoryType directoryType, string targetPath)
+        public void UpdateList(UnityDirectoryType directoryType, string targetPath, int pageSize = 0, string continuationToken = null)
         {
             _files = null;
             _directories = null;
+            _frontCodedFiles = null;
+            _frontCodedDirectories = null;
+            _continuationToken = null;
 
             _directory = GetDirectory(directoryType);
             var path = (string.IsNullOrEmpty(targetPath) ? _directory : Path.Combine(_directory, targetPath));
@@ -370,14 +600,83 @@ namespace WebSocketApp
                 return;
             }
 
-            _files = Directory.GetFiles(path);
-            _directories = Directory.GetDirectories(path);
+            var files = Directory.GetFiles(path);
+            var directories = Directory.GetDirectories(path);
+            if (pageSize <= 0)
+            {
+                _files = files;
+                _directories = directories;
+                return;
+            }
+
+            // Pages count directories first, then files. The token is the index of the next entry,
+            // so entries added or removed between requests may shift the pages.
+            int start = 0;
+            if (!string.IsNullOrEmpty(continuationToken) && (!int.TryParse(continuationToken, out start) || start < 0))
+            {
+                Debug.LogErrorFormat("ファイルリストの継続トークンが不正：{0}", continuationToken);
+                return;
+            }
+
+            // Sorted so that the pages stay in the same order and neighbors share long prefixes
+            Array.Sort(directories, string.CompareOrdinal);
+            Array.Sort(files, string.CompareOrdinal);
+            int total = directories.Length + files.Length;
+            int end = (int)Math.Min((long)start + pageSize, total);
+
+            int directoryStart = Math.Min(start, directories.Length);
+            int directoryEnd = Math.Min(end, directories.Length);
+            _frontCodedDirectories = FrontCode(directories, directoryStart, directoryEnd - directoryStart);
+            int fileStart = Math.Max(start, directories.Length) - directories.Length;
+            int fileEnd = Math.Max(end, directories.Length) - directories.Length;
+            _frontCodedFiles = FrontCode(files, fileStart, Math.Max(fileEnd - fileStart, 0));
+            if (end < total)
+            {
+                _continuationToken = end.ToString();
+            }
+        }
+
+        // Each entry is "<n>:<suffix>", where n is the number of leading UTF-8 bytes shared with the previous path
+        private static string[] FrontCode(string[] paths, int start, int count)
+        {
+            var entries = new string[count];
+            string previous = "";
+            for (int i = 0; i < count; ++i)
+            {
+                var path = paths[start + i];
+                int length = 0;
+                int limit = Math.Min(previous.Length, path.Length);
+                while (length < limit && previous[length] == path[length])
+                {
+                    ++length;
+                }
+                // The suffix has to stay a valid string on its own
+                if (length > 0 && char.IsHighSurrogate(path[length - 1]))
+                {
+                    --length;
+                }
+
+                int prefixLength = System.Text.Encoding.UTF8.GetByteCount(path.Substring(0, length));
+                entries[i] = prefixLength.ToString() + ":" + path.Substring(length);
+                previous = path;
+            }
+            return entries;
+        }
+
+        public override int RequestId
+        {
+            get => _requestId;
         }
 
         public int _requestId;
         public string _directory;
         public string[] _files = null;
         public string[] _directories = null;
+        // Paged listings are sent front coded instead of _files and _directories
+        public string[] _frontCodedFiles = null;
+        public string[] _frontCodedDirectories = null;
+        // Request it to get the next page, empty on the last page
+        public string _continuationToken;
     } // class SocketFileListMessage
 
     //---------------------------------
@@ -477,6 +776,21 @@ namespace WebSocketApp
             }
         }
 
+        public override int RequestId
+        {
+            get => _requestId;
+        }
+
+        public override int DataLength
+        {
+            get => (_data != null ? _data.Length : 0);
+        }
+
+        public override void SetAttachment(byte[] bytes, int offset, int length)
+        {
+            _data = Convert.ToBase64String(bytes, offset, length);
+        }
+
         public UnityDirectoryType _directoryType = UnityDirectoryType.Invalid;
         public string _targetPath;
         public int _requestId;
@@ -513,6 +827,16 @@ namespace WebSocketApp
             return true;
         }
 
+        public override int DataLength
+        {
+            get => (_imageData != null ? _imageData.Length : 0);
+        }
+
+        public override void SetAttachment(byte[] bytes, int offset, int length)
+        {
+            _imageData = Convert.ToBase64String(bytes, offset, length);
+        }
+
         public string _imageData;
     } // class SocketImageDataMessage
 
@@ -528,6 +852,11 @@ namespace WebSocketApp
             _requestId = requestId;
         }
 
+        public override int RequestId
+        {
+            get => _requestId;
+        }
+
         public int _requestId;
         public string _dateTime;
     } // class SocketScreenShotMessage
@@ -251,7 +251,7 @@ namespace WebSocketApp
                 return false;
             }
 
-            SendFileList(message._requestId, message._directoryType, message._targetPath);
+            SendFileList(message._requestId, message._directoryType, message._targetPath, message._pageSize, message._continuationToken);
             return true;
         }
 
@@ -415,10 +415,10 @@ namespace WebSocketApp
             return true;
         }
 
-        private void SendFileList(int requestId, UnityDirectoryType directoryType, string targetPath)
+        private void SendFileList(int requestId, UnityDirectoryType directoryType, string targetPath, int pageSize, string continuationToken)
         {
             SocketFileListMessage message = new SocketFileListMessage(requestId);
-            message.UpdateList(directoryType, targetPath);
+            message.UpdateList(directoryType, targetPath, pageSize, continuationToken);
             _connection.SendMessage(message);
         }
 
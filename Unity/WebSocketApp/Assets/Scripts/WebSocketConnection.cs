@@ -1,5 +1,6 @@
 ﻿using System;
 using System.Collections.Generic;
+using System.Threading;
 using UnityEngine;
 
 using WebSocketSharp;
@@ -50,6 +51,13 @@ namespace WebSocketApp
         private WebSocketServer _webSocket = null;
         private MyWebSocketBehavior _webSocketBehavior = null;
         private List<ISocketMessageAccepter> _accepters = new List<ISocketMessageAccepter>();
+        // Text frames until the tool negotiates with SocketCapabilityMessage
+        private SocketConnectionOptions _options = new SocketConnectionOptions();
+        private List<ArraySegment<byte>> _batchFrames = new List<ArraySegment<byte>>();
+        // Logs arrive on any thread (Application.logMessageReceivedThreaded), so the batch and its timer are locked
+        private SocketFrameBatch _batch = new SocketFrameBatch();
+        private readonly object _batchLock = new object();
+        private Timer _batchTimer = null;
 
         private void OnEnable()
         {
@@ -83,6 +91,19 @@ namespace WebSocketApp
                 return false;
             }
 
+            var options = _options;
+            if (options.IsBatchEnabled)
+            {
+                lock (_batchLock)
+                {
+                    return SendBatchMessage(message, options, asyncFlag);
+                }
+            }
+            if (options.IsBinaryFrame)
+            {
+                return SendBinaryMessage(message, options, asyncFlag);
+            }
+
             var payload = SocketMessageBase.ExportMessage(message);
             if (string.IsNullOrEmpty(payload))
             {
@@ -102,6 +123,118 @@ namespace WebSocketApp
             return true;
         }
 
+        private bool SendBinaryMessage(SocketMessageBase message, SocketConnectionOptions options, bool asyncFlag)
+        {
+            var frame = SocketMessageBase.ExportBinaryMessage(message, options);
+            if (frame == null)
+            {
+                Debug.LogErrorFormat("メッセージから送信データが生成できなかった：message={0}", (message == null ? "(null)" : message.MessageType));
+                return false;
+            }
+            if (options.MaxFrameSize > 0 && frame.Length > options.MaxFrameSize)
+            {
+                Debug.LogErrorFormat("フレームが最大サイズを超えている：message={0}, {1} バイト (最大 {2} バイト)", message.MessageType, frame.Length, options.MaxFrameSize);
+                return false;
+            }
+
+            if (asyncFlag)
+            {
+                _webSocketBehavior.SendBytesAsync(frame);
+            }
+            else
+            {
+                _webSocketBehavior.SendBytes(frame);
+            }
+
+            return true;
+        }
+
+        private bool SendBatchMessage(SocketMessageBase message, SocketConnectionOptions options, bool asyncFlag)
+        {
+            // Decided before exporting, so that a large file or image is not serialized twice
+            if (message != null && message.DataLength >= options.BatchMaxBytes)
+            {
+                // Too large to batch: send what is queued first to keep the order
+                FlushBatch(options, asyncFlag);
+                return SendBinaryMessage(message, options, asyncFlag);
+            }
+
+            // A batch is compressed as a whole, not frame by frame
+            var frameOptions = options.Clone();
+            frameOptions.IsCompressed = false;
+            var frame = SocketMessageBase.ExportBinaryMessage(message, frameOptions);
+            if (frame == null)
+            {
+                Debug.LogErrorFormat("メッセージから送信データが生成できなかった：message={0}", (message == null ? "(null)" : message.MessageType));
+                return false;
+            }
+            return QueueBatch(frame, options, asyncFlag);
+        }
+
+        private bool QueueBatch(byte[] frame, SocketConnectionOptions options, bool asyncFlag)
+        {
+            bool first = _batch.IsEmpty;
+            _batch.Append(frame);
+            if (_batch.Count >= options.BatchMaxMessages || _batch.Size >= options.BatchMaxBytes)
+            {
+                return FlushBatch(options, asyncFlag);
+            }
+
+            // The timer has a resolution of 1ms, shorter delays wait that long
+            if (first)
+            {
+                if (_batchTimer == null)
+                {
+                    _batchTimer = new Timer(OnBatchTimeout);
+                }
+                _batchTimer.Change(Math.Max(options.BatchDelay / 1000, 1), Timeout.Infinite);
+            }
+            return true;
+        }
+
+        private bool FlushBatch(SocketConnectionOptions options, bool asyncFlag)
+        {
+            _batchTimer?.Change(Timeout.Infinite, Timeout.Infinite);
+            if (_batch.IsEmpty)
+            {
+                return true;
+            }
+
+            var frame = _batch.Export(options);
+            _batch.Clear();
+            if (frame == null || _webSocketBehavior == null)
+            {
+                return false;
+            }
+
+            if (asyncFlag)
+            {
+                _webSocketBehavior.SendBytesAsync(frame);
+            }
+            else
+            {
+                _webSocketBehavior.SendBytes(frame);
+            }
+            return true;
+        }
+
+        private void OnBatchTimeout(object state)
+        {
+            lock (_batchLock)
+            {
+                FlushBatch(_options, false);
+            }
+        }
+
+        private void ClearBatch()
+        {
+            lock (_batchLock)
+            {
+                _batchTimer?.Change(Timeout.Infinite, Timeout.Infinite);
+                _batch.Clear();
+            }
+        }
+
         public void Connect()
         {
             if (_webSocket != null)
@@ -131,15 +264,25 @@ namespace WebSocketApp
         {
             _webSocket?.Stop();
             _webSocket = null;
+
+            lock (_batchLock)
+            {
+                ClearBatch();
+                _batchTimer?.Dispose();
+                _batchTimer = null;
+            }
         }
 
         private void OnOpen()
         {
+            _options = new SocketConnectionOptions();
+            ClearBatch();
             IsConnect = true;
         }
 
         private void OnClose()
         {
+            ClearBatch();
             IsConnect = false;
         }
 
@@ -151,13 +294,77 @@ namespace WebSocketApp
                 return false;
             }
 
-            return Accept( SocketMessageBase.ImportMessage(val));
+            return AcceptMessage(message);
         }
 
         private bool OnReceiveMessage(byte[] val)
         {
-            Debug.LogErrorFormat("バイナリデータの受信には対応していない：length={0}", val.Length);
-            return false;
+            var header = new SocketFrameHeader();
+            if (!header.Read(val, 0, val.Length))
+            {
+                return false;
+            }
+            if (header.TypeId != SocketFrameBatch.TYPE_ID)
+            {
+                return AcceptFrame(val, 0, val.Length);
+            }
+
+            if (!SocketMessageBase.ReadPayload(header, val, 0, out var payload))
+            {
+                return false;
+            }
+            if (!SocketFrameBatch.Unpack(header, payload.Array, payload.Offset, payload.Count, _batchFrames))
+            {
+                return false;
+            }
+            bool accepted = false;
+            foreach (var frame in _batchFrames)
+            {
+                if (AcceptFrame(frame.Array, frame.Offset, frame.Count))
+                {
+                    accepted = true;
+                }
+            }
+            _batchFrames.Clear();
+            return accepted;
+        }
+
+        private bool AcceptFrame(byte[] frame, int offset, int length)
+        {
+            var message = SocketMessageBase.ImportBinaryMessage(frame, offset, length);
+            if (message == null)
+            {
+                return false;
+            }
+
+            return AcceptMessage(message);
+        }
+
+        private bool AcceptMessage(SocketMessageBase message)
+        {
+            var capability = message as SocketCapabilityMessage;
+            if (capability != null)
+            {
+                return Negotiate(capability);
+            }
+
+            return Accept(message);
+        }
+
+        // The answer still goes as text, the tool switches once it has it
+        private bool Negotiate(SocketCapabilityMessage remote)
+        {
+            var local = new SocketCapabilityMessage();
+            var options = local.Negotiate(remote);
+
+            _options = new SocketConnectionOptions();
+            SendMessage(local);
+            _options = options;
+
+            Debug.LogFormat("接続設定：binary={0}, version={1}, compressed={2}, maxFrameSize={3}, batch={4}/{5}/{6}us",
+                options.IsBinaryFrame, options.FrameVersion, options.IsCompressed, options.MaxFrameSize,
+                options.BatchMaxMessages, options.BatchMaxBytes, options.BatchDelay);
+            return true;
         }
 
         private bool Accept(SocketMessageBase message)
@@ -202,6 +409,30 @@ namespace WebSocketApp
                 Send(val);
             }
 
+            public void SendBytes(byte[] val)
+            {
+                if (!IsOpen)
+                {
+                    Debug.LogWarningFormat("ソケットが開いてないので送信がキャンセルされた：{0} バイト", val.Length);
+                    return;
+                }
+
+                Send(val);
+            }
+
+            public void SendBytesAsync(byte[] val)
+            {
+                if (!IsOpen)
+                {
+                    Debug.LogWarningFormat("ソケットが開いてないので送信がキャンセルされた：{0} バイト", val.Length);
+                    return;
+                }
+
+                SendAsync(val, comp =>
+                {
+                });
+            }
+
             public void SendStringAsync(string val)
             {
                 if (!IsOpen)
@@ -227,11 +458,11 @@ namespace WebSocketApp
 
             protected override void OnMessage(MessageEventArgs args)
             {
-                if (args.Data != null)
+                if (args.IsText)
                 {
                     Connection?.OnReceiveMessage(args.Data);
                 }
-                else if (args.RawData != null)
+                else if (args.IsBinary)
                 {
                     Connection?.OnReceiveMessage(args.RawData);
                 }